@@ -0,0 +1,394 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include <Common/HighQueuePch.hpp>
+
+#include <HighQueue/details/HQHeader.hpp>
+#include <HighQueue/details/HQResolver.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+using namespace HighQueue;
+
+namespace
+{
+    /// @brief Where Linux shows the POSIX shared memory names.
+    const char * sharedMemoryDirectory = "/dev/shm";
+
+    /// @brief Local HighQueues that publish statistics use "HighQueue.<pid>.<name>"
+    /// @returns the process id, or zero if this is not such a name.
+    pid_t publishingProcess(const std::string & shmName)
+    {
+        static const std::string prefix = "/HighQueue.";
+        if(shmName.compare(0, prefix.size(), prefix) != 0)
+        {
+            return 0;
+        }
+        return pid_t(std::strtoul(shmName.c_str() + prefix.size(), 0, 10));
+    }
+
+    /// @brief The totals of the counters in the slots owned by one kind of client.
+    struct Totals
+    {
+        uint64_t publishes_;
+        uint64_t fulls_;
+        uint64_t consumed_;
+        uint64_t spins_;
+        uint64_t yields_;
+        uint64_t sleeps_;
+        uint64_t waits_;
+
+        Totals()
+        {
+            std::memset(this, 0, sizeof(*this));
+        }
+    };
+
+    /// @brief A HighQueue mapped read-only, and what it looked like last time.
+    struct QueueView
+    {
+        std::string shmName_;
+        const byte_t * memory_;
+        size_t size_;
+        const HQHeader * header_;
+        const HighQStatistics * statistics_;
+        uint32_t generations_[HighQStatistics::SlotCount];
+        HighQStatSlot previous_[HighQStatistics::SlotCount];
+
+        QueueView()
+            : memory_(0)
+            , size_(0)
+            , header_(0)
+            , statistics_(0)
+        {
+            std::memset(generations_, 0, sizeof(generations_));
+        }
+    };
+    typedef std::shared_ptr<QueueView> QueueViewPtr;
+}
+
+class HQStatApp
+{
+public:
+    HQStatApp();
+    ~HQStatApp();
+
+    void usage(const char * appName);
+    bool parseArgs(int argc, char *argv[]);
+    void run();
+private:
+    void findQueues();
+    bool attach(const std::string & shmName);
+    void detach(QueueView & view);
+    void report(QueueView & view, double seconds, bool print = true);
+private:
+    uint32_t intervalSeconds_;
+    uint32_t reportCount_;
+    std::vector<std::string> names_;
+    std::map<std::string, QueueViewPtr> queues_;
+};
+
+HQStatApp::HQStatApp()
+    : intervalSeconds_(1)
+    , reportCount_(0)
+{
+}
+
+HQStatApp::~HQStatApp()
+{
+    for(auto & queue : queues_)
+    {
+        detach(*queue.second);
+    }
+}
+
+void HQStatApp::usage(const char * appName)
+{
+    if(!appName)
+    {
+        appName = "hqstat";
+    }
+    std::cerr << "Usage: " << appName << " [-i seconds] [-n reports] [shared_memory_name ...]" << std::endl;
+    std::cerr << "    Print the rates for each HighQueue every interval (default 1 second.)" << std::endl;
+    std::cerr << "    With no names, watches every HighQueue in " << sharedMemoryDirectory << "." << std::endl;
+    std::cerr << "    Local HighQueues appear if they were created with publishStatistics_." << std::endl;
+}
+
+bool HQStatApp::parseArgs(int argc, char *argv[])
+{
+    for(int nArg = 1; nArg < argc; ++nArg)
+    {
+        std::string arg = argv[nArg];
+        if((arg == "-i" || arg == "-n") && nArg + 1 < argc)
+        {
+            auto value = uint32_t(std::strtoul(argv[++nArg], 0, 10));
+            if(value == 0 && arg == "-i")
+            {
+                std::cerr << "The interval must be at least one second." << std::endl;
+                return false;
+            }
+            (arg == "-i" ? intervalSeconds_ : reportCount_) = value;
+        }
+        else if(!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        else
+        {
+            names_.push_back(arg[0] == '/' ? arg : "/" + arg);
+        }
+    }
+    return true;
+}
+
+#ifndef _WIN32
+void HQStatApp::findQueues()
+{
+    std::vector<std::string> names = names_;
+    if(names.empty())
+    {
+        // Queues come and go, so look again every time.
+        DIR * directory = opendir(sharedMemoryDirectory);
+        if(directory != 0)
+        {
+            while(struct dirent * entry = readdir(directory))
+            {
+                if(entry->d_name[0] != '.')
+                {
+                    names.push_back(std::string("/") + entry->d_name);
+                }
+            }
+            closedir(directory);
+        }
+    }
+    for(auto & name : names)
+    {
+        if(queues_.find(name) == queues_.end())
+        {
+            attach(name);
+        }
+    }
+}
+
+bool HQStatApp::attach(const std::string & shmName)
+{
+    auto pid = publishingProcess(shmName);
+    if(pid != 0 && kill(pid, 0) != 0 && errno == ESRCH)
+    {
+        // Left behind by a process that did not exit cleanly.
+        return false;
+    }
+    int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if(fstat(fd, &status) != 0 || status.st_size < off_t(sizeof(HQHeader)))
+    {
+        ::close(fd);
+        return false;
+    }
+    size_t size = size_t(status.st_size);
+    void * memory = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+    {
+        return false;
+    }
+    auto header = reinterpret_cast<const HQHeader *>(memory);
+    if(header->signature_ != HQHeader::LiveSignature
+        || header->version_ != HQHeader::Version
+        || header->statistics_ == 0
+        || header->statistics_ + sizeof(HighQStatistics) > size)
+    {
+        munmap(memory, size);
+        return false;
+    }
+    auto view = std::make_shared<QueueView>();
+    view->shmName_ = shmName;
+    view->memory_ = reinterpret_cast<const byte_t *>(memory);
+    view->size_ = size;
+    view->header_ = header;
+    HighQResolver resolver(const_cast<byte_t *>(view->memory_));
+    view->statistics_ = resolver.resolve<const HighQStatistics>(header->statistics_);
+    queues_[shmName] = view;
+    // The first report is only a baseline.
+    report(*view, 1.0, false);
+    return true;
+}
+
+void HQStatApp::detach(QueueView & view)
+{
+    if(view.memory_)
+    {
+        munmap(const_cast<byte_t *>(view.memory_), view.size_);
+        view.memory_ = 0;
+        view.header_ = 0;
+        view.statistics_ = 0;
+    }
+}
+#else // _WIN32
+void HQStatApp::findQueues()
+{
+    throw std::runtime_error("hqstat needs POSIX shared memory.");
+}
+
+bool HQStatApp::attach(const std::string & shmName)
+{
+    return false;
+}
+
+void HQStatApp::detach(QueueView & view)
+{
+}
+#endif // _WIN32
+
+void HQStatApp::report(QueueView & view, double seconds, bool print)
+{
+    Totals deltas;
+    uint32_t producers = 0;
+    uint32_t consumers = 0;
+    for(size_t nSlot = 0; nSlot < HighQStatistics::SlotCount; ++nSlot)
+    {
+        const HighQStatSlot & slot = view.statistics_->slots_[nSlot];
+        HighQStatSlot & previous = view.previous_[nSlot];
+        auto owner = slot.owner_.load(std::memory_order_relaxed);
+        producers += owner == HighQStatSlot::ProducerOwner ? 1 : 0;
+        consumers += owner == HighQStatSlot::ConsumerOwner ? 1 : 0;
+        auto generation = slot.generation_.load(std::memory_order_acquire);
+        bool restarted = generation != view.generations_[nSlot];
+        view.generations_[nSlot] = generation;
+        struct
+        {
+            const HighQStatCounter & current_;
+            HighQStatCounter & previous_;
+            uint64_t & delta_;
+        } counters[] = {
+            {slot.publishes_, previous.publishes_, deltas.publishes_},
+            {slot.fulls_, previous.fulls_, deltas.fulls_},
+            {slot.consumed_, previous.consumed_, deltas.consumed_},
+            {slot.spins_, previous.spins_, deltas.spins_},
+            {slot.yields_, previous.yields_, deltas.yields_},
+            {slot.sleeps_, previous.sleeps_, deltas.sleeps_},
+            {slot.waits_, previous.waits_, deltas.waits_}
+        };
+        for(auto & counter : counters)
+        {
+            uint64_t current = counter.current_;
+            uint64_t before = restarted ? 0 : uint64_t(counter.previous_);
+            // A client that claimed and released the slot between reports is not counted.
+            counter.delta_ += current >= before ? current - before : current;
+            counter.previous_.value_.store(current, std::memory_order_relaxed);
+        }
+    }
+
+    if(!print)
+    {
+        return;
+    }
+
+    HighQResolver resolver(const_cast<byte_t *>(view.memory_));
+    auto header = view.header_;
+    Position readPosition = resolver.resolve<const AtomicPosition>(header->readPosition_)->load(std::memory_order_relaxed);
+    Position publishPosition = resolver.resolve<const AtomicPosition>(header->publishPosition_)->load(std::memory_order_relaxed);
+    Position depth = publishPosition > readPosition ? publishPosition - readPosition : 0;
+    auto entryCount = header->rings_[header->ringGeneration_.load(std::memory_order_relaxed) % 2].entryCount_;
+    if(entryCount == 0)
+    {
+        entryCount = header->entryCount_;
+    }
+
+    auto rate = [seconds](uint64_t count)
+    {
+        return uint64_t(double(count) / seconds + 0.5);
+    };
+    std::cout << std::setw(24) << std::left << view.shmName_ << std::right
+        << std::setw(9) << entryCount
+        << std::setw(9) << depth
+        << std::setw(9) << view.statistics_->highWater_.depth_.load(std::memory_order_relaxed)
+        << std::setw(5) << producers
+        << std::setw(5) << consumers
+        << std::setw(12) << rate(deltas.publishes_)
+        << std::setw(12) << rate(deltas.consumed_)
+        << std::setw(10) << rate(deltas.fulls_)
+        << std::setw(10) << rate(deltas.spins_)
+        << std::setw(10) << rate(deltas.yields_)
+        << std::setw(10) << rate(deltas.sleeps_)
+        << std::setw(10) << rate(deltas.waits_)
+        << std::endl;
+}
+
+void HQStatApp::run()
+{
+    findQueues();
+    auto last = std::chrono::steady_clock::now();
+    for(uint32_t nReport = 0; reportCount_ == 0 || nReport < reportCount_; ++nReport)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds_));
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+
+        std::cout << std::setw(24) << std::left << "Queue" << std::right
+            << std::setw(9) << "Entries"
+            << std::setw(9) << "Depth"
+            << std::setw(9) << "HighWtr"
+            << std::setw(5) << "Prod"
+            << std::setw(5) << "Cons"
+            << std::setw(12) << "Publish/s"
+            << std::setw(12) << "Consume/s"
+            << std::setw(10) << "Full/s"
+            << std::setw(10) << "Spin/s"
+            << std::setw(10) << "Yield/s"
+            << std::setw(10) << "Sleep/s"
+            << std::setw(10) << "Wait/s"
+            << std::endl;
+        for(auto pos = queues_.begin(); pos != queues_.end();)
+        {
+            auto & view = *pos->second;
+            if(view.header_->signature_ != HQHeader::LiveSignature)
+            {
+                detach(view);
+                pos = queues_.erase(pos);
+                continue;
+            }
+            report(view, seconds);
+            ++pos;
+        }
+        // New queues are reported from the next interval.
+        findQueues();
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    int ok = -1;
+    try
+    {
+        HQStatApp app;
+        if(app.parseArgs(argc, argv))
+        {
+            app.run();
+            ok = 0;
+        }
+        else
+        {
+            app.usage(argv[0]);
+        }
+    }
+    catch(const std::exception & ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+    return ok;
+}
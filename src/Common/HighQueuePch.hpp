@@ -58,6 +58,7 @@ const size_t CacheLineSize = 64;
 #include <cstdint>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
 #include <map>
@@ -81,5 +82,12 @@ typedef uint8_t byte_t;
 // #define spinDelay() _mm_pause()
 #endif
 
+///@brief Ask the processor to start loading the cache line containing address.  Never faults.
+#ifdef _WIN32
+#define prefetchForRead(address) ::PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, (address))
+#else
+#define prefetchForRead(address) __builtin_prefetch((address), 0, 3)
+#endif
+
 
 
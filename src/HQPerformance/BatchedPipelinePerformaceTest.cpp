@@ -4,6 +4,7 @@
 
 #include <HighQueue/Producer.hpp>
 #include <HighQueue/Consumer.hpp>
+#include <HighQueue/MessageArray.hpp>
 #include <Common/Stopwatch.hpp>
 #include <Mocks/MockMessage.hpp>
 
@@ -229,3 +230,113 @@ BOOST_AUTO_TEST_CASE(testBachedPipelinePerformance)
     std::cout << std::endl;
 }
 #endif // ENABLEBATCHED_ORDEREDMERGE_PERFORMANCE_TEST
+
+namespace
+{
+    /// @brief Publish messageCount messages either one at a time (publishBatchSize == 1)
+    /// or publishBatchSize at a time using Producer::publish(Message *, size_t).
+    void batchPublishFunction(ConnectionPtr & connection, uint32_t messageCount, size_t publishBatchSize)
+    {
+        try
+        {
+            connection->willProduce(); // enable solo mode
+            Producer producer(connection);
+            MessageArray messages(connection, publishBatchSize);
+
+            ++threadsReady;
+            while(!producerGo)
+            {
+                std::this_thread::yield();
+            }
+
+            uint32_t messageNumber = 0;
+            while(messageNumber < messageCount)
+            {
+                size_t count = 0;
+                while(count < publishBatchSize && messageNumber < messageCount)
+                {
+                    messages[count].emplace<MockMessage<13> >(1, messageNumber);
+                    ++count;
+                    ++messageNumber;
+                }
+                if(publishBatchSize == 1)
+                {
+                    producer.publish(messages[0]);
+                }
+                else
+                {
+                    producer.publish(messages.get(), count);
+                }
+            }
+            // send an empty message
+            messages[0].setUsed(0);
+            producer.publish(messages[0]);
+        }
+        catch(const std::exception & ex)
+        {
+            std::cout << "Batch publish producer failed. " << ex.what() << std::endl;
+        }
+    }
+}
+
+#define ENABLE_BATCH_PUBLISH_PERFORMANCE_TEST 1
+#if ENABLE_BATCH_PUBLISH_PERFORMANCE_TEST
+BOOST_AUTO_TEST_CASE(testBatchPublishPerformance)
+{
+    typedef MockMessage<13> ActualMessage;
+    static const size_t publishQueueEntries = 10000;
+    static const uint32_t publishMessageCount = 10000000;
+    static const size_t publishBatchSizes[] = {1, 8, 32, 256};
+
+    for(auto publishBatchSize : publishBatchSizes)
+    {
+        WaitStrategy strategy(spinCount, yieldCount, sleepCount, sleepPeriod);
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, publishQueueEntries, sizeof(ActualMessage), 
+            publishQueueEntries + publishBatchSize + 10);
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("BatchPublish", parameters);
+
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+
+        producerGo = false;
+        threadsReady = 0;
+        std::thread producer(std::bind(batchPublishFunction, connection, publishMessageCount, publishBatchSize));
+        while(threadsReady < 1)
+        {
+            std::this_thread::yield();
+        }
+
+        Stopwatch timer;
+        producerGo = true;
+
+        uint32_t messageNumber = 0;
+        while(consumer.getNext(consumerMessage) && consumerMessage.getUsed() != 0)
+        {
+            auto testMessage = consumerMessage.get<ActualMessage>();
+            if(messageNumber != testMessage->getSequence())
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+            }
+            ++messageNumber;
+        }
+        auto lapse = timer.nanoseconds();
+        producer.join();
+        BOOST_CHECK_EQUAL(messageNumber, publishMessageCount);
+
+        std::cout << "HighQueue Publish " << (publishBatchSize == 1 ? "one at a time" : "in batches of ") ;
+        if(publishBatchSize != 1)
+        {
+            std::cout << publishBatchSize;
+        }
+        std::cout << ": Passed " << publishMessageCount << ' ' << sizeof(ActualMessage) << " byte messages in "
+            << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << " seconds.  "
+            << lapse / publishMessageCount << " nsec./message "
+            << std::setprecision(3) << (double(publishMessageCount) * 1000.0L) / double(lapse) << " MMsg/second "
+            << std::endl;
+        consumer.writeStats(std::cerr);
+    }
+}
+#endif // ENABLE_BATCH_PUBLISH_PERFORMANCE_TEST
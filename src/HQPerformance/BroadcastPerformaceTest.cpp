@@ -0,0 +1,215 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+#include <Mocks/MockMessage.hpp>
+
+using namespace HighQueue;
+typedef MockMessage<13> ActualMessage;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    static const size_t entryCount = 10000;
+    static const size_t messageSize = sizeof(ActualMessage);
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    static const size_t subscriberCounts[] = {1, 2, 4, 8};
+
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<ActualMessage>(1, messageNumber);
+            producer.publish(producerMessage);
+        }
+    }
+
+    /// @brief Does what the FanOut step does: copy each message once per destination.
+    void fanOutFunction(ConnectionPtr source, std::vector<ConnectionPtr> destinations, uint64_t messageCount)
+    {
+        Consumer consumer(source);
+        Message consumerMessage(source);
+        std::vector<std::unique_ptr<Producer>> producers;
+        for(auto & destination : destinations)
+        {
+            destination->willProduce();
+            producers.emplace_back(new Producer(destination));
+        }
+        Message outMessage(source);
+        ++threadsReady;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            for(auto & producer : producers)
+            {
+                outMessage.appendBinaryCopy(consumerMessage.get(), consumerMessage.getUsed());
+                consumerMessage.copyMetaInfoTo(outMessage);
+                producer->publish(outMessage);
+            }
+        }
+    }
+
+    void copyConsumerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto testMessage = consumerMessage.get<ActualMessage>();
+            if(messageNumber != testMessage->getSequence())
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+            }
+        }
+    }
+
+    void subscriberFunction(Consumer * subscriber, uint64_t messageCount)
+    {
+        ++threadsReady;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            auto testMessage = subscriber->peekNext()->getConst<ActualMessage>();
+            if(messageNumber != testMessage->getSequence())
+            {
+                BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+            }
+            subscriber->releasePeeked();
+        }
+    }
+
+    void displayResults(
+        std::ostream & out,
+        const char * mode,
+        size_t subscriberCount,
+        size_t messageCount,
+        uint64_t lapse,
+        bool & header)
+    {
+        if(header)
+        {
+            header = false;
+            out << std::setw(10) << "Mode" << '\t'
+                << std::setw(11) << "Subscribers" << '\t'
+                << std::setw(10) << "Messages" << '\t'
+                << std::setw(14) << "Bytes/message" << '\t'
+                << std::setw(10) << "Seconds" << '\t'
+                << std::setw(18) << "Nanosecond/message" << '\t'
+                << std::setw(16) << "M message/second" << std::endl;
+        }
+        out << std::setw(10) << mode << '\t'
+            << std::setw(11) << subscriberCount << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(14) << messageSize << '\t'
+            << std::setw(10) << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << '\t'
+            << std::setw(18) << lapse / messageCount << '\t';
+        if(lapse == 0)
+        {
+            out << "0\tRun time too short to measure.   Use a larger messageCount" << std::endl;
+        }
+        else
+        {
+            out << std::setw(16) << std::setprecision(3) << double(messageCount * 1000) / double(lapse)
+                << std::endl;
+        }
+    }
+
+    uint64_t runThreads(std::vector<std::thread> & threads, size_t threadCount)
+    {
+        while(threadsReady < threadCount)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        producerGo = true;
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        return timer.nanoseconds();
+    }
+}
+
+#define ENABLE_BroadcastPerformance 1
+#if ! ENABLE_BroadcastPerformance
+#pragma message ("ENABLE_BroadcastPerformance")
+#else // ENABLE_BroadcastPerformance
+BOOST_AUTO_TEST_CASE(testBroadcastPerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+
+    std::cerr << "***** BEGIN BroadcastPerformance test *****" << std::endl;
+    bool header = true;
+    for(auto subscriberCount : subscriberCounts)
+    {
+        // FanOut: producer -> queue -> copy to each destination queue -> consumers.
+        {
+            size_t messageCount = entryCount * (subscriberCount + 1) + subscriberCount + 3;
+            CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize);
+            MemoryPoolPtr memoryPool = std::make_shared<MemoryPool>(messageSize, messageCount);
+            ConnectionPtr source = std::make_shared<Connection>();
+            source->createLocal("FanOutSource", parameters, memoryPool);
+            source->willProduce();
+            std::vector<ConnectionPtr> destinations;
+            for(size_t nSubscriber = 0; nSubscriber < subscriberCount; ++nSubscriber)
+            {
+                destinations.emplace_back(std::make_shared<Connection>());
+                destinations.back()->createLocal("FanOutDestination", parameters, memoryPool);
+            }
+
+            threadsReady = 0;
+            producerGo = false;
+            std::vector<std::thread> threads;
+            for(auto & destination : destinations)
+            {
+                threads.emplace_back(copyConsumerFunction, destination, targetMessageCount);
+            }
+            threads.emplace_back(fanOutFunction, source, destinations, targetMessageCount);
+            threads.emplace_back(producerFunction, source, targetMessageCount);
+            auto lapse = runThreads(threads, threads.size());
+            displayResults(std::cout, "FanOut", subscriberCount, targetMessageCount, lapse, header);
+        }
+
+        // Broadcast: producer -> queue -> subscribers read in place.
+        {
+            size_t messageCount = entryCount + 2;
+            CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+            parameters.subscriberCount_ = subscriberCount;
+            ConnectionPtr connection = std::make_shared<Connection>();
+            connection->createLocal("Broadcast", parameters);
+            connection->willProduce();
+
+            std::vector<std::unique_ptr<Consumer>> subscribers;
+            threadsReady = 0;
+            producerGo = false;
+            std::vector<std::thread> threads;
+            for(size_t nSubscriber = 0; nSubscriber < subscriberCount; ++nSubscriber)
+            {
+                subscribers.emplace_back(new Consumer(connection));
+                threads.emplace_back(subscriberFunction, subscribers.back().get(), targetMessageCount);
+            }
+            threads.emplace_back(producerFunction, connection, targetMessageCount);
+            auto lapse = runThreads(threads, threads.size());
+            displayResults(std::cout, "Broadcast", subscriberCount, targetMessageCount, lapse, header);
+        }
+    }
+    std::cerr << "***** END BroadcastPerformance test *****" << std::endl;
+}
+#endif // ENABLE_BroadcastPerformance
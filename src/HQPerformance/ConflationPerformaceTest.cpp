@@ -0,0 +1,159 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+    volatile bool producerDone = false;
+
+    static const size_t entryCount = 1024;
+    static const uint64_t keyCount = 4096; // more keys than entries, so uniform keys rarely conflate.
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    // The consumer spends about this long on each message so it can't keep up.
+    static const uint64_t consumerWork = 500;
+
+    // Keys are keyCount * u^skew for u uniform in [0, 1).
+    // skew 1 is uniform; larger values concentrate updates on the low keys.
+    struct Distribution
+    {
+        const char * name_;
+        bool conflate_;
+        int skew_;
+    };
+
+    const Distribution distributions[] =
+    {
+        {"Queued", false, 1},
+        {"Uniform", true, 1},
+        {"Skewed", true, 3},
+        {"Hot", true, 8}
+    };
+
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount, int skew, uint64_t & lapse)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        // Generate the keys before timing starts.
+        std::vector<ConflationKey> keys(static_cast<size_t>(messageCount));
+        uint64_t random = 88172645463325252ULL;
+        for(auto & key : keys)
+        {
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+            double value = double(random >> 11) / double(1ULL << 53);
+            key = ConflationKey(keyCount * std::pow(value, skew));
+        }
+        bool conflate = connection->getHeader()->conflateByKey_;
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<uint64_t>(messageNumber);
+            if(conflate)
+            {
+                producer.publish(producerMessage, keys[size_t(messageNumber)]);
+            }
+            else
+            {
+                producer.publish(producerMessage);
+            }
+        }
+        lapse = timer.nanoseconds();
+        producerDone = true;
+    }
+
+    void consumerFunction(ConnectionPtr connection, uint64_t & consumed)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        while(true)
+        {
+            if(!consumer.tryGetNext(consumerMessage))
+            {
+                if(!producerDone)
+                {
+                    continue;
+                }
+                if(!consumer.tryGetNext(consumerMessage))
+                {
+                    break;
+                }
+            }
+            ++consumed;
+            auto busyUntil = Stopwatch::now() + consumerWork;
+            while(Stopwatch::now() < busyUntil)
+            {
+            }
+        }
+    }
+}
+
+#define ENABLE_ConflationPerformance 1
+#if ! ENABLE_ConflationPerformance
+#pragma message ("ENABLE_ConflationPerformance")
+#else // ENABLE_ConflationPerformance
+BOOST_AUTO_TEST_CASE(testConflationPerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+
+    std::cerr << "***** BEGIN ConflationPerformance test *****" << std::endl;
+    std::cout << "Consumer works " << consumerWork << " nanoseconds per message. " << keyCount << " keys." << std::endl;
+    std::cout << std::setw(10) << "Keys" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "Consumed" << '\t'
+        << std::setw(10) << "Ratio" << '\t'
+        << std::setw(18) << "Producer ns/msg" << std::endl;
+    for(const auto & distribution : distributions)
+    {
+        // Waiting for the slow consumer takes a long time, so publish fewer messages.
+        uint64_t messageCount = distribution.conflate_ ? targetMessageCount : targetMessageCount / 100;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        parameters.conflateByKey_ = distribution.conflate_;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Conflation", parameters);
+
+        threadsReady = 0;
+        producerGo = false;
+        producerDone = false;
+        uint64_t lapse = 0;
+        uint64_t consumed = 0;
+        std::thread consumerThread(consumerFunction, connection, std::ref(consumed));
+        std::thread producerThread(producerFunction, connection, messageCount, distribution.skew_, std::ref(lapse));
+        while(threadsReady < 2)
+        {
+            std::this_thread::yield();
+        }
+        producerGo = true;
+        producerThread.join();
+        consumerThread.join();
+        if(!distribution.conflate_)
+        {
+            BOOST_CHECK_EQUAL(messageCount, consumed);
+        }
+
+        std::cout << std::setw(10) << distribution.name_ << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(10) << consumed << '\t'
+            << std::setw(10) << std::setprecision(3) << double(messageCount - consumed) / double(messageCount) << '\t'
+            << std::setw(18) << lapse / messageCount << std::endl;
+    }
+    std::cerr << "***** END ConflationPerformance test *****" << std::endl;
+}
+#endif // ENABLE_ConflationPerformance
@@ -0,0 +1,120 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    static const size_t entryCount = 10000;
+    static const size_t maxMessageSize = 128;
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    // Sweep across HighQEntry::InlineCapacity.
+    static const size_t messageSizes[] = {8, 16, 24, 32, 40, 48, 64, 128};
+
+    void producerFunction(ConnectionPtr connection, size_t messageSize, uint64_t messageCount)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        byte_t payload[maxMessageSize] = {0};
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            *reinterpret_cast<uint32_t *>(payload) = uint32_t(messageNumber);
+            producerMessage.appendBinaryCopy(payload, messageSize);
+            producer.publish(producerMessage);
+        }
+    }
+
+    void consumerFunction(ConnectionPtr connection, size_t messageSize, uint64_t messageCount)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto sequence = *consumerMessage.get<uint32_t>();
+            if(uint32_t(messageNumber) != sequence || consumerMessage.getUsed() != messageSize)
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(uint32_t(messageNumber), sequence);
+                BOOST_CHECK_EQUAL(messageSize, consumerMessage.getUsed());
+            }
+        }
+    }
+}
+
+#define ENABLE_InlinePayloadPerformance 1
+#if ! ENABLE_InlinePayloadPerformance
+#pragma message ("ENABLE_InlinePayloadPerformance")
+#else // ENABLE_InlinePayloadPerformance
+BOOST_AUTO_TEST_CASE(testInlinePayloadPerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+
+    std::cerr << "***** BEGIN InlinePayloadPerformance test *****" << std::endl;
+    std::cout << "Inline capacity: " << HighQEntry::InlineCapacity << " bytes." << std::endl;
+    std::cout << std::setw(10) << "Mode" << '\t'
+        << std::setw(14) << "Bytes/message" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "Seconds" << '\t'
+        << std::setw(18) << "Nanosecond/message" << '\t'
+        << std::setw(16) << "M message/second" << std::endl;
+    for(auto messageSize : messageSizes)
+    {
+        for(int inlinePayloads = 0; inlinePayloads < 2; ++inlinePayloads)
+        {
+            CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, maxMessageSize, entryCount + 10);
+            parameters.inlinePayloads_ = inlinePayloads != 0;
+            ConnectionPtr connection = std::make_shared<Connection>();
+            connection->createLocal("InlinePayloads", parameters);
+            connection->willProduce();
+
+            threadsReady = 0;
+            producerGo = false;
+            std::thread consumerThread(consumerFunction, connection, messageSize, targetMessageCount);
+            std::thread producerThread(producerFunction, connection, messageSize, targetMessageCount);
+            while(threadsReady < 2)
+            {
+                std::this_thread::yield();
+            }
+            Stopwatch timer;
+            producerGo = true;
+            producerThread.join();
+            consumerThread.join();
+            auto lapse = timer.nanoseconds();
+
+            std::cout << std::setw(10) << (inlinePayloads ? "Inline" : "Block") << '\t'
+                << std::setw(14) << messageSize << '\t'
+                << std::setw(10) << targetMessageCount << '\t'
+                << std::setw(10) << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << '\t'
+                << std::setw(18) << lapse / targetMessageCount << '\t';
+            if(lapse == 0)
+            {
+                std::cout << "0\tRun time too short to measure.   Use a larger messageCount" << std::endl;
+            }
+            else
+            {
+                std::cout << std::setw(16) << std::setprecision(3) << double(targetMessageCount * 1000) / double(lapse)
+                    << std::endl;
+            }
+        }
+    }
+    std::cerr << "***** END InlinePayloadPerformance test *****" << std::endl;
+}
+#endif // ENABLE_InlinePayloadPerformance
@@ -0,0 +1,164 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif // __linux__
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    static const size_t entryCount = 1024;
+    static const uint64_t targetMessageCount = 1000000 * 10;
+
+    /// @brief Count hardware cache misses in this thread and the threads it starts.
+    /// Not every machine (or virtual machine) provides the counter.
+    class CacheMissCounter
+    {
+    public:
+        CacheMissCounter()
+            : fd_(-1)
+        {
+#ifdef __linux__
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.inherit = 1;
+            fd_ = int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+#endif // __linux__
+        }
+
+        ~CacheMissCounter()
+        {
+            if(fd_ >= 0)
+            {
+                ::close(fd_);
+            }
+        }
+
+        bool available() const
+        {
+            return fd_ >= 0;
+        }
+
+        /// @brief Includes threads that have been joined.
+        uint64_t read() const
+        {
+            uint64_t count = 0;
+            if(fd_ < 0 || ::read(fd_, &count, sizeof(count)) != sizeof(count))
+            {
+                return 0;
+            }
+            return count;
+        }
+    private:
+        int fd_;
+    };
+
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<uint64_t>(messageNumber);
+            producer.publish(producerMessage);
+        }
+    }
+
+    void consumerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto value = *consumerMessage.get<uint64_t>();
+            if(value != messageNumber)
+            {
+                // the if avoids the performance hit of BOOST_CHECK unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, value);
+            }
+        }
+    }
+}
+
+#define ENABLE_LazyReadPositionPerformance 1
+#if ! ENABLE_LazyReadPositionPerformance
+#pragma message ("ENABLE_LazyReadPositionPerformance")
+#else // ENABLE_LazyReadPositionPerformance
+BOOST_AUTO_TEST_CASE(testLazyReadPositionPerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+    static const size_t intervals[] = {1, 8, 64, 256};
+
+    std::cerr << "***** BEGIN LazyReadPositionPerformance test *****" << std::endl;
+    std::cout << std::setw(10) << "Interval" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "ns/msg" << '\t'
+        << std::setw(14) << "Cache misses" << '\t'
+        << std::setw(12) << "Misses/msg" << std::endl;
+    for(auto interval : intervals)
+    {
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        parameters.readPositionInterval_ = interval;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("LazyRead", parameters);
+
+        threadsReady = 0;
+        producerGo = false;
+        uint64_t messageCount = targetMessageCount;
+        CacheMissCounter cacheMisses;
+        std::thread consumerThread(consumerFunction, connection, messageCount);
+        std::thread producerThread(producerFunction, connection, messageCount);
+        while(threadsReady < 2)
+        {
+            std::this_thread::yield();
+        }
+        uint64_t missesBefore = cacheMisses.read();
+        Stopwatch timer;
+        producerGo = true;
+        producerThread.join();
+        consumerThread.join();
+        auto lapse = timer.nanoseconds();
+        uint64_t misses = cacheMisses.read() - missesBefore;
+
+        std::cout << std::setw(10) << interval << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(10) << lapse / messageCount << '\t';
+        if(cacheMisses.available())
+        {
+            std::cout << std::setw(14) << misses << '\t'
+                << std::setw(12) << double(misses) / double(messageCount) << std::endl;
+        }
+        else
+        {
+            std::cout << std::setw(14) << "n/a" << '\t' << std::setw(12) << "n/a" << std::endl;
+        }
+    }
+    std::cerr << "***** END LazyReadPositionPerformance test *****" << std::endl;
+}
+#endif // ENABLE_LazyReadPositionPerformance
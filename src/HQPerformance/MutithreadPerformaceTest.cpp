@@ -250,3 +250,109 @@ BOOST_AUTO_TEST_CASE(testMultithreadMessagePassingPerformance)
     std::cerr << "***** END MultiProducerSingleQueueMessagePassingPerformance test *****" << std::endl;
 }
 #endif // ENABLE_MultithreadMessagePassingPerformance
+
+#define ENABLE_LockFreeMultiProducerPerformance 1
+#if ! ENABLE_LockFreeMultiProducerPerformance
+#pragma message ("ENABLE_LockFreeMultiProducerPerformance")
+#else // ENABLE_LockFreeMultiProducerPerformance 
+BOOST_AUTO_TEST_CASE(testLockFreeMultiProducerPerformance)
+{
+    static const size_t entryCount = 100000;
+    static const size_t messageSize = sizeof(ActualMessage);
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    static const size_t producerCounts[] = {1, 2, 4, 8};
+    static const size_t maxNumberOfProducers = 8;
+    static const size_t numberOfConsumers = 1;  // Just for documentation
+    static const size_t messageCount = entryCount + numberOfConsumers + maxNumberOfProducers;
+
+    static const size_t consumerSpinCount = 0;
+    static const size_t consumerYieldCount = 0;
+    static const size_t consumerSleepCount = WaitStrategy::FOREVER;
+    static const size_t producerSpinCount = 10;
+    static const size_t producerYieldCount = 1000;
+    static const size_t producerSleepCount = WaitStrategy::FOREVER;
+    static const auto sleepTime = std::chrono::nanoseconds(10);
+
+    std::cerr << "***** BEGIN LockFreeMultiProducerPerformance test *****" << std::endl;
+
+    WaitStrategy consumerStrategy(consumerSpinCount, consumerYieldCount, consumerSleepCount, sleepTime);
+    WaitStrategy producerStrategy(producerSpinCount, producerYieldCount, producerSleepCount, sleepTime);
+    bool discardMessagesIfNoConsumer = false;
+
+    for(auto lockFree : {false, true})
+    {
+        std::cout << (lockFree ? "Lock free producers:" : "Spin lock producers:") << std::endl;
+        bool header = true;
+        for(auto producerCount : producerCounts)
+        {
+            CreationParameters parameters(producerStrategy, consumerStrategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+            parameters.lockFreeProducers_ = lockFree;
+            ConnectionPtr connection = std::make_shared<Connection>();
+            connection->createLocal("LocalIv", parameters);
+
+            Consumer consumer(connection);
+            Message consumerMessage(connection);
+
+            std::vector<std::thread> producerThreads;
+            std::vector<uint64_t> nextMessage(producerCount, 0ULL);
+            std::vector<std::stringstream> stats(producerCount);
+
+            threadsReady = 0;
+            producerGo = false;
+            size_t perProducer = targetMessageCount / producerCount;
+            size_t actualMessageCount = perProducer * producerCount;
+
+            // No willProduce() call so even a single producer takes the multi-producer path.
+            for(uint32_t nTh = 0; nTh < producerCount; ++nTh)
+            {
+                producerThreads.emplace_back(
+                    std::bind(producerFunction, connection, nTh, perProducer, std::ref(stats[nTh])));
+            }
+
+            while(threadsReady < producerCount)
+            {
+                std::this_thread::yield();
+            }
+
+            Stopwatch timer;
+            producerGo = true;
+
+            for(uint64_t messageNumber = 0; messageNumber < actualMessageCount; ++messageNumber)
+            {
+                consumer.getNext(consumerMessage);
+                auto testMessage = consumerMessage.get<ActualMessage>();
+                auto & msgNumber = nextMessage[testMessage->producerNumber()];
+                if(msgNumber != testMessage->getSequence())
+                {
+                    // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                    BOOST_CHECK_EQUAL(msgNumber, testMessage->getSequence());
+                }
+                ++ msgNumber; 
+            }
+
+            auto lapse = timer.nanoseconds();
+            producerGo = false;
+            for(auto & thread : producerThreads)
+            {
+                thread.join();
+            }
+
+            displayResults(
+                std::cout,
+                producerCount,
+                actualMessageCount,
+                sizeof(ActualMessage),
+                lapse,
+                header);
+
+            for(auto & out : stats)
+            {
+                std::cerr << "Producer: " << out.str();
+            }
+            std::cerr << "Consumer: ";
+            consumer.writeStats(std::cerr);
+        }
+    }
+    std::cerr << "***** END LockFreeMultiProducerPerformance test *****" << std::endl;
+}
+#endif // ENABLE_LockFreeMultiProducerPerformance
@@ -0,0 +1,192 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
+
+using namespace HighQueue;
+
+namespace
+{
+    // Large enough that reading a message from another node's memory costs something.
+    static const size_t messageBytes = 1024;
+    static const size_t entryCount = 1000;
+    static const uint32_t targetMessageCount = 1000000;
+
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    /// @brief Run the calling thread on a CPU of node.  Does nothing when the node is emulated:
+    /// pinning every thread to the one real node would only measure the threads fighting for its CPUs.
+    void runOnNode(int node)
+    {
+#ifdef __linux__
+        if(node < 0 || node >= HighQPageMemory::nodeCount())
+        {
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for(int cpu = 0; cpu < int(std::thread::hardware_concurrency()) && cpu < CPU_SETSIZE; ++cpu)
+        {
+            if(HighQPageMemory::nodeOfCpu(cpu) == node)
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if(CPU_COUNT(&cpus) != 0)
+        {
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+#endif // __linux__
+    }
+
+    uint64_t readAll(const Message & message)
+    {
+        uint64_t sum = 0;
+        auto words = message.getConst<uint64_t>();
+        for(size_t nWord = 0; nWord < message.getUsed() / sizeof(uint64_t); ++nWord)
+        {
+            sum += words[nWord];
+        }
+        return sum;
+    }
+
+    void producerFunction(ConnectionPtr & connection, int node)
+    {
+        runOnNode(node);
+        connection->willProduce();
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint32_t messageNumber = 0; messageNumber < targetMessageCount; ++messageNumber)
+        {
+            auto words = producerMessage.get<uint64_t>();
+            for(size_t nWord = 0; nWord < messageBytes / sizeof(uint64_t); ++nWord)
+            {
+                words[nWord] = messageNumber + nWord;
+            }
+            producerMessage.setUsed(messageBytes);
+            producer.publish(producerMessage);
+        }
+    }
+
+    /// @brief Read each message on node and pass it on, as a consumer thread followed by SendToQueue does.
+    /// A block from another pool is copied rather than swapped so it stays on its own node.
+    void relayFunction(ConnectionPtr & inConnection, ConnectionPtr & outConnection, int node, uint64_t & checksum)
+    {
+        runOnNode(node);
+        Consumer consumer(inConnection);
+        Message consumerMessage(inConnection);
+        outConnection->willProduce();
+        Producer producer(outConnection);
+        Message copy(outConnection);
+        ++threadsReady;
+        uint64_t sum = 0;
+        for(uint32_t messageNumber = 0; messageNumber < targetMessageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            sum += readAll(consumerMessage);
+            if(outConnection->owns(consumerMessage))
+            {
+                producer.publish(consumerMessage);
+            }
+            else
+            {
+                copy.appendBinaryCopy(consumerMessage.get(), consumerMessage.getUsed());
+                producer.publish(copy);
+            }
+        }
+        checksum = sum;
+    }
+
+    /// @param firstNode, secondNode place each queue and the threads that read it.  -1 means both queues share one pool with no placement.
+    void runNuma(const char * name, int firstNode, int secondNode)
+    {
+        WaitStrategy strategy(0, 0, WaitStrategy::FOREVER, std::chrono::nanoseconds(2));
+        CreationParameters parameters(strategy, strategy, false, entryCount, messageBytes);
+        MemoryPoolPtr sharedPool;
+        if(firstNode < 0)
+        {
+            sharedPool = std::make_shared<MemoryPool>(messageBytes, 2 * entryCount + 10);
+        }
+        else
+        {
+            parameters.messageCount_ = entryCount + 10;
+        }
+
+        ConnectionPtr first = std::make_shared<Connection>();
+        parameters.pageOptions_.numaNode_ = firstNode;
+        first->createLocal("First", parameters, sharedPool);
+        ConnectionPtr second = std::make_shared<Connection>();
+        parameters.pageOptions_.numaNode_ = secondNode;
+        second->createLocal("Second", parameters, sharedPool);
+
+        Consumer consumer(second);
+        Message consumerMessage(second);
+        uint64_t relaySum = 0;
+        threadsReady = 0;
+        producerGo = false;
+        std::vector<std::thread> threads;
+        threads.emplace_back(producerFunction, std::ref(first), firstNode);
+        threads.emplace_back(relayFunction, std::ref(first), std::ref(second), firstNode, std::ref(relaySum));
+        while(threadsReady < threads.size())
+        {
+            std::this_thread::yield();
+        }
+        runOnNode(secondNode);
+
+        Stopwatch timer;
+        producerGo = true;
+        uint64_t sum = 0;
+        for(uint32_t messageNumber = 0; messageNumber < targetMessageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            sum += readAll(consumerMessage);
+        }
+        auto lapse = timer.nanoseconds();
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        BOOST_CHECK_EQUAL(relaySum, sum);
+
+        std::cout << std::setw(12) << name << '\t'
+            << std::setw(4) << HighQPageMemory::physicalNode(firstNode) << '\t'
+            << std::setw(4) << HighQPageMemory::physicalNode(secondNode) << '\t'
+            << std::setw(10) << lapse / targetMessageCount << std::endl;
+    }
+}
+
+#define ENABLE_NumaPerformance 1
+#if ! ENABLE_NumaPerformance
+#pragma message ("ENABLE_NumaPerformance")
+#else // ENABLE_NumaPerformance
+BOOST_AUTO_TEST_CASE(testNumaPerformance)
+{
+    // Producer -> First queue -> relay -> Second queue -> consumer.  The producer and relay run on the first
+    // node, the consumer on the second.  On a machine with one node the second node is emulated by the first,
+    // so the placement is exercised but the timings show only the cost of the copy.
+    std::cerr << "***** BEGIN NumaPerformance test *****" << std::endl;
+    std::cout << "NUMA nodes: " << HighQPageMemory::nodeCount() << std::endl;
+    std::cout << std::setw(12) << "Memory" << '\t'
+        << std::setw(4) << "From" << '\t'
+        << std::setw(4) << "To" << '\t'
+        << std::setw(10) << "ns/msg" << std::endl;
+    runNuma("SharedPool", -1, -1);
+    runNuma("SameNode", 0, 0);
+    runNuma("NodeLocal", 0, 1);
+    std::cerr << "***** END NumaPerformance test *****" << std::endl;
+}
+#endif // ENABLE_NumaPerformance
@@ -0,0 +1,130 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+    volatile bool producerDone = false;
+
+    static const size_t entryCount = 1024;
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    // The consumer spends about this long on each message so it can't keep up.
+    static const uint64_t consumerWork = 500;
+
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount, uint64_t & lapse)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<uint64_t>(messageNumber);
+            producer.publish(producerMessage);
+        }
+        lapse = timer.nanoseconds();
+        producerDone = true;
+    }
+
+    void consumerFunction(ConnectionPtr connection, uint64_t messageCount, uint64_t & consumed, uint64_t & overruns)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        uint64_t expected = 0;
+        while(expected < messageCount)
+        {
+            if(!consumer.tryGetNext(consumerMessage))
+            {
+                if(!producerDone)
+                {
+                    continue;
+                }
+                if(!consumer.tryGetNext(consumerMessage))
+                {
+                    // Everything the producer published has been consumed or overwritten.
+                    break;
+                }
+            }
+            auto messageNumber = *consumerMessage.get<uint64_t>();
+            if(messageNumber < expected)
+            {
+                // the if avoids the performance hit of BOOST_CHECK unless it's needed.
+                BOOST_CHECK(messageNumber >= expected);
+            }
+            expected = messageNumber + 1;
+            ++consumed;
+            auto busyUntil = Stopwatch::now() + consumerWork;
+            while(Stopwatch::now() < busyUntil)
+            {
+            }
+        }
+        overruns = consumer.getOverruns();
+    }
+}
+
+#define ENABLE_OverwritePerformance 1
+#if ! ENABLE_OverwritePerformance
+#pragma message ("ENABLE_OverwritePerformance")
+#else // ENABLE_OverwritePerformance
+BOOST_AUTO_TEST_CASE(testOverwritePerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+
+    std::cerr << "***** BEGIN OverwritePerformance test *****" << std::endl;
+    std::cout << "Consumer works " << consumerWork << " nanoseconds per message." << std::endl;
+    std::cout << std::setw(10) << "Mode" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "Consumed" << '\t'
+        << std::setw(10) << "Overruns" << '\t'
+        << std::setw(18) << "Producer ns/msg" << std::endl;
+    for(int overwrite = 0; overwrite < 2; ++overwrite)
+    {
+        // Waiting for the slow consumer takes a long time, so publish fewer messages.
+        uint64_t messageCount = overwrite ? targetMessageCount : targetMessageCount / 100;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        parameters.overwriteWhenFull_ = overwrite != 0;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Overwrite", parameters);
+
+        threadsReady = 0;
+        producerGo = false;
+        producerDone = false;
+        uint64_t lapse = 0;
+        uint64_t consumed = 0;
+        uint64_t overruns = 0;
+        std::thread consumerThread(consumerFunction, connection, messageCount, std::ref(consumed), std::ref(overruns));
+        std::thread producerThread(producerFunction, connection, messageCount, std::ref(lapse));
+        while(threadsReady < 2)
+        {
+            std::this_thread::yield();
+        }
+        producerGo = true;
+        producerThread.join();
+        consumerThread.join();
+        BOOST_CHECK_EQUAL(messageCount, consumed + overruns);
+
+        std::cout << std::setw(10) << (overwrite ? "Overwrite" : "Wait") << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(10) << consumed << '\t'
+            << std::setw(10) << overruns << '\t'
+            << std::setw(18) << lapse / messageCount << std::endl;
+    }
+    std::cerr << "***** END OverwritePerformance test *****" << std::endl;
+}
+#endif // ENABLE_OverwritePerformance
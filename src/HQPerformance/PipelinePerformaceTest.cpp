@@ -52,7 +52,8 @@ namespace
         PassThru,
         BufferSwap,
         BinaryCopy,
-        CopyConstruct
+        CopyConstruct,
+        PeekCopy
     };
 
     inline
@@ -68,6 +69,8 @@ namespace
             return out << "BinaryCopy";
         case CopyType::CopyConstruct:
             return out << "CopyConstruct";
+        case CopyType::PeekCopy:
+            return out << "PeekCopy";
         default:
             return out << "Unknown";
         }
@@ -144,7 +147,23 @@ namespace
                         break;
                     }
                 }
-
+                case CopyType::PeekCopy:
+                {
+                    // Read the message in place.  The consumer never writes to the entry.
+                    const Message * message;
+                    while((message = consumer.peekNext()) != 0)
+                    {
+                        auto used = message->getUsed();
+                        producerMessage.appendBinaryCopy(message->getConst(), used);
+                        producer.publish(producerMessage);
+                        consumer.releasePeeked();
+                        if(used == 0)
+                        {
+                            return;
+                        }
+                    }
+                    break;
+                }
             }
         }
         catch(const std::exception & ex)
@@ -152,119 +171,145 @@ namespace
             std::cout << "Copy thread failed. " << ex.what() << std::endl;
         }
     }
-}
 
-#define ENABLE_PIPELINEPERFORMANCE 0
-#if ENABLE_PIPELINEPERFORMANCE
-BOOST_AUTO_TEST_CASE(testPipelinePerformance)
-{
-    static const size_t numberOfConsumers = 1;   // Don't change this
-    static const size_t maxNumberOfProducers = 1;   // Don't change this
+    void runPipeline(CopyType copyType, size_t copyLimit, uint32_t targetMessageCount)
+    {
+        static const size_t numberOfConsumers = 1;   // Don't change this
+        static const size_t maxNumberOfProducers = 1;   // Don't change this
 
-    static const size_t copyLimit = 6;       // This you can change.
+        static const size_t entryCount = 10000;
 
-    static const size_t entryCount = 10000;
-    static const uint32_t targetMessageCount = 100000000; //3000000;
+        size_t queueCount = copyLimit + numberOfConsumers; // need a pool for each object that can receive messages
 
-    static const size_t queueCount = copyLimit + numberOfConsumers; // need a pool for each object that can receive messages
+        // how many buffers do we need?
+        size_t messageCount = entryCount * queueCount + numberOfConsumers + 2 * copyLimit + maxNumberOfProducers;
 
-    // how many buffers do we need?
-    static const size_t messageCount = entryCount * queueCount + numberOfConsumers + 2 * copyLimit + maxNumberOfProducers;
+        static const size_t spinCount = 0;
+        static const size_t yieldCount = 0;//1;//100;
+        static const size_t sleepCount = WaitStrategy::FOREVER;
+        static const std::chrono::nanoseconds sleepPeriod(2);
+        bool peek = copyType == CopyType::PeekCopy;
 
-    static const size_t spinCount = 0;
-    static const size_t yieldCount = 0;//1;//100;
-    static const size_t sleepCount = WaitStrategy::FOREVER;
-    static const std::chrono::nanoseconds sleepPeriod(2);
-    CopyType copyType = //CopyType::BinaryCopy;
-                      // CopyType::BufferSwap;
-                      CopyType::PassThru;
+        std::cout << "HighQueue Pipeline " << (maxNumberOfProducers + copyLimit + numberOfConsumers) << " stage. Copy type: " << copyType << ": ";
 
-    std::cout << "HighQueue Pipeline " << (maxNumberOfProducers + copyLimit + numberOfConsumers) << " stage. Copy type: " << copyType << ": ";
+        WaitStrategy strategy(spinCount, yieldCount, sleepCount, sleepPeriod);
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageBytes);
+        MemoryPoolPtr memoryPool(new MemoryPool(messageBytes, messageCount));
 
-    WaitStrategy strategy(spinCount, yieldCount, sleepCount, sleepPeriod);
-    bool discardMessagesIfNoConsumer = false;
-    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageBytes);
-    MemoryPoolPtr memoryPool(new MemoryPool(messageBytes, messageCount));
+        std::vector<std::shared_ptr<Connection> > connections;
+        for(size_t nConn = 0; nConn < copyLimit + numberOfConsumers; ++nConn)
+        {
+            std::shared_ptr<Connection> connection(new Connection);
+            connections.push_back(connection);
+            std::stringstream name;
+            name << "Connection " << nConn;
+            connection->createLocal(name.str(), parameters, memoryPool);
+        }
 
-    std::vector<std::shared_ptr<Connection> > connections;
-    for(size_t nConn = 0; nConn < copyLimit + numberOfConsumers; ++nConn)
-    {
-        std::shared_ptr<Connection> connection(new Connection);
-        connections.push_back(connection);
-        std::stringstream name;
-        name << "Connection " << nConn;
-        connection->createLocal(name.str(), parameters, memoryPool);
-    }
+        // The consumer listens to the last connection
+        Consumer consumer(connections.back());
+        Message consumerMessage(connections.back());
+
+        producerGo = false;
+        threadsReady = 0;
+#if VALIDATE_OUTPUT 
+        uint64_t nextMessage = 0u;
+#endif // VALIDATE_OUTPUT
 
-    // The consumer listens to the last connection
-    Consumer consumer(connections.back());
-    Message consumerMessage(connections.back());
-    
-    producerGo = false;
-    threadsReady = 0;
-    uint64_t nextMessage = 0u;
+        // Each copy thread listens to connection N-1 and sends to thread N
+        std::vector<std::thread> threads;
+        for(size_t nCopy = connections.size() - 1; nCopy > 0; --nCopy)
+        {
+            threads.emplace_back(std::bind(copyFunction,
+                connections[nCopy - 1],
+                connections[nCopy],
+                copyType)
+                );
+        }
 
-    // Each copy thread listens to connection N-1 and sends to thread N
-    std::vector<std::thread> threads;
-    for(size_t nCopy = connections.size() - 1; nCopy > 0; --nCopy)
-    {
-        threads.emplace_back(std::bind(copyFunction,
-            connections[nCopy - 1],
-            connections[nCopy],
-            copyType)
-            );
-    }
+        // The producer sends targetMessageCount messages to connection 0
+        threads.emplace_back(
+            std::bind(producerFunction, connections[0], 1, targetMessageCount));
 
-    // The producer sends targetMessageCount messages to connection 0
-    threads.emplace_back(
-        std::bind(producerFunction, connections[0], 1, targetMessageCount));
- 
-    // All wired up, ready to go.  Wait for the threads to initialize.
-    while(threadsReady < threads.size())
-    {
-        std::this_thread::yield();
-    }
+        // All wired up, ready to go.  Wait for the threads to initialize.
+        while(threadsReady < threads.size())
+        {
+            std::this_thread::yield();
+        }
 
-    Stopwatch timer;
-    producerGo = true;
+        Stopwatch timer;
+        producerGo = true;
 
-    for(uint64_t messageNumber = 0; messageNumber < targetMessageCount; ++messageNumber)
-    {
-        consumer.getNext(consumerMessage);
+        for(uint64_t messageNumber = 0; messageNumber < targetMessageCount; ++messageNumber)
+        {
+            if(peek)
+            {
+                consumer.peekNext();
+                consumer.releasePeeked();
+                continue;
+            }
+            consumer.getNext(consumerMessage);
 #if VALIDATE_OUTPUT 
-        auto testMessage = consumerMessage.read<ActualMessage>();
-        testMessage->touch();
-        if(nextMessage != testMessage->getSequence())
+            auto testMessage = consumerMessage.read<ActualMessage>();
+            testMessage->touch();
+            if(nextMessage != testMessage->getSequence())
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(nextMessage, testMessage->getSequence());
+            }
+            consumerMessage.destroy<ActualMessage>();
+            ++ nextMessage;
+#endif // VALIDATE_OUTPUT
+        }
+
+        auto lapse = timer.nanoseconds();
+
+        for(auto & thread: threads)
         {
-            // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
-            BOOST_CHECK_EQUAL(nextMessage, testMessage->getSequence());
+            thread.join();
         }
-        consumerMessage.destroy<ActualMessage>();
-        ++ nextMessage;
-#endif // VALIDATE_OUTPUT
-    }
 
-    auto lapse = timer.nanoseconds();
-    
-    for(auto & thread: threads)
-    {
-        thread.join();
+        std::cout << " Passed " << targetMessageCount << ' ' << messageBytes << " byte messages in "
+            << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << " seconds.  ";
+        if(lapse == 0)
+        {
+            std::cout << "Run time too short to measure.  Increase targetMessageCount." << std::endl;
+        }
+        else
+        {
+            std::cout
+                << lapse / targetMessageCount << " nsec./message "
+                << std::setprecision(3) << (double(targetMessageCount) * 1000.0L) / double(lapse) << " MMsg/second "
+                << std::endl;
+        }
+        consumer.writeStats(std::cerr);
+        std::cerr << std::endl;
     }
+}
 
-    std::cout << " Passed " << targetMessageCount << ' ' << messageBytes << " byte messages in "
-        << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << " seconds.  ";
-    if(lapse == 0)
-    {
-        std::cout << "Run time too short to measure.  Increase targetMessageCount." << std::endl;
-    }
-    else
-    {
-        std::cout
-            << lapse / targetMessageCount << " nsec./message "
-            << std::setprecision(3) << (double(targetMessageCount) * 1000.0L) / double(lapse) << " MMsg/second "
-            << std::endl;
-    }
-    consumer.writeStats(std::cerr);
-    std::cerr << std::endl;
+#define ENABLE_PIPELINEPERFORMANCE 0
+#if ENABLE_PIPELINEPERFORMANCE
+BOOST_AUTO_TEST_CASE(testPipelinePerformance)
+{
+    static const size_t copyLimit = 6;       // This you can change.
+    static const uint32_t targetMessageCount = 100000000; //3000000;
+    CopyType copyType = //CopyType::BinaryCopy;
+                      // CopyType::BufferSwap;
+                      CopyType::PassThru;
+    runPipeline(copyType, copyLimit, targetMessageCount);
+}
+#endif // ENABLE_PIPELINEPERFORMANCE
+
+#define ENABLE_PEEKPIPELINEPERFORMANCE 1
+#if ENABLE_PEEKPIPELINEPERFORMANCE
+BOOST_AUTO_TEST_CASE(testPeekPipelinePerformance)
+{
+    // Every stage copies each message.  Compare taking the message with tryGetNext()/getNext()
+    // to reading it in place with peekNext()/releasePeeked().
+    static const size_t copyLimit = 3;
+    static const uint32_t targetMessageCount = 10000000;
+    runPipeline(CopyType::BinaryCopy, copyLimit, targetMessageCount);
+    runPipeline(CopyType::PeekCopy, copyLimit, targetMessageCount);
 }
-#endif // ENABLEORDEREDMERGEPERFORMANCE
+#endif // ENABLE_PEEKPIPELINEPERFORMANCE
@@ -0,0 +1,117 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+#include <Mocks/MockMessage.hpp>
+
+using namespace HighQueue;
+typedef MockMessage<13> ActualMessage;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    static const size_t entryCount = 8192; // a power of two so the specialized build can mask
+    static const uint64_t targetMessageCount = 1000000 * 100;
+
+    typedef BasicProducer<Solo, PollingWait, NoDiscard, PowerOfTwoEntryCount> SpecializedProducer;
+    typedef BasicConsumer<PollingWait, PowerOfTwoEntryCount> SpecializedConsumer;
+
+    template <typename ProducerType>
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        ProducerType producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<ActualMessage>(1, messageNumber);
+            producer.publish(producerMessage);
+        }
+    }
+
+    template <typename ConsumerType>
+    void consumerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        ConsumerType consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto testMessage = consumerMessage.get<ActualMessage>();
+            if(messageNumber != testMessage->getSequence())
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+            }
+        }
+    }
+
+    template <typename ProducerType, typename ConsumerType>
+    void runTest(const char * title, uint64_t messageCount)
+    {
+        static const size_t spinCount = 100;
+        static const size_t yieldCount = WaitStrategy::FOREVER;
+        WaitStrategy strategy(spinCount, yieldCount);
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(ActualMessage), entryCount + 10);
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Policies", parameters);
+        connection->willProduce();
+
+        threadsReady = 0;
+        producerGo = false;
+        std::thread consumerThread(consumerFunction<ConsumerType>, connection, messageCount);
+        std::thread producerThread(producerFunction<ProducerType>, connection, messageCount);
+        while(threadsReady < 2)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        producerGo = true;
+        producerThread.join();
+        consumerThread.join();
+        auto lapse = timer.nanoseconds();
+
+        std::cout << std::setw(12) << title << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(10) << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << '\t'
+            << std::setw(18) << lapse / messageCount << '\t';
+        if(lapse == 0)
+        {
+            std::cout << "0\tRun time too short to measure.   Use a larger messageCount" << std::endl;
+        }
+        else
+        {
+            std::cout << std::setw(16) << std::setprecision(3) << double(messageCount * 1000) / double(lapse)
+                << std::endl;
+        }
+    }
+}
+
+#define ENABLE_PolicyPerformance 1
+#if ! ENABLE_PolicyPerformance
+#pragma message ("ENABLE_PolicyPerformance")
+#else // ENABLE_PolicyPerformance
+BOOST_AUTO_TEST_CASE(testPolicyPerformance)
+{
+    std::cerr << "***** BEGIN PolicyPerformance test *****" << std::endl;
+    std::cout << std::setw(12) << "Build" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "Seconds" << '\t'
+        << std::setw(18) << "Nanosecond/message" << '\t'
+        << std::setw(16) << "M message/second" << std::endl;
+    runTest<Producer, Consumer>("Generic", targetMessageCount);
+    runTest<SpecializedProducer, SpecializedConsumer>("Specialized", targetMessageCount);
+    std::cerr << "***** END PolicyPerformance test *****" << std::endl;
+}
+#endif // ENABLE_PolicyPerformance
@@ -0,0 +1,347 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/details/HQMemoryBlockPool.hpp>
+#include <Common/SpinLock.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    static const size_t messageSize = 100;
+    static const size_t heldCount = 2;
+    static const uint64_t targetOperationCount = 1000000 * 4;
+
+    /// @brief Lets a Message be constructed without memory so the test can allocate it explicitly.
+    struct NoAllocation
+    {
+        void allocate(Message &)
+        {
+        }
+    };
+
+    /// @brief The pool's free list as it was before it became lock-free: a SpinLock around the root offset.
+    /// Takes every block from an HQMemoryBlockPool and manages them itself.
+    class SpinLockFreeList
+    {
+    public:
+        explicit SpinLockFreeList(HQMemoryBlockPool * pool)
+            : pool_(pool)
+            , base_(reinterpret_cast<byte_t *>(pool))
+            , root_(NULL_OFFSET)
+        {
+            NoAllocation noAllocation;
+            auto allocator = &noAllocation;
+            Message message(allocator);
+            while(pool_->tryAllocate(message))
+            {
+                *message.get<size_t>() = root_;
+                root_ = message.getOffset();
+                message.reset();
+            }
+        }
+
+        bool tryAllocate(Message & message)
+        {
+            SpinLock::Guard guard(lock_);
+            auto offset = root_;
+            if(offset == NULL_OFFSET)
+            {
+                return false;
+            }
+            root_ = reinterpret_cast<size_t &>(base_[offset]);
+            message.set(pool_, pool_->getBlockCapacity(), offset, 0);
+            return true;
+        }
+
+        void release(Message & message)
+        {
+            SpinLock::Guard guard(lock_);
+            *message.get<size_t>() = root_;
+            root_ = message.getOffset();
+            message.reset();
+        }
+
+        static const size_t cachedPerThread = 0;
+
+    private:
+        static const size_t NULL_OFFSET = ~size_t(0);
+        HQMemoryBlockPool * pool_;
+        byte_t * base_;
+        size_t root_;
+        SpinLock lock_;
+    };
+
+    /// @brief The pool itself.
+    class LockFreeList
+    {
+    public:
+        static const size_t cachedPerThread = 0;
+
+        explicit LockFreeList(HQMemoryBlockPool * pool)
+            : pool_(pool)
+        {
+        }
+
+        bool tryAllocate(Message & message)
+        {
+            return pool_->tryAllocate(message);
+        }
+
+        void release(Message & message)
+        {
+            pool_->release(message);
+        }
+
+    private:
+        HQMemoryBlockPool * pool_;
+    };
+
+    /// @brief The pool with a cache of free blocks for each thread.
+    class CachedList
+    {
+    public:
+        static const size_t batchSize = 32;
+        static const size_t cachedPerThread = batchSize * 2;
+
+        explicit CachedList(HQMemoryBlockPool * pool)
+            : pool_(pool)
+        {
+            pool_->enableThreadCaches(batchSize);
+        }
+
+        ~CachedList()
+        {
+            pool_->retireThreadCaches();
+        }
+
+        bool tryAllocate(Message & message)
+        {
+            return pool_->tryAllocate(message);
+        }
+
+        void release(Message & message)
+        {
+            pool_->release(message);
+        }
+
+    private:
+        HQMemoryBlockPool * pool_;
+    };
+
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool threadsGo = false;
+
+    template <typename FreeList>
+    void allocatorFunction(FreeList & freeList, uint64_t operationCount, std::atomic<uint64_t> & failures)
+    {
+        NoAllocation noAllocation;
+        auto allocator = &noAllocation;
+        std::vector<std::unique_ptr<Message>> messages;
+        for(size_t nMessage = 0; nMessage < heldCount; ++nMessage)
+        {
+            messages.emplace_back(new Message(allocator));
+        }
+        uint64_t failed = 0;
+        ++threadsReady;
+        while(!threadsGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t nOperation = 0; nOperation < operationCount; nOperation += heldCount)
+        {
+            for(auto & message : messages)
+            {
+                if(freeList.tryAllocate(*message))
+                {
+                    *message->get<uint64_t>() = nOperation;
+                }
+                else
+                {
+                    ++failed;
+                }
+            }
+            for(auto & message : messages)
+            {
+                if(message->getContainer() != 0)
+                {
+                    freeList.release(*message);
+                }
+            }
+        }
+        failures += failed;
+    }
+
+    /// @brief Like allocatorFunction, but each round uses the next of several size classes.
+    template <typename FreeList>
+    void classesFunction(std::vector<std::unique_ptr<FreeList>> & freeLists, uint64_t operationCount, std::atomic<uint64_t> & failures)
+    {
+        NoAllocation noAllocation;
+        auto allocator = &noAllocation;
+        std::vector<std::unique_ptr<Message>> messages;
+        for(size_t nMessage = 0; nMessage < heldCount; ++nMessage)
+        {
+            messages.emplace_back(new Message(allocator));
+        }
+        uint64_t failed = 0;
+        size_t nClass = 0;
+        ++threadsReady;
+        while(!threadsGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t nOperation = 0; nOperation < operationCount; nOperation += heldCount)
+        {
+            auto & freeList = *freeLists[nClass];
+            nClass = (nClass + 1) % freeLists.size();
+            for(auto & message : messages)
+            {
+                if(freeList.tryAllocate(*message))
+                {
+                    *message->get<uint64_t>() = nOperation;
+                }
+                else
+                {
+                    ++failed;
+                }
+            }
+            for(auto & message : messages)
+            {
+                if(message->getContainer() != 0)
+                {
+                    freeList.release(*message);
+                }
+            }
+        }
+        failures += failed;
+    }
+
+    /// @returns nanoseconds per allocate and release of one block.
+    template <typename FreeList>
+    uint64_t runContention(size_t threadCount)
+    {
+        size_t messageCount = threadCount * (heldCount + FreeList::cachedPerThread);
+        size_t poolSize = HQMemoryBlockPool::spaceNeeded(messageSize, messageCount);
+        std::unique_ptr<byte_t[]> block(new byte_t[poolSize]);
+        auto pool = new (block.get()) HQMemoryBlockPool(poolSize, messageSize);
+        FreeList freeList(pool);
+
+        uint64_t operationCount = targetOperationCount / threadCount;
+        std::atomic<uint64_t> failures(0);
+        threadsReady = 0;
+        threadsGo = false;
+        std::vector<std::thread> threads;
+        for(size_t nThread = 0; nThread < threadCount; ++nThread)
+        {
+            threads.emplace_back(allocatorFunction<FreeList>, std::ref(freeList), operationCount, std::ref(failures));
+        }
+        while(threadsReady < threadCount)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        threadsGo = true;
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        auto lapse = timer.nanoseconds();
+        BOOST_CHECK_EQUAL(0u, failures.load());
+        return lapse / (operationCount * threadCount);
+    }
+
+    /// @returns nanoseconds per allocate and release of one block when every thread uses classCount size classes.
+    template <typename FreeList>
+    uint64_t runClasses(size_t threadCount, size_t classCount)
+    {
+        size_t messageCount = threadCount * (heldCount + FreeList::cachedPerThread);
+        std::vector<std::unique_ptr<byte_t[]>> blocks;
+        std::vector<std::unique_ptr<FreeList>> freeLists;
+        for(size_t nClass = 0; nClass < classCount; ++nClass)
+        {
+            // Each class holds messages one cache line larger than the last.
+            size_t classMessageSize = messageSize + nClass * CacheLineSize;
+            size_t poolSize = HQMemoryBlockPool::spaceNeeded(classMessageSize, messageCount);
+            blocks.emplace_back(new byte_t[poolSize]);
+            auto pool = new (blocks.back().get()) HQMemoryBlockPool(poolSize, classMessageSize);
+            freeLists.emplace_back(new FreeList(pool));
+        }
+
+        uint64_t operationCount = targetOperationCount / threadCount;
+        std::atomic<uint64_t> failures(0);
+        threadsReady = 0;
+        threadsGo = false;
+        std::vector<std::thread> threads;
+        for(size_t nThread = 0; nThread < threadCount; ++nThread)
+        {
+            threads.emplace_back(classesFunction<FreeList>, std::ref(freeLists), operationCount, std::ref(failures));
+        }
+        while(threadsReady < threadCount)
+        {
+            std::this_thread::yield();
+        }
+        Stopwatch timer;
+        threadsGo = true;
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        auto lapse = timer.nanoseconds();
+        BOOST_CHECK_EQUAL(0u, failures.load());
+        return lapse / (operationCount * threadCount);
+    }
+}
+
+#define ENABLE_PoolContentionPerformance 1
+#if ! ENABLE_PoolContentionPerformance
+#pragma message ("ENABLE_PoolContentionPerformance")
+#else // ENABLE_PoolContentionPerformance
+BOOST_AUTO_TEST_CASE(testPoolContentionPerformance)
+{
+    static const size_t threadCounts[] = {1, 2, 4, 8, 16};
+    std::cerr << "***** BEGIN PoolContentionPerformance test *****" << std::endl;
+    std::cout << std::setw(10) << "Threads" << '\t'
+        << std::setw(14) << "SpinLock ns/op" << '\t'
+        << std::setw(14) << "LockFree ns/op" << '\t'
+        << std::setw(14) << "Cached ns/op" << std::endl;
+    for(auto threadCount : threadCounts)
+    {
+        auto spinLock = runContention<SpinLockFreeList>(threadCount);
+        auto lockFree = runContention<LockFreeList>(threadCount);
+        auto cached = runContention<CachedList>(threadCount);
+        std::cout << std::setw(10) << threadCount << '\t'
+            << std::setw(14) << spinLock << '\t'
+            << std::setw(14) << lockFree << '\t'
+            << std::setw(14) << cached << std::endl;
+    }
+    std::cerr << "***** END PoolContentionPerformance test *****" << std::endl;
+}
+#endif // ENABLE_PoolContentionPerformance
+
+#define ENABLE_PoolClassesPerformance 1
+#if ! ENABLE_PoolClassesPerformance
+#pragma message ("ENABLE_PoolClassesPerformance")
+#else // ENABLE_PoolClassesPerformance
+BOOST_AUTO_TEST_CASE(testPoolClassesPerformance)
+{
+    // More size classes than a thread used to keep caches for.
+    static const size_t classCount = 8;
+    static const size_t threadCounts[] = {1, 2, 4, 8, 16};
+    std::cerr << "***** BEGIN PoolClassesPerformance test *****" << std::endl;
+    std::cout << classCount << " size classes" << std::endl;
+    std::cout << std::setw(10) << "Threads" << '\t'
+        << std::setw(14) << "LockFree ns/op" << '\t'
+        << std::setw(14) << "Cached ns/op" << std::endl;
+    for(auto threadCount : threadCounts)
+    {
+        auto lockFree = runClasses<LockFreeList>(threadCount, classCount);
+        auto cached = runClasses<CachedList>(threadCount, classCount);
+        std::cout << std::setw(10) << threadCount << '\t'
+            << std::setw(14) << lockFree << '\t'
+            << std::setw(14) << cached << std::endl;
+    }
+    std::cerr << "***** END PoolClassesPerformance test *****" << std::endl;
+}
+#endif // ENABLE_PoolClassesPerformance
@@ -0,0 +1,96 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <HighQueue/MessageArray.hpp>
+#include <Common/Stopwatch.hpp>
+#include <Mocks/MockMessage.hpp>
+
+using namespace HighQueue;
+typedef LargeMockMessage ActualMessage;
+
+namespace
+{
+    // 64K entries of 128 bytes plus a pool of 64K messages of about 1K: far bigger than L2 (and most L3s)
+    static const size_t entryCount = 1024 * 64;
+    static const size_t rounds = 20;
+    static const size_t batchSize = 64;
+
+    /// @brief Fill the HighQueue, then time emptying it so the consumer finds nothing in cache.
+    /// @returns nanoseconds spent consuming.
+    uint64_t drain(Producer & producer, Message & producerMessage, Consumer & consumer, Message * messages, size_t limit, uint32_t & checksum)
+    {
+        for(uint32_t messageNumber = 0; messageNumber < entryCount; ++messageNumber)
+        {
+            producerMessage.emplace<ActualMessage>(1, messageNumber);
+            producer.publish(producerMessage);
+        }
+        Stopwatch timer;
+        size_t consumed = 0;
+        while(consumed < entryCount)
+        {
+            size_t count = limit == 1
+                ? (consumer.tryGetNext(messages[0]) ? 1 : 0)
+                : consumer.tryGetNextBatch(messages, limit);
+            for(size_t nMessage = 0; nMessage < count; ++nMessage)
+            {
+                auto testMessage = messages[nMessage].get<ActualMessage>();
+                if(testMessage->getSequence() != consumed + nMessage)
+                {
+                    // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                    BOOST_CHECK_EQUAL(consumed + nMessage, testMessage->getSequence());
+                }
+                checksum += testMessage->touch();
+            }
+            consumed += count;
+        }
+        return timer.nanoseconds();
+    }
+}
+
+#define ENABLE_PrefetchPerformance 1
+#if ! ENABLE_PrefetchPerformance
+#pragma message ("ENABLE_PrefetchPerformance")
+#else // ENABLE_PrefetchPerformance
+BOOST_AUTO_TEST_CASE(testPrefetchPerformance)
+{
+    WaitStrategy strategy;
+    bool discardMessagesIfNoConsumer = false;
+    static const size_t distances[] = {0, 1, 2, 4, 8, 16};
+
+    std::cerr << "***** BEGIN PrefetchPerformance test *****" << std::endl;
+    std::cout << std::setw(10) << "Distance" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(12) << "Single ns" << '\t'
+        << std::setw(12) << "Batch ns" << std::endl;
+    // Report the best round: other activity on the machine only ever makes a round slower.
+    uint32_t checksum = 0;
+    for(auto distance : distances)
+    {
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(ActualMessage), entryCount + batchSize + 10);
+        parameters.prefetchDistance_ = distance;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Prefetch", parameters);
+        Producer producer(connection);
+        Consumer consumer(connection);
+        Message producerMessage(connection);
+        MessageArray messages(connection, batchSize);
+
+        uint64_t singleLapse = ~uint64_t(0);
+        uint64_t batchLapse = ~uint64_t(0);
+        for(size_t round = 0; round < rounds; ++round)
+        {
+            singleLapse = std::min(singleLapse, drain(producer, producerMessage, consumer, messages.get(), 1, checksum));
+            batchLapse = std::min(batchLapse, drain(producer, producerMessage, consumer, messages.get(), batchSize, checksum));
+        }
+        std::cout << std::setw(10) << distance << '\t'
+            << std::setw(10) << entryCount * rounds << '\t'
+            << std::setw(12) << singleLapse / entryCount << '\t'
+            << std::setw(12) << batchLapse / entryCount << std::endl;
+    }
+    std::cerr << "Checksum " << checksum << std::endl;
+    std::cerr << "***** END PrefetchPerformance test *****" << std::endl;
+}
+#endif // ENABLE_PrefetchPerformance
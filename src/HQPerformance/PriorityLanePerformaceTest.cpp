@@ -0,0 +1,152 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+    volatile bool dataStop = false;
+    volatile bool dataDone = false;
+
+    static const size_t entryCount = 1024;
+    static const uint64_t heartbeatCount = 1000;
+    // Heartbeats are this far apart.
+    static const uint64_t heartbeatInterval = 100000;
+    // The consumer spends about this long on each data message so the data producer keeps the queue full.
+    static const uint64_t consumerWork = 200;
+
+    void dataProducerFunction(ConnectionPtr connection, uint64_t & published)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        while(!dataStop)
+        {
+            producerMessage.emplace<uint64_t>(published);
+            producerMessage.setType(Message::MessageType::MockMessage);
+            producer.publish(producerMessage);
+            ++published;
+        }
+        dataDone = true;
+    }
+
+    void heartbeatProducerFunction(ConnectionPtr connection)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t heartbeat = 0; heartbeat < heartbeatCount; ++heartbeat)
+        {
+            auto sendAt = Stopwatch::now() + heartbeatInterval;
+            while(Stopwatch::now() < sendAt)
+            {
+                std::this_thread::yield();
+            }
+            // Publish() sends Heartbeats to the highest lane if there is one.
+            producerMessage.emplace<uint64_t>(Stopwatch::now());
+            producerMessage.setType(Message::MessageType::Heartbeat);
+            producer.publish(producerMessage);
+        }
+    }
+
+    void consumerFunction(ConnectionPtr connection, std::vector<uint64_t> & latencies)
+    {
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        ++threadsReady;
+        while(!dataDone || consumer.tryGetNext(consumerMessage))
+        {
+            if(!consumer.tryGetNext(consumerMessage))
+            {
+                continue;
+            }
+            if(consumerMessage.getType() == Message::MessageType::Heartbeat)
+            {
+                latencies.push_back(Stopwatch::now() - *consumerMessage.get<uint64_t>());
+                if(latencies.size() == heartbeatCount)
+                {
+                    dataStop = true;
+                }
+                continue;
+            }
+            auto busyUntil = Stopwatch::now() + consumerWork;
+            while(Stopwatch::now() < busyUntil)
+            {
+            }
+        }
+    }
+}
+
+#define ENABLE_PriorityLanePerformance 1
+#if ! ENABLE_PriorityLanePerformance
+#pragma message ("ENABLE_PriorityLanePerformance")
+#else // ENABLE_PriorityLanePerformance
+BOOST_AUTO_TEST_CASE(testPriorityLanePerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+
+    std::cerr << "***** BEGIN PriorityLanePerformance test *****" << std::endl;
+    std::cout << "Consumer works " << consumerWork << " nanoseconds per data message. "
+        << entryCount << " entries." << std::endl;
+    std::cout << std::setw(10) << "Lanes" << '\t'
+        << std::setw(10) << "Data" << '\t'
+        << std::setw(10) << "Heartbeats" << '\t'
+        << std::setw(14) << "Median ns" << '\t'
+        << std::setw(14) << "99% ns" << '\t'
+        << std::setw(14) << "Max ns" << std::endl;
+    for(size_t lanes = 0; lanes < 2; ++lanes)
+    {
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        parameters.priorityLanes_ = lanes;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("PriorityLanes", parameters);
+
+        threadsReady = 0;
+        producerGo = false;
+        dataStop = false;
+        dataDone = false;
+        uint64_t published = 0;
+        std::vector<uint64_t> latencies;
+        latencies.reserve(heartbeatCount);
+        std::thread consumerThread(consumerFunction, connection, std::ref(latencies));
+        std::thread dataThread(dataProducerFunction, connection, std::ref(published));
+        std::thread heartbeatThread(heartbeatProducerFunction, connection);
+        while(threadsReady < 3)
+        {
+            std::this_thread::yield();
+        }
+        producerGo = true;
+        heartbeatThread.join();
+        dataThread.join();
+        consumerThread.join();
+        BOOST_CHECK_EQUAL(heartbeatCount, latencies.size());
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::setw(10) << lanes << '\t'
+            << std::setw(10) << published << '\t'
+            << std::setw(10) << latencies.size() << '\t'
+            << std::setw(14) << latencies[latencies.size() / 2] << '\t'
+            << std::setw(14) << latencies[latencies.size() * 99 / 100] << '\t'
+            << std::setw(14) << latencies.back() << std::endl;
+    }
+    std::cerr << "***** END PriorityLanePerformance test *****" << std::endl;
+}
+#endif // ENABLE_PriorityLanePerformance
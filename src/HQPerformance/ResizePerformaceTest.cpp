@@ -0,0 +1,103 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+
+using namespace HighQueue;
+
+namespace
+{
+    volatile std::atomic<uint32_t> threadsReady;
+    volatile bool producerGo = false;
+
+    static const size_t entryCount = 1024;
+    static const size_t maxEntryCount = 1024 * 16;
+    static const uint64_t targetMessageCount = 1000000 * 10;
+    // In Resizing mode the consumer asks for a new size this often.
+    static const uint64_t resizeInterval = 10000;
+
+    void producerFunction(ConnectionPtr connection, uint64_t messageCount)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        ++threadsReady;
+        while(!producerGo)
+        {
+            std::this_thread::yield();
+        }
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            producerMessage.emplace<uint64_t>(messageNumber);
+            producer.publish(producerMessage);
+        }
+    }
+}
+
+#define ENABLE_ResizePerformance 1
+#if ! ENABLE_ResizePerformance
+#pragma message ("ENABLE_ResizePerformance")
+#else // ENABLE_ResizePerformance
+BOOST_AUTO_TEST_CASE(testResizePerformance)
+{
+    static const size_t spinCount = 100;
+    static const size_t yieldCount = WaitStrategy::FOREVER;
+    WaitStrategy strategy(spinCount, yieldCount);
+    bool discardMessagesIfNoConsumer = false;
+    static const char * modes[] = {"Fixed", "Resizable", "Resizing"};
+
+    std::cerr << "***** BEGIN ResizePerformance test *****" << std::endl;
+    std::cout << std::setw(10) << "Mode" << '\t'
+        << std::setw(10) << "Messages" << '\t'
+        << std::setw(10) << "Resizes" << '\t'
+        << std::setw(10) << "ns/msg" << std::endl;
+    for(int mode = 0; mode < 3; ++mode)
+    {
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        parameters.maxEntryCount_ = mode == 0 ? 0 : maxEntryCount;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Resize", parameters);
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+
+        threadsReady = 0;
+        producerGo = false;
+        uint64_t messageCount = targetMessageCount;
+        std::thread producerThread(producerFunction, connection, messageCount);
+        while(threadsReady < 1)
+        {
+            std::this_thread::yield();
+        }
+        size_t resizes = 0;
+        size_t nextSize = entryCount * 2;
+        Stopwatch timer;
+        producerGo = true;
+        for(uint64_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto value = *consumerMessage.get<uint64_t>();
+            if(value != messageNumber)
+            {
+                // the if avoids the performance hit of BOOST_CHECK unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, value);
+            }
+            if(mode == 2 && messageNumber % resizeInterval == 0 && connection->resize(nextSize))
+            {
+                ++resizes;
+                // Cycle between entryCount and maxEntryCount.
+                nextSize = nextSize >= maxEntryCount ? entryCount : nextSize * 2;
+            }
+        }
+        auto lapse = timer.nanoseconds();
+        producerThread.join();
+
+        std::cout << std::setw(10) << modes[mode] << '\t'
+            << std::setw(10) << messageCount << '\t'
+            << std::setw(10) << resizes << '\t'
+            << std::setw(10) << lapse / messageCount << std::endl;
+    }
+    std::cerr << "***** END ResizePerformance test *****" << std::endl;
+}
+#endif // ENABLE_ResizePerformance
@@ -0,0 +1,138 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+#include <Mocks/MockMessage.hpp>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif // _WIN32
+
+using namespace HighQueue;
+typedef MockMessage<13> ActualMessage;
+
+namespace
+{
+    const std::string queueName = "HQSharedMemoryPerformance";
+
+    /// @brief Runs in the child process.  Attach to the queue and publish messageCount messages.
+    /// @param pacing if nonzero, spin this many nanoseconds between messages so latency is not hidden by queueing.
+    int producerProcess(uint32_t messageCount, uint64_t pacing)
+    {
+        try
+        {
+            ConnectionPtr connection = std::make_shared<Connection>();
+            connection->openExistingShared(queueName);
+            Producer producer(connection);
+            Message producerMessage(connection);
+            for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+            {
+                if(pacing != 0)
+                {
+                    auto next = Stopwatch::now() + pacing;
+                    while(Stopwatch::now() < next)
+                    {
+                        spinDelay();
+                    }
+                }
+                producerMessage.emplace<ActualMessage>(1, messageNumber);
+                producerMessage.setTimestamp(Stopwatch::now());
+                producer.publish(producerMessage);
+            }
+        }
+        catch(const std::exception & ex)
+        {
+            std::cerr << "Producer process failed. " << ex.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    void runTwoProcessTest(const char * title, uint32_t messageCount, uint64_t pacing)
+    {
+        static const size_t entryCount = 100000;
+        static const size_t spinCount = 1000;
+        static const size_t yieldCount = WaitStrategy::FOREVER;
+
+        WaitStrategy strategy(spinCount, yieldCount);
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(ActualMessage), entryCount + 10);
+
+        Connection::removeShared(queueName);
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->openOrCreateShared(queueName, parameters);
+        {
+            Consumer consumer(connection);
+            Message consumerMessage(connection);
+
+            std::cout.flush();
+            std::cerr.flush();
+            Stopwatch timer;
+            pid_t child = fork();
+            if(child == 0)
+            {
+                _exit(producerProcess(messageCount, pacing));
+            }
+            BOOST_REQUIRE(child > 0);
+
+            uint64_t totalLatency = 0;
+            uint64_t maxLatency = 0;
+            for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+            {
+                consumer.getNext(consumerMessage);
+                auto now = Stopwatch::now();
+                auto testMessage = consumerMessage.get<ActualMessage>();
+                if(messageNumber != testMessage->getSequence())
+                {
+                    // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                    BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+                }
+                auto latency = now - consumerMessage.getTimestamp();
+                totalLatency += latency;
+                if(latency > maxLatency)
+                {
+                    maxLatency = latency;
+                }
+            }
+            auto lapse = timer.nanoseconds();
+
+            int status = 0;
+            waitpid(child, &status, 0);
+            BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+            std::cout << "HighQueue shared memory " << title << ": Passed " << messageCount << ' ' << sizeof(ActualMessage)
+                << " byte messages between processes in "
+                << std::setprecision(9) << double(lapse) / double(Stopwatch::nanosecondsPerSecond) << " seconds.  ";
+            if(lapse == 0)
+            {
+                std::cout << "Run time too short to measure.  Increase messageCount." << std::endl;
+            }
+            else
+            {
+                std::cout << lapse / messageCount << " nsec./message "
+                    << std::setprecision(3) << (double(messageCount) * 1000.0L) / double(lapse) << " MMsg/second "
+                    << "Latency: average " << totalLatency / messageCount << " nsec. max " << maxLatency << " nsec."
+                    << std::endl;
+            }
+            consumer.writeStats(std::cerr);
+        }
+        connection.reset();
+        Connection::removeShared(queueName);
+    }
+}
+
+#define ENABLE_SHARED_MEMORY_PERFORMANCE 1
+#if ENABLE_SHARED_MEMORY_PERFORMANCE && !defined(_WIN32)
+BOOST_AUTO_TEST_CASE(testSharedMemoryPerformance)
+{
+    static const uint32_t throughputMessageCount = 10000000;
+    static const uint32_t latencyMessageCount = 100000;
+    static const uint64_t latencyPacing = 1000; // nanoseconds between messages
+
+    runTwoProcessTest("throughput", throughputMessageCount, 0);
+    runTwoProcessTest("latency", latencyMessageCount, latencyPacing);
+}
+#endif // ENABLE_SHARED_MEMORY_PERFORMANCE
@@ -0,0 +1,101 @@
+#include <Common/HighQueuePch.hpp>
+#define BOOST_TEST_NO_MAIN HighQueuePerformanceTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <Common/Stopwatch.hpp>
+#include <Mocks/MockMessage.hpp>
+
+using namespace HighQueue;
+typedef MockMessage<13> ActualMessage;
+
+namespace
+{
+    /// @brief Publish messageCount messages, one every pacing nanoseconds, so the consumer is usually parked.
+    /// @param publishTime accumulates the nanoseconds spent inside publish()
+    void pacedProducer(ConnectionPtr connection, uint32_t messageCount, uint64_t pacing, uint64_t & publishTime)
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(pacing));
+            producerMessage.emplace<ActualMessage>(1, messageNumber);
+            auto start = Stopwatch::now();
+            producerMessage.setTimestamp(start);
+            producer.publish(producerMessage);
+            publishTime += Stopwatch::now() - start;
+        }
+        producer.writeStats(std::cerr);
+    }
+
+    void runLatencyTest(const char * title, const WaitStrategy & strategy, uint32_t messageCount, uint64_t pacing)
+    {
+        static const size_t entryCount = 1000;
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(ActualMessage), entryCount + 10);
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("LocalIv", parameters);
+        connection->willProduce();
+
+        Consumer consumer(connection);
+        Message consumerMessage(connection);
+        uint64_t publishTime = 0;
+        std::thread producerThread(pacedProducer, connection, messageCount, pacing, std::ref(publishTime));
+
+        uint64_t totalLatency = 0;
+        uint64_t maxLatency = 0;
+        for(uint32_t messageNumber = 0; messageNumber < messageCount; ++messageNumber)
+        {
+            consumer.getNext(consumerMessage);
+            auto now = Stopwatch::now();
+            auto testMessage = consumerMessage.get<ActualMessage>();
+            if(messageNumber != testMessage->getSequence())
+            {
+                // the if avoids the performance hit of BOOST_CHECK_EQUAL unless it's needed.
+                BOOST_CHECK_EQUAL(messageNumber, testMessage->getSequence());
+            }
+            auto latency = now - consumerMessage.getTimestamp();
+            totalLatency += latency;
+            if(latency > maxLatency)
+            {
+                maxLatency = latency;
+            }
+        }
+        producerThread.join();
+
+        std::cout << std::setw(10) << title
+            << " one message every " << pacing << " nsec.: "
+            << "Latency: average " << totalLatency / messageCount << " nsec. max " << maxLatency << " nsec. "
+            << "Publish: average " << publishTime / messageCount << " nsec."
+            << std::endl;
+        consumer.writeStats(std::cerr);
+    }
+}
+
+#define ENABLE_WaitStrategyLatency 1
+#if ENABLE_WaitStrategyLatency && !defined(_WIN32)
+BOOST_AUTO_TEST_CASE(testWaitStrategyLatency)
+{
+    static const uint32_t messageCount = 2000;
+    static const uint64_t pacings[] = {10000, 100000, 1000000}; // nanoseconds between messages
+
+    std::cerr << "***** BEGIN WaitStrategyLatency test *****" << std::endl;
+    for(auto pacing : pacings)
+    {
+        // Park right away: this measures the wakeup path, not spinning.
+        runLatencyTest("Mutex", WaitStrategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), false), messageCount, pacing);
+        runLatencyTest("Futex", WaitStrategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), true), messageCount, pacing);
+        // Spin or park depending on how long recent waits lasted.
+        runLatencyTest("Adaptive", WaitStrategy::adaptive(std::chrono::microseconds(20), std::chrono::microseconds(200),
+            0, std::chrono::nanoseconds(10), std::chrono::seconds(5), true), messageCount, pacing);
+        // Wake the consumer every 16 messages or 50 microseconds: fewer wakeups, bounded latency.
+        runLatencyTest("Coalesced", WaitStrategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), false)
+            .coalesceWakeups(16, std::chrono::microseconds(50)), messageCount, pacing);
+        runLatencyTest("CoalFutex", WaitStrategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), true)
+            .coalesceWakeups(16, std::chrono::microseconds(50)), messageCount, pacing);
+    }
+    std::cerr << "***** END WaitStrategyLatency test *****" << std::endl;
+}
+#endif // ENABLE_WaitStrategyLatency
@@ -4,8 +4,16 @@
 #include <boost/test/unit_test.hpp>
 
 #include <HighQueue/Connection.hpp>
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
 #include <HighQueue/details/HQResolver.hpp>
 #include <HighQueue/details/HQReservePosition.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#endif // _WIN32
 
 using namespace HighQueue;
 
@@ -43,3 +51,329 @@ BOOST_AUTO_TEST_CASE(testIvMemoryPoolMessages)
 }
 #endif //  DISABLE_testIvMemoryPoolMessages
 
+
+#define DISABLE_testSharedMemoryConnectionx
+#ifdef DISABLE_testSharedMemoryConnection
+#pragma message ("DISABLE_testSharedMemoryConnection " __FILE__)
+#else // DISABLE_testSharedMemoryConnection
+BOOST_AUTO_TEST_CASE(testSharedMemoryConnection)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 10;
+    size_t messageSize = sizeof(uint64_t);
+    size_t messageCount = 50;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    const std::string name = "HQTestSharedConnection";
+    Connection::removeShared(name);
+
+    // A process that died holding the wait mutex would block the others, so shared HighQueues don't use one.
+    WaitStrategy mutexStrategy(0, 0, 0);
+    CreationParameters mutexParameters(mutexStrategy, mutexStrategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    ConnectionPtr refused = std::make_shared<Connection>();
+    BOOST_CHECK_THROW(refused->openOrCreateShared(name, mutexParameters), std::runtime_error);
+
+    // Two connections to the same shared memory are mapped at different addresses,
+    // just as they would be in two different processes.
+    ConnectionPtr creator = std::make_shared<Connection>();
+    creator->openOrCreateShared(name, parameters);
+    BOOST_CHECK(creator->isShared());
+    BOOST_CHECK_LE(messageSize, creator->getMessageCapacity());
+
+    ConnectionPtr attacher = std::make_shared<Connection>();
+    attacher->openExistingShared(name);
+    BOOST_CHECK(attacher->isShared());
+    BOOST_CHECK_NE(creator->getHeader(), attacher->getHeader());
+    BOOST_CHECK_EQUAL(creator->getHeader()->entryCount_, attacher->getHeader()->entryCount_);
+    {
+        Producer producer(attacher);
+        Message producerMessage(attacher);
+        Consumer consumer(creator);
+        Message consumerMessage(creator);
+
+        for(uint64_t nLoop = 0; nLoop < entryCount * 3; ++nLoop)
+        {
+            producerMessage.emplace<uint64_t>(nLoop);
+            producer.publish(producerMessage);
+            BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+            BOOST_CHECK_EQUAL(nLoop, *consumerMessage.get<uint64_t>());
+            // The block must be usable by the consuming "process"
+            auto creatorHeader = creator->getHeader();
+            BOOST_CHECK(consumerMessage.getContainer() == reinterpret_cast<byte_t *>(creatorHeader) + creatorHeader->memoryPool_);
+        }
+        BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+    }
+
+    BOOST_CHECK(Connection::removeShared(name));
+    ConnectionPtr late = std::make_shared<Connection>();
+    BOOST_CHECK_THROW(late->openExistingShared(name), std::runtime_error);
+}
+#endif // DISABLE_testSharedMemoryConnection
+
+#define DISABLE_testFutexWaitsx
+#ifdef DISABLE_testFutexWaits
+#pragma message ("DISABLE_testFutexWaits " __FILE__)
+#else // DISABLE_testFutexWaits
+BOOST_AUTO_TEST_CASE(testFutexWaits)
+{
+    // Go straight to the futex so both sides really park.
+    bool useFutex = true;
+    WaitStrategy strategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), useFutex);
+    BOOST_CHECK(strategy.futexUsed_);
+    BOOST_CHECK(!strategy.mutexUsed_);
+    size_t entryCount = 4;
+    size_t messageSize = sizeof(uint64_t);
+    size_t messageCount = 50;
+    uint64_t messageTotal = 1000;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    const std::string name = "HQTestFutexWaits";
+    Connection::removeShared(name);
+
+    // The futex words are at different addresses in the two mappings.
+    ConnectionPtr creator = std::make_shared<Connection>();
+    creator->openOrCreateShared(name, parameters);
+    ConnectionPtr attacher = std::make_shared<Connection>();
+    attacher->openExistingShared(name);
+    {
+        Consumer consumer(creator);
+        Message consumerMessage(creator);
+
+        std::thread producerThread([&attacher, messageTotal]()
+        {
+            Producer producer(attacher);
+            Message producerMessage(attacher);
+            for(uint64_t nMessage = 0; nMessage < messageTotal; ++nMessage)
+            {
+                if(nMessage % 100 == 0)
+                {
+                    // let the consumer park
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                producerMessage.emplace<uint64_t>(nMessage);
+                producer.publish(producerMessage);
+            }
+        });
+
+        for(uint64_t nMessage = 0; nMessage < messageTotal; ++nMessage)
+        {
+            if(nMessage % 100 == 50)
+            {
+                // let the producer park
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            BOOST_REQUIRE(consumer.getNext(consumerMessage));
+            BOOST_REQUIRE_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+        }
+        producerThread.join();
+        BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+        // stop() wakes a parked consumer.
+        std::thread stopper([&consumer]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            consumer.stop();
+        });
+        BOOST_CHECK(!consumer.getNext(consumerMessage));
+        stopper.join();
+    }
+    attacher.reset();
+    creator.reset();
+    Connection::removeShared(name);
+}
+#endif // DISABLE_testFutexWaits
+
+#define DISABLE_testResizex
+#ifdef DISABLE_testResize
+#pragma message ("DISABLE_testResize " __FILE__)
+#else // DISABLE_testResize
+BOOST_AUTO_TEST_CASE(testResize)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    static const size_t maxEntryCount = 32;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    parameters.maxEntryCount_ = maxEntryCount;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Resize", parameters);
+    BOOST_CHECK_EQUAL(entryCount, connection->getEntryCount());
+    BOOST_CHECK_THROW(connection->resize(maxEntryCount + 1), std::runtime_error);
+    BOOST_CHECK_THROW(connection->resize(0), std::runtime_error);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    uint64_t published = 0;
+    uint64_t consumed = 0;
+
+    // Grow a full queue.  The producer switches to the new ring when it next runs out of room.
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(published++);
+        producer.publish(producerMessage);
+    }
+    BOOST_CHECK(connection->resize(maxEntryCount));
+    BOOST_CHECK(!connection->resize(entryCount));
+    BOOST_CHECK_EQUAL(entryCount, connection->getEntryCount());
+    for(size_t nMessage = entryCount; nMessage < maxEntryCount - 4; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(published++);
+        producer.publish(producerMessage);
+    }
+    BOOST_CHECK_EQUAL(maxEntryCount, connection->getEntryCount());
+    BOOST_CHECK_EQUAL(published, connection->getBacklog());
+
+    // The old ring is still in use until the consumer gets past it.
+    BOOST_CHECK(!connection->resize(entryCount / 2));
+    while(consumer.tryGetNext(consumerMessage))
+    {
+        BOOST_CHECK_EQUAL(consumed++, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK_EQUAL(published, consumed);
+
+    // Shrink it.  Entries published before the switch stay in the larger ring.
+    BOOST_REQUIRE(connection->resize(entryCount / 2));
+    for(int pass = 0; pass < 4; ++pass)
+    {
+        for(size_t nMessage = 0; nMessage < entryCount / 2; ++nMessage)
+        {
+            producerMessage.emplace<uint64_t>(published++);
+            producer.publish(producerMessage);
+        }
+        while(consumer.tryGetNext(consumerMessage))
+        {
+            BOOST_CHECK_EQUAL(consumed++, *consumerMessage.get<uint64_t>());
+        }
+    }
+    BOOST_CHECK_EQUAL(entryCount / 2, connection->getEntryCount());
+    BOOST_CHECK_EQUAL(published, consumed);
+
+    // Resize repeatedly while a producer thread is publishing.
+    static const uint64_t threadMessageCount = 20000;
+    std::thread producerThread([&producer, &connection, published]()
+    {
+        Message message(connection);
+        for(uint64_t value = published; value < published + threadMessageCount; ++value)
+        {
+            message.emplace<uint64_t>(value);
+            producer.publish(message);
+        }
+    });
+    static const size_t sizes[] = {maxEntryCount, entryCount, 3, maxEntryCount / 2};
+    size_t resizes = 0;
+    while(consumed < published + threadMessageCount)
+    {
+        consumer.getNext(consumerMessage);
+        auto value = *consumerMessage.get<uint64_t>();
+        if(value != consumed)
+        {
+            // the if avoids the performance hit of BOOST_CHECK unless it's needed.
+            BOOST_CHECK_EQUAL(consumed, value);
+        }
+        ++consumed;
+        if(consumed % 100 == 0 && connection->resize(sizes[resizes % 4]))
+        {
+            ++resizes;
+        }
+    }
+    producerThread.join();
+    BOOST_CHECK_LT(0u, resizes);
+
+    // A client that masks Positions limits later resizes to powers of two.
+    typedef BasicConsumer<PollingWait, PowerOfTwoEntryCount> MaskingConsumer;
+    ConnectionPtr masked = std::make_shared<Connection>();
+    masked->createLocal("Masked", parameters);
+    MaskingConsumer maskingConsumer(masked);
+    BOOST_CHECK_THROW(masked->resize(3), std::runtime_error);
+    BOOST_CHECK(masked->resize(maxEntryCount / 2));
+
+    // Such a client can't attach while a resize to another count is waiting for the producers.
+    ConnectionPtr pending = std::make_shared<Connection>();
+    pending->createLocal("Pending", parameters);
+    BOOST_REQUIRE(pending->resize(3));
+    BOOST_CHECK_THROW(MaskingConsumer late(pending), std::runtime_error);
+
+    // Only queues created with a maxEntryCount_ can be resized.
+    parameters.maxEntryCount_ = 0;
+    ConnectionPtr fixed = std::make_shared<Connection>();
+    fixed->createLocal("Fixed", parameters);
+    BOOST_CHECK_THROW(fixed->resize(entryCount * 2), std::runtime_error);
+}
+#endif // DISABLE_testResize
+
+#define DISABLE_testStatisticsx
+#ifdef DISABLE_testStatistics
+#pragma message ("DISABLE_testStatistics " __FILE__)
+#else // DISABLE_testStatistics
+BOOST_AUTO_TEST_CASE(testStatistics)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    parameters.publishStatistics_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Statistics", parameters);
+
+    // A local HighQueue with published statistics can be found by name.
+    std::stringstream shmName;
+    shmName << "/HighQueue." << getpid() << ".Statistics";
+    int fd = shm_open(shmName.str().c_str(), O_RDONLY, 0);
+    BOOST_REQUIRE(fd >= 0);
+    ::close(fd);
+
+    const HighQStatistics & statistics = connection->getStatistics();
+    {
+        Producer producer(connection);
+        Consumer consumer(connection);
+        BOOST_CHECK_EQUAL(uint32_t(HighQStatSlot::ProducerOwner), statistics.slots_[0].owner_.load());
+        BOOST_CHECK_EQUAL(uint32_t(HighQStatSlot::ConsumerOwner), statistics.slots_[1].owner_.load());
+        Message producerMessage(connection);
+        Message consumerMessage(connection);
+        for(uint64_t value = 0; value < entryCount; ++value)
+        {
+            producerMessage.emplace<uint64_t>(value);
+            producer.publish(producerMessage);
+        }
+        BOOST_CHECK(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(entryCount, statistics.slots_[0].publishes_);
+        BOOST_CHECK_EQUAL(2u, statistics.slots_[1].consumed_);
+        BOOST_CHECK_EQUAL(0u, statistics.highWater_.depth_);
+
+        // The producer finds the queue nearly full when it runs out of space it knows is free.
+        producerMessage.emplace<uint64_t>(entryCount);
+        producer.publish(producerMessage);
+        BOOST_CHECK_EQUAL(entryCount - 2, statistics.highWater_.depth_);
+    }
+    // The slots are free for the next clients, who start counting from zero.
+    BOOST_CHECK_EQUAL(uint32_t(HighQStatSlot::Free), statistics.slots_[0].owner_.load());
+    BOOST_CHECK_EQUAL(uint32_t(HighQStatSlot::Free), statistics.slots_[1].owner_.load());
+    auto generation = statistics.slots_[0].generation_.load();
+    {
+        Producer producer(connection);
+        BOOST_CHECK_EQUAL(generation + 1, statistics.slots_[0].generation_);
+        BOOST_CHECK_EQUAL(0u, statistics.slots_[0].publishes_);
+
+        // When all the slots are taken, clients keep their counters privately.
+        std::vector<std::unique_ptr<Producer> > producers;
+        for(size_t nProducer = 0; nProducer < HighQStatistics::SlotCount; ++nProducer)
+        {
+            producers.emplace_back(new Producer(connection));
+        }
+        Message producerMessage(connection);
+        producerMessage.emplace<uint64_t>(0);
+        producers.back()->publish(producerMessage);
+        for(auto & slot : statistics.slots_)
+        {
+            BOOST_CHECK_EQUAL(uint32_t(HighQStatSlot::ProducerOwner), slot.owner_.load());
+        }
+    }
+
+    // The name goes away with the HighQueue.
+    connection.reset();
+    BOOST_CHECK(shm_open(shmName.str().c_str(), O_RDONLY, 0) < 0);
+}
+#endif // DISABLE_testStatistics
@@ -4,6 +4,8 @@
 
 #include <HighQueue/Producer.hpp>
 #include <HighQueue/Consumer.hpp>
+#include <HighQueue/MessageArray.hpp>
+#include <HighQueue/MultiQueueConsumer.hpp>
 
 using namespace HighQueue;
 
@@ -81,3 +83,1232 @@ BOOST_AUTO_TEST_CASE(testConsumerWithoutWaits)
     BOOST_CHECK(! consumer.tryGetNext(message));
 }
 #endif //  DISABLE_testConsumerWithoutWaits
+
+#define DISABLE_testConsumerBatchx
+#ifdef DISABLE_testConsumerBatch
+#pragma message ("DISABLE_testConsumerBatch " __FILE__)
+#else // DISABLE DISABLE_testConsumerBatch
+BOOST_AUTO_TEST_CASE(testConsumerBatch)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 10;
+    size_t messageSize = sizeof(MockMessage);
+    size_t messageCount = 50;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+
+    auto header = connection->getHeader();
+    HighQResolver resolver(header);
+    auto readPosition = resolver.resolve<Position>(header->readPosition_);
+    auto publishPosition = resolver.resolve<Position>(header->publishPosition_);
+
+    Producer producer(connection);
+    Message message(connection);
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        std::stringstream msg;
+        msg << nMessage << std::ends;
+        message.emplace<MockMessage>(msg.str());
+        producer.publish(message);
+    }
+
+    Consumer consumer(connection);
+    size_t limit = 4;
+    MessageArray messages(connection, limit);
+    size_t nMessage = 0;
+    while(nMessage < entryCount)
+    {
+        auto count = consumer.tryGetNextBatch(messages.get(), limit);
+        BOOST_REQUIRE(count > 0);
+        BOOST_CHECK(count <= limit);
+        for(size_t nBatch = 0; nBatch < count; ++nBatch)
+        {
+            std::stringstream msg;
+            msg << nMessage << std::ends;
+            BOOST_CHECK_EQUAL(msg.str(), messages[nBatch].get<MockMessage>()->getString());
+            ++nMessage;
+        }
+        // the read position moves once per batch, past every entry consumed.
+        BOOST_CHECK_EQUAL(*readPosition + entryCount - nMessage, *publishPosition);
+    }
+    BOOST_CHECK_EQUAL(nMessage, entryCount);
+    BOOST_CHECK_EQUAL(0u, consumer.tryGetNextBatch(messages.get(), limit));
+
+    // the queue has room again.
+    message.emplace<MockMessage>("After");
+    producer.publish(message);
+    BOOST_CHECK_EQUAL(1u, consumer.getNextBatch(messages.get(), limit));
+    BOOST_CHECK_EQUAL(std::string("After"), messages[0].get<MockMessage>()->getString());
+}
+#endif //  DISABLE_testConsumerBatch
+
+#define DISABLE_testLockFreeProducersx
+#ifdef DISABLE_testLockFreeProducers
+#pragma message ("DISABLE_testLockFreeProducers " __FILE__)
+#else // DISABLE DISABLE_testLockFreeProducers
+BOOST_AUTO_TEST_CASE(testLockFreeProducers)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 16;
+    size_t producerCount = 4;
+    size_t messagesPerProducer = 10000;
+    size_t messageSize = sizeof(MockMessage);
+    size_t messageCount = entryCount + producerCount + 2;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    parameters.lockFreeProducers_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+
+    Consumer consumer(connection);
+    Message consumerMessage(connection);
+
+    std::vector<std::thread> producers;
+    for(size_t nProducer = 0; nProducer < producerCount; ++nProducer)
+    {
+        producers.emplace_back([&connection, nProducer, messagesPerProducer]()
+        {
+            Producer producer(connection);
+            Message message(connection);
+            for(size_t nMessage = 0; nMessage < messagesPerProducer; ++nMessage)
+            {
+                std::stringstream msg;
+                msg << nProducer << ' ' << nMessage;
+                message.emplace<MockMessage>(msg.str());
+                producer.publish(message);
+            }
+        });
+    }
+
+    // Each producer's messages must arrive complete and in order.
+    std::vector<size_t> nextMessage(producerCount, 0);
+    for(size_t nMessage = 0; nMessage < producerCount * messagesPerProducer; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.getNext(consumerMessage));
+        std::stringstream msg(consumerMessage.get<MockMessage>()->getString());
+        size_t producerNumber = producerCount;
+        size_t messageNumber = 0;
+        msg >> producerNumber >> messageNumber;
+        BOOST_REQUIRE(producerNumber < producerCount);
+        BOOST_REQUIRE_EQUAL(nextMessage[producerNumber], messageNumber);
+        ++nextMessage[producerNumber];
+    }
+    for(auto & producer : producers)
+    {
+        producer.join();
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+}
+#endif //  DISABLE_testLockFreeProducers
+
+#define DISABLE_testLockFreeAbandonx
+#ifdef DISABLE_testLockFreeAbandon
+#pragma message ("DISABLE_testLockFreeAbandon " __FILE__)
+#else // DISABLE_testLockFreeAbandon
+BOOST_AUTO_TEST_CASE(testLockFreeAbandon)
+{
+    WaitStrategy strategy(0, WaitStrategy::FOREVER);
+    size_t entryCount = 4;
+    size_t batchSize = 3;
+    CreationParameters parameters(strategy, strategy, false, entryCount, sizeof(uint64_t), entryCount + batchSize + 4);
+    parameters.lockFreeProducers_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LockFreeAbandon", parameters);
+    Consumer consumer(connection);
+    Message consumerMessage(connection);
+
+    // Fill the queue.
+    Producer filler(connection);
+    Message fillerMessage(connection);
+    for(uint64_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        fillerMessage.emplace<uint64_t>(nMessage);
+        filler.publish(fillerMessage);
+    }
+
+    // One producer reserves a batch and waits for room.  Another reserves the Position after the batch.
+    Producer stopped(connection);
+    std::thread batch([&connection, &stopped, batchSize]()
+    {
+        MessageArray messages(connection, batchSize);
+        for(size_t nMessage = 0; nMessage < batchSize; ++nMessage)
+        {
+            messages[nMessage].emplace<uint64_t>(100 + nMessage);
+        }
+        stopped.publish(messages.get(), batchSize);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::thread later([&connection]()
+    {
+        Producer producer(connection);
+        Message message(connection);
+        message.emplace<uint64_t>(200);
+        producer.publish(message);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // The stopped producer gives up its whole batch, so the later message is not stuck behind it.
+    stopped.stop();
+    // Let it notice before the consumer makes room.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for(uint64_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.getNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+    }
+    batch.join();
+    later.join();
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(200u, *consumerMessage.get<uint64_t>());
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // With no consumer attached the stopped producer leaves its Position for the consumer that attaches later.
+    ConnectionPtr unread = std::make_shared<Connection>();
+    unread->createLocal("LockFreeAbandonUnread", parameters);
+    Producer unreadFiller(unread);
+    Message unreadMessage(unread);
+    for(uint64_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        unreadMessage.emplace<uint64_t>(nMessage);
+        unreadFiller.publish(unreadMessage);
+    }
+    Producer unreadStopped(unread);
+    std::thread blocked([&unread, &unreadStopped]()
+    {
+        Message message(unread);
+        message.emplace<uint64_t>(100);
+        unreadStopped.publish(message);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    unreadStopped.stop();
+    blocked.join();
+
+    Consumer lateConsumer(unread);
+    Message lateMessage(unread);
+    for(uint64_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        BOOST_REQUIRE(lateConsumer.tryGetNext(lateMessage));
+        BOOST_CHECK_EQUAL(nMessage, *lateMessage.get<uint64_t>());
+    }
+    unreadMessage.emplace<uint64_t>(300);
+    unreadFiller.publish(unreadMessage);
+    BOOST_REQUIRE(lateConsumer.tryGetNext(lateMessage));
+    BOOST_CHECK_EQUAL(300u, *lateMessage.get<uint64_t>());
+    BOOST_CHECK(!lateConsumer.tryGetNext(lateMessage));
+}
+#endif // DISABLE_testLockFreeAbandon
+
+#define DISABLE_testCompetingConsumersx
+#ifdef DISABLE_testCompetingConsumers
+#pragma message ("DISABLE_testCompetingConsumers " __FILE__)
+#else // DISABLE DISABLE_testCompetingConsumers
+BOOST_AUTO_TEST_CASE(testCompetingConsumers)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 16;
+    size_t consumerCount = 4;
+    size_t messageTotal = 40000;
+    size_t batchSize = 3;
+    size_t messageSize = sizeof(MockMessage);
+    size_t messageCount = entryCount + consumerCount * batchSize + 2;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+    {
+        // Without the option a second consumer is an error.
+        Consumer consumer(connection);
+        BOOST_CHECK_THROW(Consumer second(connection), std::runtime_error);
+    }
+
+    parameters.competingConsumers_ = true;
+    connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+
+    // Each message must be delivered exactly once.  Odd consumers take batches.
+    std::vector<std::atomic<uint32_t>> deliveries(messageTotal);
+    for(auto & delivery : deliveries)
+    {
+        delivery = 0;
+    }
+    std::atomic<size_t> consumed(0);
+    std::vector<std::thread> consumers;
+    for(size_t nConsumer = 0; nConsumer < consumerCount; ++nConsumer)
+    {
+        consumers.emplace_back([&connection, &deliveries, &consumed, nConsumer, messageTotal, batchSize]()
+        {
+            Consumer consumer(connection);
+            MessageArray messages(connection, batchSize);
+            while(consumed < messageTotal)
+            {
+                size_t count = 0;
+                if(nConsumer % 2 == 0)
+                {
+                    count = consumer.tryGetNext(messages[0]) ? 1 : 0;
+                }
+                else
+                {
+                    count = consumer.tryGetNextBatch(messages.get(), batchSize);
+                }
+                for(size_t nMessage = 0; nMessage < count; ++nMessage)
+                {
+                    std::stringstream msg(messages[nMessage].get<MockMessage>()->getString());
+                    size_t messageNumber = messageTotal;
+                    msg >> messageNumber;
+                    if(messageNumber < messageTotal)
+                    {
+                        ++deliveries[messageNumber];
+                    }
+                }
+                consumed += count;
+                if(count == 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    Producer producer(connection);
+    Message message(connection);
+    for(size_t nMessage = 0; nMessage < messageTotal; ++nMessage)
+    {
+        std::stringstream msg;
+        msg << nMessage;
+        message.emplace<MockMessage>(msg.str());
+        producer.publish(message);
+    }
+    for(auto & consumer : consumers)
+    {
+        consumer.join();
+    }
+    BOOST_CHECK_EQUAL(messageTotal, consumed);
+    for(size_t nMessage = 0; nMessage < messageTotal; ++nMessage)
+    {
+        BOOST_REQUIRE_EQUAL(1u, deliveries[nMessage]);
+    }
+    auto header = connection->getHeader();
+    BOOST_CHECK_EQUAL(0u, header->consumersPresent_);
+    BOOST_CHECK(!header->consumerPresent_);
+}
+#endif //  DISABLE_testCompetingConsumers
+
+#define DISABLE_testBroadcastx
+#ifdef DISABLE_testBroadcast
+#pragma message ("DISABLE_testBroadcast " __FILE__)
+#else // DISABLE DISABLE_testBroadcast
+BOOST_AUTO_TEST_CASE(testBroadcast)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 8;
+    size_t subscriberCount = 3;
+    size_t messageTotal = 20000;
+    size_t batchSize = 3;
+    size_t messageSize = sizeof(MockMessage);
+    size_t messageCount = entryCount * 2 + subscriberCount * batchSize + 2;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    parameters.subscriberCount_ = subscriberCount;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+
+    // Every subscriber sees every message in order.
+    // One peeks in place, one gets a message at a time, one gets batches.
+    std::vector<size_t> received(subscriberCount, 0);
+    std::vector<std::unique_ptr<Consumer>> subscribers;
+    for(size_t nSubscriber = 0; nSubscriber < subscriberCount; ++nSubscriber)
+    {
+        subscribers.emplace_back(new Consumer(connection));
+    }
+    BOOST_CHECK_THROW(Consumer extra(connection), std::runtime_error);
+
+    std::vector<std::thread> threads;
+    for(size_t nSubscriber = 0; nSubscriber < subscriberCount; ++nSubscriber)
+    {
+        threads.emplace_back([&connection, &subscribers, &received, nSubscriber, messageTotal, batchSize]()
+        {
+            Consumer & consumer = *subscribers[nSubscriber];
+            MessageArray messages(connection, batchSize);
+            size_t & nextMessage = received[nSubscriber];
+            while(nextMessage < messageTotal)
+            {
+                std::vector<std::string> contents;
+                if(nSubscriber == 0)
+                {
+                    auto peeked = consumer.peekNext();
+                    contents.push_back(peeked->getConst<MockMessage>()->getString());
+                    consumer.releasePeeked();
+                }
+                else if(nSubscriber == 1)
+                {
+                    consumer.getNext(messages[0]);
+                    contents.push_back(messages[0].get<MockMessage>()->getString());
+                }
+                else
+                {
+                    auto count = consumer.getNextBatch(messages.get(), batchSize);
+                    for(size_t nMessage = 0; nMessage < count; ++nMessage)
+                    {
+                        contents.push_back(messages[nMessage].get<MockMessage>()->getString());
+                    }
+                }
+                for(const auto & content : contents)
+                {
+                    std::stringstream msg;
+                    msg << nextMessage;
+                    if(msg.str() != content)
+                    {
+                        return;
+                    }
+                    ++nextMessage;
+                }
+            }
+        });
+    }
+
+    Producer producer(connection);
+    Message message(connection);
+    for(size_t nMessage = 0; nMessage < messageTotal; ++nMessage)
+    {
+        std::stringstream msg;
+        msg << nMessage;
+        message.emplace<MockMessage>(msg.str());
+        producer.publish(message);
+    }
+    for(auto & thread : threads)
+    {
+        thread.join();
+    }
+    for(size_t nSubscriber = 0; nSubscriber < subscriberCount; ++nSubscriber)
+    {
+        BOOST_CHECK_EQUAL(messageTotal, received[nSubscriber]);
+    }
+
+    // A detached subscriber no longer holds up the producer.
+    subscribers[0].reset();
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        message.emplace<MockMessage>("More");
+        producer.publish(message);
+    }
+    MessageArray messages(connection, entryCount);
+    for(size_t nSubscriber = 1; nSubscriber < subscriberCount; ++nSubscriber)
+    {
+        BOOST_CHECK_EQUAL(entryCount, subscribers[nSubscriber]->tryGetNextBatch(messages.get(), entryCount));
+    }
+    message.emplace<MockMessage>("Last");
+    producer.publish(message);
+    BOOST_CHECK(subscribers[1]->tryGetNext(message));
+    BOOST_CHECK_EQUAL(std::string("Last"), message.get<MockMessage>()->getString());
+}
+#endif //  DISABLE_testBroadcast
+
+#define DISABLE_testAdaptiveWaitBudgetx
+#ifdef DISABLE_testAdaptiveWaitBudget
+#pragma message ("DISABLE_testAdaptiveWaitBudget " __FILE__)
+#else // DISABLE DISABLE_testAdaptiveWaitBudget
+BOOST_AUTO_TEST_CASE(testAdaptiveWaitBudget)
+{
+    auto maxSpin = std::chrono::microseconds(20);
+    auto maxYield = std::chrono::microseconds(200);
+    WaitStrategy strategy = WaitStrategy::adaptive(maxSpin, maxYield);
+    BOOST_CHECK(strategy.adaptive_);
+    BOOST_CHECK(strategy.mutexUsed_);
+
+    HighQWaitBudget budget(strategy);
+
+    // Data that is already there costs nothing and teaches nothing.
+    auto estimate = budget.estimate();
+    budget.start();
+    budget.finish();
+    BOOST_CHECK_EQUAL(estimate, budget.estimate());
+
+    // Short waits: spin for a while, but no longer than the maximum.
+    budget.start();
+    BOOST_CHECK(budget.spin());
+    budget.finish();
+    BOOST_CHECK_LT(budget.estimate(), estimate);
+    BOOST_CHECK_GT(budget.spinPeriod(), 0u);
+    BOOST_CHECK_LE(budget.spinPeriod(), uint64_t(std::chrono::nanoseconds(maxSpin).count()));
+
+    // Long waits mean the feed is idle.  Stop burning the CPU.
+    for(size_t nWait = 0; nWait < 3; ++nWait)
+    {
+        budget.start();
+        budget.spin();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        budget.finish();
+    }
+    budget.start();
+    BOOST_CHECK(!budget.spin());
+    BOOST_CHECK(!budget.yield());
+    BOOST_CHECK(!budget.sleep());
+    BOOST_CHECK_EQUAL(budget.spinPeriod(), 0u);
+    budget.finish();
+
+    // One short wait and the next wait spins again.
+    budget.start();
+    budget.spin();
+    budget.finish();
+    budget.start();
+    BOOST_CHECK(budget.spin());
+    BOOST_CHECK_GT(budget.spinPeriod(), 0u);
+    budget.finish();
+
+    // An adaptive consumer still gets every message.
+    static const size_t entryCount = 10;
+    static const size_t messageCount = 1000;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(MockMessage), entryCount + 10);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("AdaptiveWait", parameters);
+    connection->willProduce();
+    Consumer consumer(connection);
+    Message consumerMessage(connection);
+    std::thread producerThread([connection]() mutable
+    {
+        Producer producer(connection);
+        Message producerMessage(connection);
+        for(size_t nMessage = 0; nMessage < messageCount; ++nMessage)
+        {
+            producerMessage.emplace<size_t>(nMessage);
+            producer.publish(producerMessage);
+            if(nMessage % 100 == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+    for(size_t nMessage = 0; nMessage < messageCount; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.getNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<size_t>());
+    }
+    producerThread.join();
+    std::stringstream stats;
+    consumer.writeStats(stats);
+    BOOST_CHECK_NE(stats.str().find("Adaptive:"), std::string::npos);
+}
+#endif //  DISABLE_testAdaptiveWaitBudget
+
+#define DISABLE_testInlinePayloadsx
+#ifdef DISABLE_testInlinePayloads
+#pragma message ("DISABLE_testInlinePayloads " __FILE__)
+#else // DISABLE DISABLE_testInlinePayloads
+BOOST_AUTO_TEST_CASE(testInlinePayloads)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 10;
+    static const size_t messageSize = 100;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, entryCount + 10);
+    parameters.inlinePayloads_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("InlinePayloads", parameters);
+    connection->willProduce();
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+
+    // Sizes on both sides of the threshold.  Small ones stay in the producer's block.
+    const size_t sizes[] = {1, 16, HighQEntry::InlineCapacity, HighQEntry::InlineCapacity + 1, messageSize, 8};
+    for(size_t size : sizes)
+    {
+        auto block = producerMessage.get();
+        for(size_t nByte = 0; nByte < size; ++nByte)
+        {
+            byte_t value = byte_t(nByte);
+            producerMessage.appendBinaryCopy(&value, 1);
+        }
+        producerMessage.setType(Message::MessageType::MockMessage);
+        producerMessage.setSequence(Message::Sequence(size));
+        producer.publish(producerMessage);
+        BOOST_CHECK(producerMessage.isEmpty());
+        BOOST_CHECK_EQUAL(size <= HighQEntry::InlineCapacity, producerMessage.get() == block);
+
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(size, consumerMessage.getUsed());
+        BOOST_CHECK_EQUAL(Message::Sequence(size), consumerMessage.getSequence());
+        BOOST_CHECK(Message::MessageType::MockMessage == consumerMessage.getType());
+        auto data = consumerMessage.get();
+        for(size_t nByte = 0; nByte < size; ++nByte)
+        {
+            BOOST_CHECK_EQUAL(byte_t(nByte), data[nByte]);
+        }
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+}
+#endif //  DISABLE_testInlinePayloads
+
+#define DISABLE_testPeekSingleConsumerx
+#ifdef DISABLE_testPeekSingleConsumer
+#pragma message ("DISABLE_testPeekSingleConsumer " __FILE__)
+#else // DISABLE DISABLE_testPeekSingleConsumer
+BOOST_AUTO_TEST_CASE(testPeekSingleConsumer)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 4;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("PeekSingle", parameters);
+    connection->willProduce();
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+
+    uint64_t published = 0;
+    uint64_t expected = 0;
+    for(size_t nPass = 0; nPass < 3; ++nPass)
+    {
+        // Fill the queue.
+        for(size_t nEntry = 0; nEntry < entryCount; ++nEntry)
+        {
+            producerMessage.emplace<uint64_t>(published++);
+            producer.publish(producerMessage);
+        }
+        // Peek at everything.  The entries are not released yet so they all stay valid.
+        std::vector<const Message *> peeked;
+        const Message * message;
+        while((message = consumer.tryPeekNext()) != 0)
+        {
+            peeked.push_back(message);
+        }
+        BOOST_REQUIRE_EQUAL(entryCount, peeked.size());
+        for(auto message : peeked)
+        {
+            BOOST_CHECK_EQUAL(expected++, *message->getConst<uint64_t>());
+        }
+        consumer.releasePeeked();
+
+        // Peeking and getting can take turns once everything peeked has been released.
+        producerMessage.emplace<uint64_t>(published++);
+        producer.publish(producerMessage);
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(expected++, *consumerMessage.get<uint64_t>());
+        BOOST_CHECK(consumer.tryPeekNext() == 0);
+    }
+
+    // Peeking needs entries that hold the message itself.
+    parameters.inlinePayloads_ = true;
+    ConnectionPtr inlineConnection = std::make_shared<Connection>();
+    inlineConnection->createLocal("PeekInline", parameters);
+    Consumer inlineConsumer(inlineConnection);
+    BOOST_CHECK_THROW(inlineConsumer.tryPeekNext(), std::runtime_error);
+
+    parameters.inlinePayloads_ = false;
+    parameters.competingConsumers_ = true;
+    ConnectionPtr competingConnection = std::make_shared<Connection>();
+    competingConnection->createLocal("PeekCompeting", parameters);
+    Consumer competingConsumer(competingConnection);
+    BOOST_CHECK_THROW(competingConsumer.tryPeekNext(), std::runtime_error);
+}
+#endif //  DISABLE_testPeekSingleConsumer
+
+#define DISABLE_testOverwriteWhenFullx
+#ifdef DISABLE_testOverwriteWhenFull
+#pragma message ("DISABLE_testOverwriteWhenFull " __FILE__)
+#else // DISABLE_testOverwriteWhenFull
+BOOST_AUTO_TEST_CASE(testOverwriteWhenFull)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    static const size_t wordCount = 8;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t) * wordCount, entryCount * 3 + 4);
+    parameters.overwriteWhenFull_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Overwrite", parameters);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    BOOST_CHECK_THROW(consumer.tryPeekNext(), std::runtime_error);
+
+    // The producer never waits for the consumer.
+    static const uint64_t published = entryCount * 2 + 4;
+    size_t producerOffset = producerMessage.getOffset();
+    for(uint64_t nMessage = 0; nMessage < published; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(nMessage);
+        producer.publish(producerMessage);
+    }
+    // The data was copied into the entries' own blocks, so the producer kept its block.
+    BOOST_CHECK_EQUAL(producerOffset, producerMessage.getOffset());
+    BOOST_CHECK(producerMessage.isEmpty());
+    // Only the newest entryCount messages survive.
+    for(uint64_t nMessage = published - entryCount; nMessage < published; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(published - entryCount, consumer.getOverruns());
+    Position start = 0;
+    Position end = 0;
+    consumer.getLatestOverrun(start, end);
+    BOOST_CHECK_EQUAL(published - entryCount, end - start);
+
+    // A batch starts after the lost messages.
+    for(uint64_t nMessage = 0; nMessage < entryCount + 3; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(nMessage);
+        producer.publish(producerMessage);
+    }
+    MessageArray messages(connection, entryCount * 2);
+    BOOST_REQUIRE_EQUAL(entryCount, consumer.getNextBatch(messages.get(), messages.size()));
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        BOOST_CHECK_EQUAL(nMessage + 3, *messages[nMessage].get<uint64_t>());
+    }
+    BOOST_CHECK_EQUAL(published - entryCount + 3, consumer.getOverruns());
+
+    // With the producer running flat out every message the consumer gets is intact and in order.
+    static const uint64_t racingCount = 100000;
+    std::thread producerThread([&connection]()
+    {
+        Producer racer(connection);
+        Message message(connection);
+        for(uint64_t nMessage = 0; nMessage < racingCount; ++nMessage)
+        {
+            for(size_t nWord = 0; nWord < wordCount; ++nWord)
+            {
+                message.emplaceBack<uint64_t>(nMessage);
+            }
+            racer.publish(message);
+        }
+    });
+    auto overruns = consumer.getOverruns();
+    uint64_t received = 0;
+    uint64_t expected = 0;
+    while(expected < racingCount)
+    {
+        if(consumer.tryGetNext(consumerMessage))
+        {
+            BOOST_REQUIRE_EQUAL(sizeof(uint64_t) * wordCount, consumerMessage.getUsed());
+            auto words = consumerMessage.get<uint64_t>();
+            BOOST_REQUIRE(words[0] >= expected);
+            for(size_t nWord = 1; nWord < wordCount; ++nWord)
+            {
+                BOOST_REQUIRE_EQUAL(words[0], words[nWord]);
+            }
+            expected = words[0] + 1;
+            ++received;
+        }
+    }
+    producerThread.join();
+    BOOST_CHECK_EQUAL(racingCount, received + consumer.getOverruns() - overruns);
+}
+#endif //  DISABLE_testOverwriteWhenFull
+
+#define DISABLE_testOverwriteLockFreex
+#ifdef DISABLE_testOverwriteLockFree
+#pragma message ("DISABLE_testOverwriteLockFree " __FILE__)
+#else // DISABLE_testOverwriteLockFree
+BOOST_AUTO_TEST_CASE(testOverwriteLockFree)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount * 3 + 4);
+    parameters.overwriteWhenFull_ = true;
+    // Overwriting producers use the spin lock, so the consumer must not wait for lock-free stamps.
+    parameters.lockFreeProducers_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("OverwriteLockFree", parameters);
+    BOOST_CHECK(!connection->getHeader()->lockFreeProducers_);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    uint64_t published = 0;
+    for(int lap = 0; lap < 2; ++lap)
+    {
+        // Lap the ring so the oldest surviving entries carry newer stamps.
+        uint64_t first = published;
+        for(size_t nMessage = 0; nMessage < entryCount * 2 + 4; ++nMessage)
+        {
+            producerMessage.emplace<uint64_t>(published++);
+            producer.publish(producerMessage);
+        }
+        for(uint64_t expected = published - entryCount; expected < published; ++expected)
+        {
+            BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+            BOOST_CHECK_EQUAL(expected, *consumerMessage.get<uint64_t>());
+        }
+        BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL((published - first - entryCount) * (lap + 1), consumer.getOverruns());
+    }
+    producerMessage.emplace<uint64_t>(published);
+    producer.publish(producerMessage);
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(published, *consumerMessage.get<uint64_t>());
+}
+#endif //  DISABLE_testOverwriteLockFree
+
+#define DISABLE_testConflateByKeyx
+#ifdef DISABLE_testConflateByKey
+#pragma message ("DISABLE_testConflateByKey " __FILE__)
+#else // DISABLE_testConflateByKey
+BOOST_AUTO_TEST_CASE(testConflateByKey)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount * 2 + 4);
+    parameters.conflateByKey_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Conflate", parameters);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    BOOST_CHECK_THROW(consumer.tryPeekNext(), std::runtime_error);
+
+    // There is no default key.
+    BOOST_CHECK_THROW(producer.publish(producerMessage), std::runtime_error);
+
+    // Many more updates than entries, but only three keys, so the producer never waits.
+    static const uint64_t updates = entryCount * 10;
+    for(uint64_t update = 0; update < updates; ++update)
+    {
+        producerMessage.setSequence(Message::Sequence(update % 3));
+        producerMessage.emplace<uint64_t>(update);
+        producer.publish(producerMessage, update % 3);
+    }
+    // One message per key, in the order the keys first appeared, each holding the latest update.
+    for(uint64_t key = 0; key < 3; ++key)
+    {
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(key, consumerMessage.getSequence());
+        uint64_t latest = key + (updates - 1 - key) / 3 * 3;
+        BOOST_CHECK_EQUAL(latest, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // Once a message has been consumed the next one with its key is queued again.
+    producer.publish(producerMessage, 7);
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    producerMessage.emplace<uint64_t>(1);
+    producer.publish(producerMessage, 7);
+    producerMessage.emplace<uint64_t>(2);
+    producer.publish(producerMessage, 7);
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(2u, *consumerMessage.get<uint64_t>());
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // Consumed keys give their slots back, so conflation still works after many more keys than slots.
+    for(uint64_t key = 100; key < 100 + HighQConflationSlot::slotCount(entryCount) * 10; ++key)
+    {
+        producer.publish(producerMessage, key);
+        producer.publish(producerMessage, key + 1);
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    }
+    producerMessage.emplace<uint64_t>(3);
+    producer.publish(producerMessage, 5);
+    producerMessage.emplace<uint64_t>(4);
+    producer.publish(producerMessage, 5);
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(4u, *consumerMessage.get<uint64_t>());
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // A key extractor can take the key from the payload.
+    producer.setKeyExtractor([](const Message & message)
+    {
+        return ConflationKey(*message.get<uint64_t>() % 2);
+    });
+    MessageArray messages(connection, 4);
+    for(size_t nMessage = 0; nMessage < messages.size(); ++nMessage)
+    {
+        messages[nMessage].emplace<uint64_t>(nMessage);
+    }
+    producer.publish(messages.get(), messages.size());
+    BOOST_REQUIRE_EQUAL(2u, consumer.getNextBatch(messages.get(), messages.size()));
+    BOOST_CHECK_EQUAL(2u, *messages[0].get<uint64_t>());
+    BOOST_CHECK_EQUAL(3u, *messages[1].get<uint64_t>());
+
+    std::stringstream stats;
+    producer.writeStats(stats);
+    BOOST_CHECK(stats.str().find("ConflationRatio") != std::string::npos);
+
+    // Keyed publishing needs a conflating HighQueue.
+    ConnectionPtr plainConnection = std::make_shared<Connection>();
+    parameters.conflateByKey_ = false;
+    plainConnection->createLocal("Plain", parameters);
+    Producer plainProducer(plainConnection);
+    BOOST_CHECK_THROW(plainProducer.publish(producerMessage, 1), std::runtime_error);
+}
+#endif //  DISABLE_testConflateByKey
+
+#define DISABLE_testPriorityLanesx
+#ifdef DISABLE_testPriorityLanes
+#pragma message ("DISABLE_testPriorityLanes " __FILE__)
+#else // DISABLE_testPriorityLanes
+BOOST_AUTO_TEST_CASE(testPriorityLanes)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 16;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    parameters.priorityLanes_ = 2;
+    parameters.priorityEntryCount_ = 0;
+    ConnectionPtr empty = std::make_shared<Connection>();
+    // A lane with no room would never deliver its messages.
+    BOOST_CHECK_THROW(empty->createLocal("EmptyLanes", parameters), std::runtime_error);
+    parameters.priorityEntryCount_ = 4;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Lanes", parameters);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    BOOST_CHECK_EQUAL(2u, producer.getLaneCount());
+    BOOST_CHECK_THROW(consumer.tryPeekNext(), std::runtime_error);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+
+    // Fill the HighQueue with data, then send control messages.
+    for(uint64_t value = 0; value < entryCount; ++value)
+    {
+        producerMessage.emplace<uint64_t>(value);
+        producerMessage.setType(Message::MessageType::MockMessage);
+        producer.publish(producerMessage);
+    }
+    producerMessage.emplace<uint64_t>(100);
+    producerMessage.setType(Message::MessageType::LocalType0);
+    producer.publishToLane(producerMessage, 1);
+    producerMessage.emplace<uint64_t>(200);
+    producerMessage.setType(Message::MessageType::Heartbeat);
+    producer.publish(producerMessage);
+    producerMessage.emplace<uint64_t>(201);
+    producerMessage.setType(Message::MessageType::Shutdown);
+    producer.publish(producerMessage);
+    BOOST_CHECK_THROW(producer.publishToLane(producerMessage, 3), std::runtime_error);
+
+    // The highest lane comes first, in order, then the lower lane, then the data.
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(Message::MessageType::Heartbeat, consumerMessage.getType());
+    BOOST_CHECK_EQUAL(200u, *consumerMessage.get<uint64_t>());
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(Message::MessageType::Shutdown, consumerMessage.getType());
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(100u, *consumerMessage.get<uint64_t>());
+    for(uint64_t value = 0; value < entryCount; ++value)
+    {
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(value, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // In a batch the control message jumps ahead of the data published with it.
+    producer.setLane(Message::MessageType::LocalType1, 1);
+    MessageArray messages(connection, 4);
+    for(size_t nMessage = 0; nMessage < messages.size(); ++nMessage)
+    {
+        messages[nMessage].emplace<uint64_t>(nMessage);
+        messages[nMessage].setType(nMessage == 2 ? Message::MessageType::LocalType1 : Message::MessageType::MockMessage);
+    }
+    producer.publish(messages.get(), messages.size());
+    BOOST_REQUIRE_EQUAL(1u, consumer.tryGetNextBatch(messages.get(), messages.size()));
+    BOOST_CHECK_EQUAL(2u, *messages[0].get<uint64_t>());
+    BOOST_REQUIRE_EQUAL(3u, consumer.tryGetNextBatch(messages.get(), messages.size()));
+    BOOST_CHECK_EQUAL(0u, *messages[0].get<uint64_t>());
+    BOOST_CHECK_EQUAL(1u, *messages[1].get<uint64_t>());
+    BOOST_CHECK_EQUAL(3u, *messages[2].get<uint64_t>());
+
+    // A full lane waits for the consumer.
+    std::thread producerThread([&producer, &connection]()
+    {
+        Message heartbeat(connection);
+        for(uint64_t value = 0; value < 10; ++value)
+        {
+            heartbeat.emplace<uint64_t>(value);
+            heartbeat.setType(Message::MessageType::Heartbeat);
+            producer.publish(heartbeat);
+        }
+    });
+    for(uint64_t value = 0; value < 10; ++value)
+    {
+        BOOST_REQUIRE(consumer.getNext(consumerMessage));
+        BOOST_CHECK_EQUAL(value, *consumerMessage.get<uint64_t>());
+    }
+    producerThread.join();
+}
+#endif //  DISABLE_testPriorityLanes
+
+#define DISABLE_testLazyReadPositionx
+#ifdef DISABLE_testLazyReadPosition
+#pragma message ("DISABLE_testLazyReadPosition " __FILE__)
+#else // DISABLE_testLazyReadPosition
+BOOST_AUTO_TEST_CASE(testLazyReadPosition)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 8;
+    static const size_t interval = 4;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    parameters.readPositionInterval_ = interval;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Lazy", parameters);
+    BOOST_CHECK_EQUAL(interval, connection->getHeader()->readPositionInterval_);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    uint64_t published = 0;
+    uint64_t consumed = 0;
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(published++);
+        producer.publish(producerMessage);
+    }
+
+    // The read position is published every interval entries.
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(consumed++, *consumerMessage.get<uint64_t>());
+    BOOST_CHECK_EQUAL(entryCount, connection->getBacklog());
+    for(size_t nMessage = 1; nMessage < interval + 1; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(consumed++, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK_EQUAL(entryCount - interval, connection->getBacklog());
+
+    // The producer can use every entry the consumer has taken, published or not.
+    for(size_t nMessage = 0; nMessage < interval + 1; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(published++);
+        producer.publish(producerMessage);
+    }
+
+    // Running out of messages publishes the read position.
+    while(consumer.tryGetNext(consumerMessage))
+    {
+        BOOST_CHECK_EQUAL(consumed++, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK_EQUAL(published, consumed);
+    BOOST_CHECK_EQUAL(0u, connection->getBacklog());
+
+    // Batches and a busy producer.
+    static const uint64_t threadMessageCount = 100000;
+    std::thread producerThread([&producer, &connection, published]()
+    {
+        Message message(connection);
+        for(uint64_t value = published; value < published + threadMessageCount; ++value)
+        {
+            message.emplace<uint64_t>(value);
+            producer.publish(message);
+        }
+    });
+    MessageArray messages(connection, 3);
+    while(consumed < published + threadMessageCount)
+    {
+        size_t count = (consumed % 2 == 0)
+            ? consumer.getNextBatch(messages.get(), messages.size())
+            : size_t(consumer.getNext(messages[0]));
+        for(size_t nMessage = 0; nMessage < count; ++nMessage)
+        {
+            auto value = *messages[nMessage].get<uint64_t>();
+            if(value != consumed)
+            {
+                // the if avoids the performance hit of BOOST_CHECK unless it's needed.
+                BOOST_CHECK_EQUAL(consumed, value);
+            }
+            ++consumed;
+        }
+    }
+    producerThread.join();
+
+    // Modes that need the exact read position ignore the interval.
+    parameters.competingConsumers_ = true;
+    ConnectionPtr competing = std::make_shared<Connection>();
+    competing->createLocal("Competing", parameters);
+    BOOST_CHECK_EQUAL(1u, competing->getHeader()->readPositionInterval_);
+}
+#endif // DISABLE_testLazyReadPosition
+
+#define DISABLE_testCoalescedWakeupsx
+#ifdef DISABLE_testCoalescedWakeups
+#pragma message ("DISABLE_testCoalescedWakeups " __FILE__)
+#else // DISABLE_testCoalescedWakeups
+BOOST_AUTO_TEST_CASE(testCoalescedWakeups)
+{
+    static const size_t entryCount = 16;
+    static const size_t wakeCount = 4;
+    auto wakeLatency = std::chrono::milliseconds(500);
+    for(bool useFutex : {false, true})
+    {
+        // Go straight to the mutex/futex stage.
+        WaitStrategy consumerStrategy(0, 0, 0, std::chrono::nanoseconds(10), std::chrono::seconds(5), useFutex);
+        consumerStrategy.coalesceWakeups(wakeCount, wakeLatency);
+        BOOST_CHECK(consumerStrategy.coalesced());
+        BOOST_CHECK(consumerStrategy.parkPeriod() == wakeLatency);
+        WaitStrategy producerStrategy;
+        bool discardMessagesIfNoConsumer = false;
+        CreationParameters parameters(producerStrategy, consumerStrategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal(useFutex ? "CoalescedFutex" : "CoalescedMutex", parameters);
+        auto header = connection->getHeader();
+        auto sleeping = [header, useFutex]()
+        {
+            return useFutex ? header->consumerFutex_.mayBeParked() : header->consumerWaiting_.load();
+        };
+        auto waitUntil = [](std::function<bool()> condition)
+        {
+            for(size_t nTry = 0; nTry < 2000 && !condition(); ++nTry)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return condition();
+        };
+
+        Producer producer(connection);
+        Consumer consumer(connection);
+        std::atomic<size_t> received(0);
+        std::thread consumerThread([&consumer, &connection, &received]()
+        {
+            Message message(connection);
+            for(size_t nMessage = 0; nMessage < wakeCount + 1; ++nMessage)
+            {
+                if(consumer.getNext(message))
+                {
+                    ++received;
+                }
+            }
+        });
+
+        Message message(connection);
+        BOOST_REQUIRE(waitUntil(sleeping));
+        for(size_t nMessage = 0; nMessage < wakeCount - 1; ++nMessage)
+        {
+            message.emplace<uint64_t>(nMessage);
+            producer.publish(message);
+        }
+        // Too few messages to wake the consumer.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        BOOST_CHECK_EQUAL(0u, received.load());
+
+        // The wakeCount'th message wakes it.
+        Stopwatch timer;
+        message.emplace<uint64_t>(wakeCount);
+        producer.publish(message);
+        BOOST_CHECK(waitUntil([&received](){return received == wakeCount;}));
+        BOOST_CHECK_LT(timer.milliseconds(), 250u);
+
+        // A lone message is delivered within the latency even though no producer wakes the consumer.
+        BOOST_REQUIRE(waitUntil(sleeping));
+        timer.reset();
+        message.emplace<uint64_t>(wakeCount + 1);
+        producer.publish(message);
+        consumerThread.join();
+        BOOST_CHECK_EQUAL(wakeCount + 1, received.load());
+        BOOST_CHECK_LT(timer.milliseconds(), 1000u);
+    }
+}
+#endif // DISABLE_testCoalescedWakeups
+
+#define DISABLE_testPrefetchx
+#ifdef DISABLE_testPrefetch
+#pragma message ("DISABLE_testPrefetch " __FILE__)
+#else // DISABLE_testPrefetch
+BOOST_AUTO_TEST_CASE(testPrefetch)
+{
+    WaitStrategy strategy;
+    static const size_t entryCount = 16;
+    static const size_t messageCount = 1000;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(MockMessage), entryCount + 10);
+    parameters.prefetchDistance_ = 100;
+    ConnectionPtr limited = std::make_shared<Connection>();
+    limited->createLocal("PrefetchLimited", parameters);
+    BOOST_CHECK_EQUAL(entryCount - 1, limited->getHeader()->prefetchDistance_);
+
+    // Prefetching changes nothing the consumer sees, whether the entries ahead are published or not.
+    for(size_t distance : {1, 4})
+    {
+        parameters.prefetchDistance_ = distance;
+        ConnectionPtr connection = std::make_shared<Connection>();
+        connection->createLocal("Prefetch", parameters);
+        BOOST_CHECK_EQUAL(distance, connection->getHeader()->prefetchDistance_);
+        Producer producer(connection);
+        Consumer consumer(connection);
+        Message producerMessage(connection);
+        Message consumerMessage(connection);
+        MessageArray messages(connection, 5);
+        size_t consumed = 0;
+        for(size_t published = 0; published < messageCount;)
+        {
+            for(size_t nMessage = 0; nMessage < 7 && published < messageCount; ++nMessage)
+            {
+                std::stringstream msg;
+                msg << "Message " << published++;
+                producerMessage.emplace<MockMessage>(msg.str());
+                producer.publish(producerMessage);
+            }
+            if(published % 2 == 0)
+            {
+                while(consumer.tryGetNext(consumerMessage))
+                {
+                    std::stringstream msg;
+                    msg << "Message " << consumed++;
+                    BOOST_CHECK_EQUAL(msg.str(), consumerMessage.get<MockMessage>()->getString());
+                }
+            }
+            else
+            {
+                while(size_t count = consumer.tryGetNextBatch(messages.get(), messages.size()))
+                {
+                    for(size_t nMessage = 0; nMessage < count; ++nMessage)
+                    {
+                        std::stringstream msg;
+                        msg << "Message " << consumed++;
+                        BOOST_CHECK_EQUAL(msg.str(), messages[nMessage].get<MockMessage>()->getString());
+                    }
+                }
+            }
+        }
+        BOOST_CHECK_EQUAL(messageCount, consumed);
+    }
+
+    // A MultiQueueConsumer prefetches the next queue's entry.
+    // Messages move between the queues so they share a pool.
+    MemoryPoolPtr memoryPool = std::make_shared<MemoryPool>(sizeof(MockMessage), 3 * entryCount + 10);
+    ConnectionPtr first = std::make_shared<Connection>();
+    first->createLocal("PrefetchFirst", parameters, memoryPool);
+    ConnectionPtr second = std::make_shared<Connection>();
+    second->createLocal("PrefetchSecond", parameters, memoryPool);
+    MultiQueueConsumer multiConsumer;
+    multiConsumer.addQueue(first);
+    multiConsumer.addQueue(second);
+    Producer firstProducer(first);
+    Producer secondProducer(second);
+    Message producerMessage(first);
+    for(size_t nMessage = 0; nMessage < entryCount; ++nMessage)
+    {
+        producerMessage.emplace<MockMessage>("First");
+        firstProducer.publish(producerMessage);
+        producerMessage.emplace<MockMessage>("Second");
+        secondProducer.publish(producerMessage);
+    }
+    Message consumerMessage(first);
+    size_t firstCount = 0;
+    size_t secondCount = 0;
+    while(multiConsumer.tryGetNext(consumerMessage))
+    {
+        auto text = consumerMessage.get<MockMessage>()->getString();
+        firstCount += text == "First" ? 1 : 0;
+        secondCount += text == "Second" ? 1 : 0;
+    }
+    BOOST_CHECK_EQUAL(entryCount, firstCount);
+    BOOST_CHECK_EQUAL(entryCount, secondCount);
+}
+#endif // DISABLE_testPrefetch
@@ -3,10 +3,97 @@
 #include <boost/test/unit_test.hpp>
 
 #include <HighQueue/details/HQMemoryBlockPool.hpp>
+#include <HighQueue/MemoryPool.hpp>
 #include <Common/CacheLIne.hpp>
 
 using namespace HighQueue;
 
+namespace
+{
+    /// @brief Lets a Message be constructed without memory so the test can allocate it explicitly.
+    struct NoAllocation
+    {
+        void allocate(Message &)
+        {
+        }
+    };
+
+    /// @brief Several threads allocate and release blocks at once.  No block may be given to two threads,
+    /// and every block must be back in the pool when they are done.
+    void checkConcurrentUse(HQMemoryBlockPool * pool)
+    {
+        const static size_t threadCount = 4;
+        const static size_t heldCount = 3;
+        const static size_t loopCount = 20000;
+
+        size_t blockCount = pool->getBlockCount();
+
+        // Each thread stamps the blocks it holds.  A block given to two threads at once loses a stamp.
+        std::atomic<size_t> collisions(0);
+        std::atomic<size_t> allocated(0);
+        std::vector<std::thread> threads;
+        for(size_t nThread = 0; nThread < threadCount; ++nThread)
+        {
+            threads.emplace_back([pool, nThread, &collisions, &allocated]()
+            {
+                NoAllocation noAllocation;
+                auto allocator = &noAllocation;
+                std::vector<std::unique_ptr<Message>> messages;
+                for(size_t nMessage = 0; nMessage < heldCount; ++nMessage)
+                {
+                    messages.emplace_back(new Message(allocator));
+                }
+                size_t count = 0;
+                for(size_t nLoop = 0; nLoop < loopCount; ++nLoop)
+                {
+                    for(auto & message : messages)
+                    {
+                        if(pool->tryAllocate(*message))
+                        {
+                            *message->get<size_t>() = nThread * loopCount + nLoop;
+                            ++count;
+                        }
+                    }
+                    std::this_thread::yield();
+                    for(auto & message : messages)
+                    {
+                        if(message->getContainer() != 0)
+                        {
+                            if(*message->get<size_t>() != nThread * loopCount + nLoop)
+                            {
+                                ++collisions;
+                            }
+                            pool->release(*message);
+                        }
+                    }
+                }
+                allocated += count;
+            });
+        }
+        for(auto & thread : threads)
+        {
+            thread.join();
+        }
+        BOOST_CHECK_EQUAL(0u, collisions.load());
+        BOOST_CHECK_GT(allocated.load(), 0u);
+
+        // Every block came back exactly once.
+        NoAllocation noAllocation;
+        auto allocator = &noAllocation;
+        std::vector<std::unique_ptr<Message>> messages;
+        while(messages.size() <= blockCount)
+        {
+            messages.emplace_back(new Message(allocator));
+            if(!pool->tryAllocate(*messages.back()))
+            {
+                break;
+            }
+        }
+        BOOST_CHECK_EQUAL(blockCount + 1, messages.size());
+        BOOST_CHECK(pool->isEmpty());
+    }
+}
+
 #define DISABLE_testPoolAllocationx
 #ifdef DISABLE_testPoolAllocation
 #pragma message ("DISABLE_testPoolAllocation " __FILE__)
@@ -60,3 +147,147 @@ BOOST_AUTO_TEST_CASE(testPoolAllocator)
     }
 }
 #endif // DISABLE_testAllocatorMessageOwner
+
+#define DISABLE_testPoolConcurrencyx
+#ifdef DISABLE_testPoolConcurrency
+#pragma message ("DISABLE_testPoolConcurrency " __FILE__)
+#else // DISABLE_testPoolConcurrency
+BOOST_AUTO_TEST_CASE(testPoolConcurrency)
+{
+    const static size_t messageSize = 100;
+    const static size_t messageCount = 8;
+
+    size_t blockSize = HQMemoryBlockPool::spaceNeeded(messageSize, messageCount);
+    std::unique_ptr<byte_t[]> block(new byte_t[blockSize]);
+    auto pool = new (block.get()) HQMemoryBlockPool(blockSize, messageSize);
+    checkConcurrentUse(pool);
+}
+#endif // DISABLE_testPoolConcurrency
+
+#define DISABLE_testThreadCachesx
+#ifdef DISABLE_testThreadCaches
+#pragma message ("DISABLE_testThreadCaches " __FILE__)
+#else // DISABLE_testThreadCaches
+BOOST_AUTO_TEST_CASE(testThreadCaches)
+{
+    const static size_t messageSize = 100;
+    const static size_t messageCount = 64;
+    const static size_t batchSize = 4;
+
+    MemoryPool memoryPool(messageSize, messageCount);
+    memoryPool.enableThreadCaches(batchSize);
+    auto pool = &memoryPool.getPool();
+    size_t blockCount = pool->getBlockCount();
+
+    checkConcurrentUse(pool);
+
+    // A thread that holds one message keeps the rest of its batch.
+    std::atomic<int> step(0);
+    std::thread holder([pool, &step]()
+    {
+        NoAllocation noAllocation;
+        auto allocator = &noAllocation;
+        Message message(allocator);
+        BOOST_CHECK(pool->tryAllocate(message));
+        step = 1;
+        while(step != 2)
+        {
+            std::this_thread::yield();
+        }
+        // The pool asked for the cached blocks back.  This release returns them.
+        message.release();
+        step = 3;
+        while(step != 4)
+        {
+            std::this_thread::yield();
+        }
+        // Exiting gives back the block that was just released.
+    });
+    while(step != 1)
+    {
+        std::this_thread::yield();
+    }
+
+    NoAllocation noAllocation;
+    auto allocator = &noAllocation;
+    std::vector<std::unique_ptr<Message>> messages;
+    auto allocateAll = [&]()
+    {
+        while(true)
+        {
+            std::unique_ptr<Message> message(new Message(allocator));
+            if(!pool->tryAllocate(*message))
+            {
+                break;
+            }
+            messages.emplace_back(std::move(message));
+        }
+    };
+    allocateAll();
+    BOOST_CHECK_EQUAL(blockCount - batchSize, messages.size());
+
+    step = 2;
+    while(step != 3)
+    {
+        std::this_thread::yield();
+    }
+    allocateAll();
+    BOOST_CHECK_EQUAL(blockCount - 1, messages.size());
+
+    step = 4;
+    holder.join();
+    allocateAll();
+    BOOST_CHECK_EQUAL(blockCount, messages.size());
+}
+#endif // DISABLE_testThreadCaches
+
+#define DISABLE_testSizeClassesx
+#ifdef DISABLE_testSizeClasses
+#pragma message ("DISABLE_testSizeClasses " __FILE__)
+#else // DISABLE_testSizeClasses
+BOOST_AUTO_TEST_CASE(testSizeClasses)
+{
+    MemoryPool::SizeClasses sizeClasses;
+    sizeClasses.emplace_back(1000, 2);
+    sizeClasses.emplace_back(32, 4);
+    sizeClasses.emplace_back(200, 3);
+    auto pool = std::make_shared<MemoryPool>(sizeClasses);
+    BOOST_REQUIRE_EQUAL(3u, pool->getClassCount());
+    auto smallCapacity = pool->getClass(0).getBlockCapacity();
+    auto mediumCapacity = pool->getClass(1).getBlockCapacity();
+    auto largeCapacity = pool->getClass(2).getBlockCapacity();
+    BOOST_CHECK_EQUAL(HQMemoryBlockPool::cacheAlignedMessageSize(32), smallCapacity);
+    BOOST_CHECK_EQUAL(HQMemoryBlockPool::cacheAlignedMessageSize(200), mediumCapacity);
+    BOOST_CHECK_EQUAL(HQMemoryBlockPool::cacheAlignedMessageSize(1000), largeCapacity);
+    BOOST_CHECK_EQUAL(largeCapacity, pool->getBlockCapacity());
+    BOOST_CHECK_EQUAL(mediumCapacity, pool->getBlockCapacity(100));
+
+    // The smallest class that fits.  No hint (or too large a hint) means the largest class.
+    Message tiny(pool, 10);
+    Message medium(pool, 100);
+    Message unsized(pool);
+    Message huge(pool, 5000);
+    BOOST_CHECK_EQUAL(smallCapacity, tiny.available());
+    BOOST_CHECK_EQUAL(mediumCapacity, medium.available());
+    BOOST_CHECK_EQUAL(largeCapacity, unsized.available());
+    BOOST_CHECK_EQUAL(largeCapacity, huge.available());
+
+    // When a class runs out the next larger one is used.
+    size_t smallCount = pool->getClass(0).getBlockCount();
+    std::vector<std::unique_ptr<Message>> messages;
+    for(size_t nMessage = 1; nMessage < smallCount; ++nMessage)
+    {
+        messages.emplace_back(new Message(pool, 10));
+        BOOST_CHECK_EQUAL(smallCapacity, messages.back()->available());
+    }
+    BOOST_CHECK(pool->getClass(0).isEmpty());
+    Message overflow(pool, 10);
+    BOOST_CHECK_EQUAL(mediumCapacity, overflow.available());
+
+    // Released blocks go back to the class they came from.
+    tiny.release();
+    BOOST_CHECK(!pool->getClass(0).isEmpty());
+    Message again(pool, 10);
+    BOOST_CHECK_EQUAL(smallCapacity, again.available());
+}
+#endif // DISABLE_testSizeClasses
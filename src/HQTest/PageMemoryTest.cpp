@@ -0,0 +1,131 @@
+#include <Common/HighQueuePch.hpp>
+
+#define BOOST_TEST_NO_MAIN HighQueueTest
+#include <boost/test/unit_test.hpp>
+
+#include <HighQueue/details/HQPageMemory.hpp>
+#include <HighQueue/MemoryPool.hpp>
+#include <HighQueue/Connection.hpp>
+#include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+
+using namespace HighQueue;
+
+#define DISABLE_testPageMemoryx
+#ifdef DISABLE_testPageMemory
+#pragma message ("DISABLE_testPageMemory " __FILE__)
+#else // DISABLE_testPageMemory
+BOOST_AUTO_TEST_CASE(testPageMemory)
+{
+    const size_t size = 3 * 1024 * 1024 + 100;
+
+    HighQPageMemory::Backing backing = HighQPageMemory::HugePages;
+    PageOptions heap;
+    auto memory = HighQPageMemory::allocate(size, heap, &backing);
+    BOOST_CHECK_EQUAL(HighQPageMemory::Heap, backing);
+    memory.get()[size - 1] = 1;
+
+    // Huge pages fall back to what the system has.
+    PageOptions huge;
+    huge.hugePages_ = true;
+    memory = HighQPageMemory::allocate(size, huge, &backing);
+    BOOST_TEST_MESSAGE("Huge pages backed by " << HighQPageMemory::backingName(backing));
+    BOOST_CHECK(backing != HighQPageMemory::Heap);
+    if(backing != HighQPageMemory::OrdinaryPages)
+    {
+        BOOST_CHECK_EQUAL(0u, uintptr_t(memory.get()) % HighQPageMemory::hugePageSize());
+    }
+    std::memset(memory.get(), 0xA5, size);
+    BOOST_CHECK_EQUAL(0xA5, memory.get()[size - 1]);
+
+    // Locking may be refused (the limit on locked memory is often small) but the memory is still usable.
+    PageOptions resident;
+    resident.prefault_ = true;
+    resident.lockPages_ = true;
+    memory = HighQPageMemory::allocate(size, resident, &backing);
+    BOOST_CHECK_EQUAL(HighQPageMemory::OrdinaryPages, backing);
+    BOOST_CHECK_EQUAL(0, memory.get()[size / 2]);
+    memory.reset();
+
+    auto pool = std::make_shared<MemoryPool>(1000, 1000, huge);
+    Message message(pool);
+    BOOST_CHECK_GE(message.available(), 1000u);
+}
+#endif // DISABLE_testPageMemory
+
+#define DISABLE_testHugePageQueuex
+#ifdef DISABLE_testHugePageQueue
+#pragma message ("DISABLE_testHugePageQueue " __FILE__)
+#else // DISABLE_testHugePageQueue
+BOOST_AUTO_TEST_CASE(testHugePageQueue)
+{
+    const size_t entryCount = 10000;
+    const size_t messageCount = 1000;
+
+    WaitStrategy strategy;
+    CreationParameters parameters(strategy, strategy, false, entryCount, sizeof(uint64_t), entryCount + 10);
+    parameters.pageOptions_.hugePages_ = true;
+    parameters.pageOptions_.prefault_ = true;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    MemoryPoolPtr noPool;
+    connection->createLocal("HugePageQueue", parameters, noPool);
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    for(uint64_t nMessage = 0; nMessage < messageCount; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(nMessage);
+        producer.publish(producerMessage);
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+        consumerMessage.release();
+        connection->allocate(consumerMessage);
+    }
+}
+#endif // DISABLE_testHugePageQueue
+
+#define DISABLE_testNumaPlacementx
+#ifdef DISABLE_testNumaPlacement
+#pragma message ("DISABLE_testNumaPlacement " __FILE__)
+#else // DISABLE_testNumaPlacement
+BOOST_AUTO_TEST_CASE(testNumaPlacement)
+{
+    const size_t size = 1024 * 1024;
+    auto nodeCount = HighQPageMemory::nodeCount();
+    BOOST_REQUIRE_GE(nodeCount, 1);
+    BOOST_CHECK_EQUAL(0, HighQPageMemory::physicalNode(nodeCount));
+    BOOST_CHECK_EQUAL(-1, HighQPageMemory::physicalNode(-1));
+    BOOST_TEST_MESSAGE("NUMA nodes: " << nodeCount << " running on node " << HighQPageMemory::currentNode());
+
+    // Every node, plus one more that is emulated by node 0.
+    for(int node = 0; node <= nodeCount; ++node)
+    {
+        PageOptions options;
+        options.numaNode_ = node;
+        options.prefault_ = true;
+        HighQPageMemory::Backing backing = HighQPageMemory::Heap;
+        auto memory = HighQPageMemory::allocate(size, options, &backing);
+        BOOST_CHECK(backing != HighQPageMemory::Heap);
+        auto placed = HighQPageMemory::nodeOf(memory.get() + size / 2);
+        if(placed >= 0)
+        {
+            BOOST_CHECK_EQUAL(HighQPageMemory::physicalNode(node), placed);
+        }
+    }
+
+    // Messages from a queue's own pool belong to it.  Messages from anywhere else do not.
+    WaitStrategy strategy;
+    CreationParameters parameters(strategy, strategy, false, 16, sizeof(uint64_t), 20);
+    parameters.pageOptions_.numaNode_ = nodeCount;
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("NodeQueue", parameters);
+    auto otherPool = std::make_shared<MemoryPool>(sizeof(uint64_t), 4);
+    Message local(connection);
+    Message other(otherPool);
+    BOOST_CHECK(connection->owns(local));
+    BOOST_CHECK(!connection->owns(other));
+    BOOST_CHECK(otherPool->owns(other));
+}
+#endif // DISABLE_testNumaPlacement
@@ -3,6 +3,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <HighQueue/Producer.hpp>
+#include <HighQueue/Consumer.hpp>
+#include <HighQueue/MessageArray.hpp>
 
 using namespace HighQueue;
 
@@ -111,3 +113,207 @@ BOOST_AUTO_TEST_CASE(testProducer)
 }
 #endif //  DISABLE_testProducer
 
+
+#define DISABLE_testProducerBatchx
+#ifdef DISABLE_testProducerBatch
+#pragma message ("DISABLE_testProducerBatch " __FILE__)
+#else // DISABLE_testProducerBatch
+BOOST_AUTO_TEST_CASE(testProducerBatch)
+{
+    WaitStrategy strategy;
+    size_t entryCount = 10;
+    size_t messageSize = sizeof(MockMessage);
+    size_t messageCount = 50;
+    bool discardMessagesIfNoConsumer = false;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, messageSize, messageCount);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("LocalIv", parameters);
+    Producer producer(connection);
+    // peek inside the IV.
+    auto header = connection->getHeader();
+    HighQResolver resolver(header);
+    auto readPosition = resolver.resolve<Position>(header->readPosition_);
+    auto publishPosition = resolver.resolve<Position>(header->publishPosition_);
+    HighQEntryAccessor accessor(resolver, header->entries_, header->entryCount_);
+
+    size_t batchSize = 4;
+    MessageArray messages(connection, batchSize);
+    BOOST_CHECK_EQUAL(messages.size(), batchSize);
+    std::vector<MockMessage *> testMessages;
+    for(size_t nMessage = 0; nMessage < batchSize; ++nMessage)
+    {
+        std::stringstream msg;
+        msg << "Batched " << nMessage << std::ends;
+        testMessages.push_back(&messages[nMessage].emplace<MockMessage>(msg.str()));
+    }
+
+    producer.publish(messages.get(), batchSize);
+    BOOST_CHECK_EQUAL(*readPosition + batchSize, *publishPosition);
+    for(size_t nMessage = 0; nMessage < batchSize; ++nMessage)
+    {
+        BOOST_CHECK(messages[nMessage].isEmpty());
+        HighQEntry & entry = accessor[*readPosition + nMessage];
+        BOOST_CHECK_EQUAL(entry.status_, HighQEntry::Status::OK);
+        BOOST_CHECK_EQUAL(entry.message_.get<MockMessage>(), testMessages[nMessage]);
+        BOOST_CHECK_EQUAL(sizeof(MockMessage), entry.message_.getUsed());
+    }
+
+    // A skipped entry is passed over without losing a message.
+    accessor[*publishPosition].status_ = HighQEntry::Status::SKIP;
+    testMessages.clear();
+    for(size_t nMessage = 0; nMessage < batchSize; ++nMessage)
+    {
+        testMessages.push_back(&messages[nMessage].emplace<MockMessage>("Second batch"));
+    }
+    producer.publish(messages.get(), batchSize);
+    BOOST_CHECK_EQUAL(*readPosition + 2 * batchSize + 1, *publishPosition);
+    for(size_t nMessage = 0; nMessage < batchSize; ++nMessage)
+    {
+        HighQEntry & entry = accessor[*readPosition + batchSize + 1 + nMessage];
+        BOOST_CHECK_EQUAL(entry.status_, HighQEntry::Status::OK);
+        BOOST_CHECK_EQUAL(entry.message_.get<MockMessage>(), testMessages[nMessage]);
+    }
+}
+#endif //  DISABLE_testProducerBatch
+
+#define DISABLE_testCompileTimePoliciesx
+#ifdef DISABLE_testCompileTimePolicies
+#pragma message ("DISABLE_testCompileTimePolicies " __FILE__)
+#else // DISABLE_testCompileTimePolicies
+BOOST_AUTO_TEST_CASE(testCompileTimePolicies)
+{
+    typedef BasicProducer<Solo, PollingWait, NoDiscard, PowerOfTwoEntryCount> FastProducer;
+    typedef BasicConsumer<PollingWait, PowerOfTwoEntryCount> FastConsumer;
+
+    WaitStrategy strategy;  // sleeps forever, so nobody waits on a mutex or futex.
+    bool discardMessagesIfNoConsumer = false;
+    static const size_t entryCount = 16;
+    static const size_t messageCount = entryCount * 5 + 3;
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 10);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Policies", parameters);
+    connection->willProduce();
+
+    FastProducer producer(connection);
+    FastConsumer consumer(connection);
+    Message producerMessage(connection);
+    Message consumerMessage(connection);
+    for(uint64_t nMessage = 0; nMessage < messageCount; ++nMessage)
+    {
+        producerMessage.emplace<uint64_t>(nMessage);
+        producer.publish(producerMessage);
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // Policies that don't match the HighQueue are caught when the producer or consumer is constructed.
+    typedef BasicConsumer<MutexWait, AnyEntryCount> MutexConsumer;
+    BOOST_CHECK_THROW(MutexConsumer mismatched(connection), std::runtime_error);
+    connection->willProduce(); // no longer solo
+    BOOST_CHECK_THROW(FastProducer notSolo(connection), std::runtime_error);
+    typedef BasicProducer<NotSolo, PollingWait, Discard, AnyEntryCount> DiscardingProducer;
+    BOOST_CHECK_THROW(DiscardingProducer discarding(connection), std::runtime_error);
+
+    CreationParameters oddParameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount - 1, sizeof(uint64_t), entryCount + 10);
+    ConnectionPtr oddConnection = std::make_shared<Connection>();
+    oddConnection->createLocal("OddPolicies", oddParameters);
+    BOOST_CHECK_THROW(FastConsumer oddConsumer(oddConnection), std::runtime_error);
+}
+#endif //  DISABLE_testCompileTimePolicies
+
+#define DISABLE_testProducerClaimx
+#ifdef DISABLE_testProducerClaim
+#pragma message ("DISABLE_testProducerClaim " __FILE__)
+#else // DISABLE_testProducerClaim
+BOOST_AUTO_TEST_CASE(testProducerClaim)
+{
+    WaitStrategy strategy;
+    bool discardMessagesIfNoConsumer = false;
+    static const size_t entryCount = 8;
+    static const size_t messageCount = entryCount * 3 + 1;
+    // Only the consumer needs a message of its own.
+    CreationParameters parameters(strategy, strategy, discardMessagesIfNoConsumer, entryCount, sizeof(uint64_t), entryCount + 1);
+    ConnectionPtr connection = std::make_shared<Connection>();
+    connection->createLocal("Claim", parameters);
+    connection->willProduce();
+
+    Producer producer(connection);
+    Consumer consumer(connection);
+    Message consumerMessage(connection);
+    BOOST_CHECK(!producer.claimBlocksProducers());
+    BOOST_CHECK_THROW(producer.commit(), std::runtime_error);
+
+    for(uint64_t nMessage = 0; nMessage < messageCount; ++nMessage)
+    {
+        Message * claimed = producer.claim();
+        BOOST_REQUIRE(claimed != nullptr);
+        BOOST_CHECK(claimed->isEmpty());
+        BOOST_CHECK_THROW(producer.claim(), std::runtime_error);
+        // Not visible until it is committed.
+        BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+        claimed->setType(Message::MessageType::MockMessage);
+        claimed->emplace<uint64_t>(nMessage);
+        producer.commit();
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK(Message::MessageType::MockMessage == consumerMessage.getType());
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+    }
+
+    // Claims and ordinary publishes mix.
+    Message producerMessage(connection);
+    producerMessage.emplace<uint64_t>(messageCount);
+    producer.publish(producerMessage);
+    producer.claim()->emplace<uint64_t>(messageCount + 1);
+    producer.commit();
+    for(uint64_t nMessage = messageCount; nMessage < messageCount + 2; ++nMessage)
+    {
+        BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+        BOOST_CHECK_EQUAL(nMessage, *consumerMessage.get<uint64_t>());
+    }
+    BOOST_CHECK(!consumer.tryGetNext(consumerMessage));
+
+    // A second producer means the spin lock is held from claim() to commit().
+    connection->willProduce();
+    Producer shared(connection);
+    BOOST_CHECK(shared.claimBlocksProducers());
+    shared.claim()->emplace<uint64_t>(messageCount + 2);
+    shared.commit();
+    BOOST_REQUIRE(consumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(messageCount + 2, *consumerMessage.get<uint64_t>());
+
+    // Lock free producers don't hold each other up.
+    parameters.lockFreeProducers_ = true;
+    ConnectionPtr lockFreeConnection = std::make_shared<Connection>();
+    lockFreeConnection->createLocal("LockFreeClaim", parameters);
+    lockFreeConnection->willProduce();
+    lockFreeConnection->willProduce();
+    Producer first(lockFreeConnection);
+    Producer second(lockFreeConnection);
+    Consumer lockFreeConsumer(lockFreeConnection);
+    BOOST_CHECK(!first.claimBlocksProducers());
+    Message * firstClaim = first.claim();
+    Message * secondClaim = second.claim();
+    secondClaim->emplace<uint64_t>(2);
+    second.commit();
+    // The consumer reads in order, so it waits for the first claim.
+    BOOST_CHECK(!lockFreeConsumer.tryGetNext(consumerMessage));
+    firstClaim->emplace<uint64_t>(1);
+    first.commit();
+    BOOST_REQUIRE(lockFreeConsumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(1u, *consumerMessage.get<uint64_t>());
+    BOOST_REQUIRE(lockFreeConsumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(2u, *consumerMessage.get<uint64_t>());
+
+    // An abandoned claim is skipped rather than delivered.
+    BOOST_CHECK_THROW(first.abandonClaim(), std::runtime_error);
+    first.claim();
+    secondClaim = second.claim();
+    secondClaim->emplace<uint64_t>(4);
+    second.commit();
+    first.abandonClaim();
+    BOOST_REQUIRE(lockFreeConsumer.tryGetNext(consumerMessage));
+    BOOST_CHECK_EQUAL(4u, *consumerMessage.get<uint64_t>());
+    BOOST_CHECK(!lockFreeConsumer.tryGetNext(consumerMessage));
+}
+#endif //  DISABLE_testProducerClaim
@@ -0,0 +1,1256 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/IConsumer.hpp>
+#include <HighQueue/Connection.hpp>
+#include <HighQueue/Policies.hpp>
+#include <HighQueue/details/HQResolver.hpp>
+#include <HighQueue/details/HQReservePosition.hpp>
+#include <HighQueue/details/HQAbandonedPositions.hpp>
+#include <HighQueue/details/HQEntryAccessor.hpp>
+#include <HighQueue/details/HQSubscriberPosition.hpp>
+#include <HighQueue/details/HQPriorityLane.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
+#include <HighQueue/details/HQWaitBudget.hpp>
+
+namespace HighQueue
+{
+    /// @brief Support for consuming messages from an HighQueue
+    /// In addition to having the Connection which is used to construct
+    /// this object, you will need a Message which has been initialized
+    /// by calling the Connection::allocate() method.
+    ///
+    /// If the HighQueue was created with CreationParameters::competingConsumers_
+    /// several Consumers may be attached.  Each message is delivered to exactly one of them.
+    ///
+    /// If the HighQueue was created with CreationParameters::subscriberCount_ each Consumer
+    /// is a subscriber that sees every message.  Subscribers should use tryPeekNext()/peekNext()
+    /// and releasePeeked() to read messages in place.  The get methods copy each message.
+    /// A single consumer that only reads its messages may use them, too.
+    ///
+    /// If the HighQueue was created with CreationParameters::overwriteWhenFull_ the producers
+    /// may overwrite messages before they are read.  The Consumer copies each message, skips
+    /// any it lost, and counts them.  See getOverruns().
+    ///
+    /// If the HighQueue was created with CreationParameters::conflateByKey_ a producer may
+    /// replace a message the Consumer has not yet taken.  The Consumer always gets the latest.
+    ///
+    /// If the HighQueue was created with CreationParameters::priorityLanes_ the get methods
+    /// take any messages waiting in the priority lanes, highest lane first, before the next
+    /// message in the HighQueue itself.
+    ///
+    /// The policies fix some decisions at compile time so the per message code does not test them.
+    /// Consumer uses the policies that take every decision from the HighQueue's configuration.
+    /// @tparam WaitPolicy how the producers wait: ConfiguredWait, PollingWait, MutexWait, or FutexWait
+    /// @tparam EntryCountPolicy AnyEntryCount or PowerOfTwoEntryCount
+    /// @throws runtime_error from the constructor if a fixed policy does not match the HighQueue.
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    class BasicConsumer : public IConsumer
+    {
+    public:
+        /// @brief Construct and attach to a connection
+        /// @param connection provides access to the HighQueue
+        explicit BasicConsumer(ConnectionPtr & connection);
+
+        ~BasicConsumer();
+
+        /// @brief Get the next message-full of data if it is available
+        ///
+        /// You must call one of the Message::get() methods after a successful return
+        /// from this call in order to access the data.  Do NOT save the result
+        /// from a previous Message::get() call.  It will be invalidated by this call.
+        ///
+        /// @param message The message will be populated from the HighQueue entry.
+        /// @returns immediately.  true if the message now contains data; false if no data is available.
+        bool tryGetNext(Message & message);
+
+        /// @brief Get the next message-full of data.  Wait if none is available
+        ///
+        /// You must call one of the Message::get() methods after this call returns
+        /// in order to access the data.  Do NOT save the result
+        /// from a previous Message::get() call.  It will be invalidated by this call.
+        ///
+        /// @param message The message will be populated from the HighQueue entry.
+        /// @returns true unless shutting down.
+        /// Note: uses the WaitStrategy to wait.
+        bool getNext(Message & message);
+
+        /// @brief Get as many messages as are available, up to a limit.
+        ///
+        /// Entries are consumed in order and the read position is updated once
+        /// at the end so the producer sees a single change rather than one per message.
+        ///
+        /// @param messages points to the first of limit messages to be populated. See MessageArray.
+        /// @param limit is the maximum number of messages to return.
+        /// When consumers compete the whole batch is claimed at once.
+        ///
+        /// @returns immediately.  The number of messages populated. Zero if no data is available.
+        size_t tryGetNextBatch(Message * messages, size_t limit);
+
+        /// @brief Get as many messages as are available, up to a limit.  Wait if none are available.
+        /// @param messages points to the first of limit messages to be populated. See MessageArray.
+        /// @param limit is the maximum number of messages to return.
+        /// @returns the number of messages populated.  Zero only if shutting down.
+        /// Note: uses the WaitStrategy to wait.
+        size_t getNextBatch(Message * messages, size_t limit);
+
+        /// @brief Look at the next message in place if it is available.
+        ///
+        /// The message stays in the HighQueue so nothing is copied or moved and the entry
+        /// is never written by the consumer.  It remains valid until releasePeeked() is called.
+        /// Several messages may be peeked before they are released.
+        /// Available to a single consumer or to subscribers of a broadcast HighQueue.
+        /// Not available for competing consumers, for a HighQueue in shared memory,
+        /// or with CreationParameters::inlinePayloads_.
+        /// A single consumer should release what it has peeked before using the get methods.
+        ///
+        /// @throws runtime_error if peeking is not available.
+        /// @returns immediately.  The message, or null if no data is available.
+        const Message * tryPeekNext();
+
+        /// @brief Look at the next message in place.  Wait if none is available.
+        /// @returns the message, or null if shutting down.
+        /// Note: uses the WaitStrategy to wait.
+        const Message * peekNext();
+
+        /// @brief Let the producers reuse the entries for all messages peeked so far.
+        void releasePeeked();
+
+        /// @brief How many messages were overwritten by the producers before they could be read.
+        /// Always zero unless the HighQueue was created with CreationParameters::overwriteWhenFull_.
+        uint64_t getOverruns() const;
+
+        /// @brief Find the Positions of the most recent run of overwritten messages.
+        /// @param start receives the Position of the first message lost.
+        /// @param end receives the Position after the last message lost.
+        void getLatestOverrun(Position & start, Position & end) const;
+
+        /// @brief Start loading the entry the next get will use.
+        /// MultiQueueConsumer calls this for the HighQueue it will check next.
+        /// Does nothing unless the HighQueue was created with CreationParameters::prefetchDistance_.
+        void prefetchNext();
+
+        /// @brief for diagnosing and performance measurements, dump statistics
+        std::ostream & writeStats(std::ostream & out)const;
+
+        /// @brief stop receiving messages.
+        void stop();
+
+    private:
+        void incrementReadPosition();
+        void publishReadPosition();
+        void catchUpReadPosition();
+        void notifyProducer();
+        bool isPublished(Position position);
+        bool takeAbandoned(Position position);
+        void takeEntry(HighQEntry & entry, Message & message);
+        void prefetchAhead(Position position, bool withPayload);
+        void prefetchEntry(Position position, bool withPayload);
+        /// @brief Most cache lines of a message block to prefetch.
+        static const size_t MaxPrefetchLines = 4;
+        void lockConflatedEntry(HighQEntry & entry, Position position);
+        bool tryGetFromLanes(Message & message);
+        void useCurrentRing();
+
+        HighQEntry & entryAt(Position position) const
+        {
+            // Positions before the fence were published before the most recent resize.
+            return position < ringFence_ ? previousEntryAccessor_[position] : entryAccessor_[position];
+        }
+        bool tryClaimNext(Message & message);
+        size_t tryClaimNextBatch(Message * messages, size_t limit);
+        void releaseClaimed(Position position, Position end);
+        HighQEntry * nextPublishedEntry();
+        void copyEntry(HighQEntry & entry, Message & message);
+        bool tryCopyNext(Message & message);
+        size_t tryCopyNextBatch(Message * messages, size_t limit);
+        bool tryCopyUnlessOverwritten(Message & message, bool mayOverrun);
+        size_t tryCopyUnlessOverwrittenBatch(Message * messages, size_t limit, bool mayOverrun);
+        void skipOverwritten(Position position);
+        void publishSubscriberPosition(Position position);
+        template <typename TryFunction>
+        bool waitFor(TryFunction tryFunction);
+
+        /// @brief Has the consumer been sleeping for longer than mutexWaitTimeout_?
+        bool waitTimedOut(uint64_t parkedSince) const
+        {
+            return Stopwatch::now() - parkedSince >= uint64_t(waitStrategy_.mutexWaitTimeout_.count());
+        }
+
+        bool producerUsesMutex() const
+        {
+            return WaitPolicy::fixed ? WaitPolicy::mutex : producerUsesMutex_;
+        }
+        bool producerUsesFutex() const
+        {
+            return WaitPolicy::fixed ? WaitPolicy::futex : producerUsesFutex_;
+        }
+    private:
+        ConnectionPtr connection_;
+        HQHeader * header_;
+        bool producerUsesMutex_;
+        bool producerUsesFutex_;
+        bool lockFreeProducers_;
+        bool competing_;
+        size_t subscriberCount_;
+        bool overwrite_;
+        bool conflate_;
+        size_t entryCount_;
+        HighQResolver resolver_;
+        HighQBasicEntryAccessor<EntryCountPolicy> entryAccessor_;
+        bool resizable_;
+        uint32_t ringGeneration_;
+        HighQBasicEntryAccessor<EntryCountPolicy> previousEntryAccessor_;
+        Position ringFence_;
+        HQMemoryBlockPool * sharedPool_;
+        HighQAbandonedPositions * abandoned_;
+        /// @brief See CreationParameters::prefetchDistance_
+        size_t prefetchDistance_;
+        /// @brief See CreationParameters::readPositionInterval_.  When more than one readPosition_
+        /// refers to privateReadPosition_ and publishReadPosition() copies it to sharedReadPosition_.
+        size_t readPositionInterval_;
+        Position privateReadPosition_;
+        Position publishedReadPosition_;
+        volatile Position & readPosition_;
+        AtomicPosition & sharedReadPosition_;
+        AtomicPosition & claimPosition_;
+        AtomicPosition & publishPosition_;
+        Position cachedPublishPosition_;
+        HighQSubscriberPosition * subscriberPositions_;
+        HighQSubscriberPosition * subscriberPosition_;
+        Position peekPosition_;
+        const char * peekError_;
+        Position overrunStart_;
+        Position overrunEnd_;
+        size_t laneCount_;
+        HighQPriorityLane * lanes_;
+        const WaitStrategy & waitStrategy_;
+        HighQWaitBudget waitBudget_;
+
+        bool stopping_;
+
+        /// @brief The counters that tools such as hqstat can read while the HighQueue runs.
+        /// privateStats_ is used if all the HighQueue's slots are taken.
+        HighQStatistics & statistics_;
+        HighQStatRecord privateStats_;
+        HighQStatRecord & stats_;
+
+        HighQStatCounter & statConsumed_;
+        uint64_t statGets_;
+        uint64_t statTrys_;
+        uint64_t statBatches_;
+        uint64_t statCollisions_;
+        uint64_t statOverruns_;
+        uint64_t statPriority_;
+        HighQStatCounter & statSpins_;
+        HighQStatCounter & statYields_;
+        HighQStatCounter & statSleeps_;
+        HighQStatCounter & statWaits_;
+    };
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    BasicConsumer<WaitPolicy, EntryCountPolicy>::BasicConsumer(ConnectionPtr & connection)
+    : connection_(connection)
+    , header_(connection_->getHeader())
+    , producerUsesMutex_(header_->producerWaitStrategy_.mutexUsed_)
+    , producerUsesFutex_(header_->producerWaitStrategy_.futexUsed_)
+    , lockFreeProducers_(header_->lockFreeProducers_)
+    , competing_(header_->competingConsumers_)
+    , subscriberCount_(header_->subscriberCount_)
+    , overwrite_(header_->overwriteWhenFull_)
+    , conflate_(header_->conflateByKey_)
+    , entryCount_(header_->entryCount_)
+    , resolver_(header_)
+    , entryAccessor_(resolver_, header_->entries_, header_->entryCount_)
+    , resizable_(header_->maxEntryCount_ != 0)
+    , ringGeneration_(0)
+    , previousEntryAccessor_(entryAccessor_)
+    , ringFence_(0)
+    , sharedPool_(header_->memoryPool_ == 0 ? 0 : resolver_.resolve<HQMemoryBlockPool>(header_->memoryPool_))
+    , abandoned_(header_->abandonedPositions_ == 0 ? 0 : resolver_.resolve<HighQAbandonedPositions>(header_->abandonedPositions_))
+    , prefetchDistance_(header_->prefetchDistance_)
+    , readPositionInterval_(header_->readPositionInterval_)
+    , privateReadPosition_(*resolver_.resolve<Position>(header_->readPosition_))
+    , publishedReadPosition_(privateReadPosition_)
+    , readPosition_(readPositionInterval_ > 1
+        ? privateReadPosition_
+        : *resolver_.resolve<volatile Position>(header_->readPosition_))
+    , sharedReadPosition_(*resolver_.resolve<AtomicPosition>(header_->readPosition_))
+    , claimPosition_(*resolver_.resolve<AtomicPosition>(header_->claimPosition_))
+    , publishPosition_(*resolver_.resolve<AtomicPosition>(header_->publishPosition_))
+    , cachedPublishPosition_(publishPosition_)
+    , subscriberPositions_(subscriberCount_ == 0 ? 0 : resolver_.resolve<HighQSubscriberPosition>(header_->subscriberPositions_))
+    , subscriberPosition_(0)
+    , peekPosition_(0)
+    , peekError_(0)
+    , overrunStart_(0)
+    , overrunEnd_(0)
+    , laneCount_(header_->priorityLaneCount_)
+    , lanes_(laneCount_ == 0 ? 0 : resolver_.resolve<HighQPriorityLane>(header_->priorityLanes_))
+    , waitStrategy_(header_->consumerWaitStrategy_)
+    , waitBudget_(waitStrategy_)
+    , stopping_(false)
+    , statistics_(*resolver_.resolve<HighQStatistics>(header_->statistics_))
+    , privateStats_()
+    , stats_(statistics_.claim(HighQStatSlot::ConsumerOwner, privateStats_))
+    , statConsumed_(stats_.consumed_)
+    , statGets_(0)
+    , statTrys_(0)
+    , statBatches_(0)
+    , statCollisions_(0)
+    , statOverruns_(0)
+    , statPriority_(0)
+    , statSpins_(stats_.spins_)
+    , statYields_(stats_.yields_)
+    , statSleeps_(stats_.sleeps_)
+    , statWaits_(stats_.waits_)
+    {
+        try
+        {
+            Policy::verifyWait<WaitPolicy>(producerUsesMutex_, producerUsesFutex_);
+            if(resizable_)
+            {
+                if(EntryCountPolicy::powerOfTwo)
+                {
+                    header_->requirePowerOfTwoEntryCount();
+                }
+                useCurrentRing();
+            }
+            if(subscriberCount_ != 0)
+            {
+                auto subscriber = header_->subscribersAttached_++;
+                if(subscriber >= subscriberCount_)
+                {
+                    std::stringstream msg;
+                    msg << "All " << subscriberCount_ << " subscribers are already attached to HighQueue " << header_->name_;
+                    throw std::runtime_error(msg.str());
+                }
+                subscriberPosition_ = subscriberPositions_ + subscriber;
+                peekPosition_ = subscriberPosition_->position_;
+            }
+            if(competing_)
+            {
+                peekError_ = "Competing consumers cannot read messages in place.";
+            }
+            else if(sharedPool_)
+            {
+                // The Message in the entry holds the address of the pool in the publishing process.
+                peekError_ = "Messages in a shared memory HighQueue cannot be read in place.";
+            }
+            else if(header_->inlinePayloads_)
+            {
+                peekError_ = "Messages stored inline in the entries cannot be read in place.";
+            }
+            else if(overwrite_)
+            {
+                peekError_ = "Messages in a HighQueue that overwrites when full cannot be read in place.";
+            }
+            else if(conflate_)
+            {
+                peekError_ = "Messages in a conflating HighQueue cannot be read in place.";
+            }
+            else if(laneCount_ != 0)
+            {
+                peekError_ = "Messages in a HighQueue with priority lanes cannot be read in place.";
+            }
+            if(competing_ || subscriberCount_ != 0)
+            {
+                ++header_->consumersPresent_;
+                header_->consumerPresent_ = true;
+            }
+            else if(header_->consumerPresent_.exchange(true))
+            {
+                throw std::runtime_error("Only one consumer can be attached to a HighQueue.");
+            }
+        }
+        catch(...)
+        {
+            statistics_.release(stats_);
+            throw;
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    BasicConsumer<WaitPolicy, EntryCountPolicy>::~BasicConsumer()
+    {
+        catchUpReadPosition();
+        if(subscriberPosition_)
+        {
+            // Stop holding up the producers.
+            publishSubscriberPosition(HighQSubscriberPosition::Detached);
+        }
+        if((!competing_ && subscriberCount_ == 0) || --header_->consumersPresent_ == 0)
+        {
+            header_->consumerPresent_ = false;
+        }
+        statistics_.release(stats_);
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::stop()
+    {
+        stopping_ = true;
+        header_->consumerWaitConditionVariable_.notify_all();
+        header_->consumerFutex_.unparkAll();
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::incrementReadPosition()
+    {
+        if(readPositionInterval_ > 1)
+        {
+            Position readPosition = readPosition_;
+            // Tell the producers this entry is free.  The entry's cache line is already ours.
+            entryAt(readPosition).consumed_.store(readPosition, std::memory_order_release);
+            readPosition_ = ++readPosition;
+            if(readPosition - publishedReadPosition_ >= readPositionInterval_)
+            {
+                publishReadPosition();
+            }
+        }
+        else
+        {
+            ++readPosition_;
+        }
+        notifyProducer();
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::publishReadPosition()
+    {
+        publishedReadPosition_ = readPosition_;
+        sharedReadPosition_.store(publishedReadPosition_, std::memory_order_release);
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::catchUpReadPosition()
+    {
+        // Called when the consumer runs out of messages and might wait.
+        if(readPositionInterval_ > 1 && publishedReadPosition_ != readPosition_)
+        {
+            publishReadPosition();
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::notifyProducer()
+    {
+        if(producerUsesFutex())
+        {
+            header_->producerFutex_.unpark();
+            return;
+        }
+        if(!producerUsesMutex())
+        {
+            std::atomic_thread_fence(std::memory_order::memory_order_release);
+            return;
+        }
+        // Pairs with the producer announcing its wait.  Skip the mutex unless a producer is waiting.
+        std::atomic_thread_fence(std::memory_order::memory_order_seq_cst);
+        if(header_->producerWaiting_.load(std::memory_order::memory_order_relaxed))
+        {
+            std::unique_lock<std::mutex> guard(header_->waitMutex_);
+            if(header_->producerWaiting_)
+            {
+                header_->producerWaiting_ = false;
+                header_->producerWaitConditionVariable_.notify_all();
+            }
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::isPublished(Position position)
+    {
+        if(lockFreeProducers_)
+        {
+            // Producers may finish out of order so the publish position is not maintained.
+            // Each entry records when it is complete.
+            return entryAccessor_[position].sequence_.load(std::memory_order_acquire) == position
+                || takeAbandoned(position);
+        }
+        if(position < cachedPublishPosition_)
+        {
+            return true;
+        }
+        std::atomic_thread_fence(std::memory_order::memory_order_consume);
+        cachedPublishPosition_ = publishPosition_.load(std::memory_order_consume);
+        if(resizable_ && header_->ringGeneration_.load(std::memory_order_acquire) != ringGeneration_)
+        {
+            // The producers switched rings before publishing anything this consumer has not seen.
+            useCurrentRing();
+        }
+        return position < cachedPublishPosition_;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::takeAbandoned(Position position)
+    {
+        // A lock-free producer that stopped with no consumer attached left this Position for us to stamp.
+        // A single consumer has taken every earlier Position.  Others must wait until nobody needs the
+        // message the entry still holds, just as a producer would.
+        if(abandoned_ == 0
+            || ((competing_ || subscriberCount_ != 0)
+                && position >= sharedReadPosition_.load(std::memory_order_acquire) + entryCount_)
+            || !abandoned_->take(position))
+        {
+            return false;
+        }
+        HighQEntry & entry = entryAccessor_[position];
+        entry.status_ = HighQEntry::Status::SKIP;
+        entry.sequence_.store(position, std::memory_order_release);
+        return true;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::useCurrentRing()
+    {
+        ringGeneration_ = header_->ringGeneration_.load(std::memory_order_acquire);
+        const HighQRing & current = header_->rings_[ringGeneration_ % 2];
+        entryAccessor_ = HighQBasicEntryAccessor<EntryCountPolicy>(resolver_, current.entries_, current.entryCount_);
+        ringFence_ = current.start_;
+        if(ringGeneration_ != 0)
+        {
+            const HighQRing & previous = header_->rings_[(ringGeneration_ + 1) % 2];
+            previousEntryAccessor_ = HighQBasicEntryAccessor<EntryCountPolicy>(resolver_, previous.entries_, previous.entryCount_);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::takeEntry(HighQEntry & entry, Message & message)
+    {
+        if(entry.inlineUsed_ != 0)
+        {
+            // The payload is in the entry.  Copy it rather than swapping blocks.
+            message.setEmpty();
+            message.appendBinaryCopy(entry.inline_, entry.inlineUsed_);
+            entry.message_.copyMetaInfoTo(message);
+            return;
+        }
+        entry.message_.moveTo(message);
+        if(sharedPool_)
+        {
+            // The block may have been put into the entry by another process.
+            message.rebase(sharedPool_);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::prefetchAhead(Position position, bool withPayload)
+    {
+        // The entry prefetchDistance_ ahead is probably not in cache yet, so reading its message
+        // would stall.  Fetch its lines now, and the block of the entry halfway there, whose lines
+        // were fetched several entries ago.
+        prefetchEntry(position + prefetchDistance_, false);
+        if(withPayload)
+        {
+            prefetchEntry(position + (prefetchDistance_ + 1) / 2, true);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::prefetchEntry(Position position, bool withPayload)
+    {
+        const HighQEntry & entry = entryAt(position);
+        const byte_t * lines = reinterpret_cast<const byte_t *>(&entry);
+        if(!withPayload)
+        {
+            prefetchForRead(lines);
+            prefetchForRead(lines + CacheLineSize);
+            return;
+        }
+        // Only follow the message of an entry that has been published.  The producer may be filling the others.
+        bool published = lockFreeProducers_
+            ? entry.sequence_.load(std::memory_order_relaxed) == position
+            : position < cachedPublishPosition_;
+        if(!published || entry.inlineUsed_ != 0)
+        {
+            return;
+        }
+        const Message & message = entry.message_;
+        const byte_t * payload = (sharedPool_ ? reinterpret_cast<const byte_t *>(sharedPool_) : message.getContainer())
+            + message.getOffset();
+        size_t used = std::min(message.getUsed(), size_t(MaxPrefetchLines * CacheLineSize));
+        for(size_t offset = 0; offset < used; offset += CacheLineSize)
+        {
+            prefetchForRead(payload + offset);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::prefetchNext()
+    {
+        // The entry's message can't be followed without waiting for the entry.
+        // The gets prefetch blocks once the entries are on their way.
+        if(prefetchDistance_ != 0 && !competing_ && subscriberPosition_ == 0)
+        {
+            prefetchEntry(readPosition_, false);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::lockConflatedEntry(HighQEntry & entry, Position position)
+    {
+        // Keep producers from replacing the message while it is taken.
+        // If a producer is replacing it now, the wait is one message copy or swap.
+        Position expected = position;
+        while(!entry.sequence_.compare_exchange_weak(expected, HighQEntry::Writing, std::memory_order_acquire))
+        {
+            expected = position;
+            spinDelay();
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::tryGetFromLanes(Message & message)
+    {
+        for(size_t nLane = laneCount_; nLane-- > 0;)
+        {
+            HighQPriorityLane & lane = lanes_[nLane];
+            Position readPosition = lane.readPosition_.position_.load(std::memory_order_relaxed);
+            if(readPosition < lane.publishPosition_.position_.load(std::memory_order_acquire))
+            {
+                auto entries = resolver_.resolve<HighQEntry>(lane.entries_);
+                takeEntry(entries[readPosition % lane.entryCount_], message);
+                lane.readPosition_.position_.store(readPosition + 1, std::memory_order_release);
+                ++statConsumed_;
+                ++statPriority_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    template <typename TryFunction>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::waitFor(TryFunction tryFunction)
+    {
+        waitBudget_.start();
+        // With coalesced wakeups the consumer sleeps in short periods (WaitStrategy::parkPeriod())
+        // but still gives up after mutexWaitTimeout_.
+        auto parkPeriod = waitStrategy_.parkPeriod();
+        uint64_t parkedSince = 0;
+        while(!stopping_)
+        {
+            if(tryFunction())
+            {
+                waitBudget_.finish();
+                return true;
+            }
+            if(waitBudget_.spin())
+            {
+                ++statSpins_;
+                std::atomic_thread_fence(std::memory_order::memory_order_consume);
+            }
+            else if(waitBudget_.yield())
+            {
+                ++statYields_;
+                std::this_thread::yield();
+            }
+            else if(waitBudget_.sleep())
+            {
+                ++statSleeps_;
+                std::this_thread::sleep_for(waitStrategy_.sleepPeriod_);
+            }
+            else if(waitStrategy_.futexUsed_)
+            {
+                ++statWaits_;
+                auto expected = header_->consumerFutex_.prepareToPark();
+                if(tryFunction())
+                {
+                    waitBudget_.finish();
+                    return true;
+                }
+                if(parkedSince == 0)
+                {
+                    parkedSince = Stopwatch::now();
+                }
+                if(!stopping_ && !header_->consumerFutex_.park(expected, parkPeriod))
+                {
+                    if(tryFunction())
+                    {
+                        waitBudget_.finish();
+                        return true;
+                    }
+                    if(parkPeriod < waitStrategy_.mutexWaitTimeout_ && !waitTimedOut(parkedSince))
+                    {
+                        continue;
+                    }
+                    // todo: define a better exception
+                    throw std::runtime_error("Consumer wait timeout.");
+                }
+            }
+            else
+            {
+                ++statWaits_;
+                if(parkedSince == 0)
+                {
+                    parkedSince = Stopwatch::now();
+                }
+                std::unique_lock<std::mutex> guard(header_->waitMutex_);
+                // Announce the wait before the last look so a producer that misses the announcement
+                // published first.
+                header_->consumerWaiting_ = true;
+                if(tryFunction())
+                {
+                    waitBudget_.finish();
+                    return true;
+                }
+                if(header_->consumerWaitConditionVariable_.wait_for(guard, parkPeriod)
+                    == std::cv_status::timeout)
+                {
+                    if(tryFunction())
+                    {
+                        waitBudget_.finish();
+                        return true;
+                    }
+                    if(parkPeriod < waitStrategy_.mutexWaitTimeout_ && !waitTimedOut(parkedSince))
+                    {
+                        continue;
+                    }
+                    // todo: define a better exception
+                    throw std::runtime_error("Consumer wait timeout.");
+                }
+            }
+        }
+        return false;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::tryGetNext(Message & message)
+    {
+        if(subscriberPosition_)
+        {
+            return tryCopyNext(message);
+        }
+        ++statTrys_;
+        if(competing_)
+        {
+            return tryClaimNext(message);
+        }
+        if(laneCount_ != 0 && tryGetFromLanes(message))
+        {
+            return true;
+        }
+        if(overwrite_)
+        {
+            return tryCopyUnlessOverwritten(message, true);
+        }
+        while(true)
+        {
+            Position readPosition = readPosition_;
+            if(!isPublished(readPosition))
+            {
+                catchUpReadPosition();
+                return false;
+            }
+            HighQEntry & entry = entryAt(readPosition);
+            if(conflate_)
+            {
+                lockConflatedEntry(entry, readPosition);
+            }
+            if(prefetchDistance_ != 0)
+            {
+                prefetchAhead(readPosition, true);
+            }
+            if(entry.status_ == HighQEntry::Status::OK)
+            {
+                takeEntry(entry, message);
+                incrementReadPosition();
+                ++statConsumed_;
+                return true;
+            }
+            incrementReadPosition();
+        }
+
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicConsumer<WaitPolicy, EntryCountPolicy>::tryGetNextBatch(Message * messages, size_t limit)
+    {
+        ++statBatches_;
+        if(competing_)
+        {
+            return tryClaimNextBatch(messages, limit);
+        }
+        if(subscriberPosition_)
+        {
+            return tryCopyNextBatch(messages, limit);
+        }
+        if(laneCount_ != 0)
+        {
+            size_t count = 0;
+            while(count < limit && tryGetFromLanes(messages[count]))
+            {
+                ++count;
+            }
+            if(count != 0)
+            {
+                return count;
+            }
+        }
+        if(overwrite_)
+        {
+            return tryCopyUnlessOverwrittenBatch(messages, limit, true);
+        }
+        Position readPosition = readPosition_;
+        if(!isPublished(readPosition))
+        {
+            catchUpReadPosition();
+            return 0;
+        }
+        size_t count = 0;
+        while(count < limit && isPublished(readPosition))
+        {
+            HighQEntry & entry = entryAt(readPosition);
+            if(conflate_)
+            {
+                lockConflatedEntry(entry, readPosition);
+            }
+            if(prefetchDistance_ != 0)
+            {
+                // A batch takes entries faster than the entries ahead arrive, so following their
+                // messages would only move the stall.  The caller touches the blocks afterwards.
+                prefetchAhead(readPosition, false);
+            }
+            if(entry.status_ == HighQEntry::Status::OK)
+            {
+                Message & message = messages[count];
+                takeEntry(entry, message);
+                ++count;
+            }
+            if(readPositionInterval_ > 1)
+            {
+                entry.consumed_.store(readPosition, std::memory_order_release);
+            }
+            ++readPosition;
+        }
+        // Release all of the entries to the producer(s) at once.
+        readPosition_ = readPosition;
+        if(readPositionInterval_ > 1 && readPosition - publishedReadPosition_ >= readPositionInterval_)
+        {
+            publishReadPosition();
+        }
+        notifyProducer();
+        statConsumed_ += count;
+        return count;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::tryClaimNext(Message & message)
+    {
+        while(true)
+        {
+            Position position = claimPosition_;
+            if(!isPublished(position))
+            {
+                return false;
+            }
+            if(!claimPosition_.compare_exchange_weak(position, position + 1))
+            {
+                // Another consumer got there first.
+                ++statCollisions_;
+                continue;
+            }
+            HighQEntry & entry = entryAt(position);
+            bool consumed = entry.status_ == HighQEntry::Status::OK;
+            if(consumed)
+            {
+                takeEntry(entry, message);
+            }
+            releaseClaimed(position, position + 1);
+            if(consumed)
+            {
+                ++statConsumed_;
+                return true;
+            }
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicConsumer<WaitPolicy, EntryCountPolicy>::tryClaimNextBatch(Message * messages, size_t limit)
+    {
+        Position position = claimPosition_;
+        Position end = position;
+        while(true)
+        {
+            end = position;
+            while(end - position < limit && isPublished(end))
+            {
+                ++end;
+            }
+            if(end == position)
+            {
+                return 0;
+            }
+            if(claimPosition_.compare_exchange_weak(position, end))
+            {
+                break;
+            }
+            // Another consumer got there first.
+            ++statCollisions_;
+        }
+
+        size_t count = 0;
+        for(Position claimed = position; claimed < end; ++claimed)
+        {
+            HighQEntry & entry = entryAt(claimed);
+            if(entry.status_ == HighQEntry::Status::OK)
+            {
+                Message & message = messages[count];
+                takeEntry(entry, message);
+                ++count;
+            }
+        }
+        releaseClaimed(position, end);
+        statConsumed_ += count;
+        return count;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::releaseClaimed(Position position, Position end)
+    {
+        for(Position claimed = position; claimed < end; ++claimed)
+        {
+            entryAt(claimed).consumed_ = claimed;
+        }
+        // Consumers may finish out of order, but entries go back to the producers in order.
+        // Whoever finds the entry at the read position consumed moves the read position past it.
+        // This may be some other consumer's entry.
+        Position readPosition = sharedReadPosition_;
+        while(entryAt(readPosition).consumed_ == readPosition)
+        {
+            if(sharedReadPosition_.compare_exchange_strong(readPosition, readPosition + 1))
+            {
+                ++readPosition;
+            }
+        }
+        notifyProducer();
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    HighQEntry * BasicConsumer<WaitPolicy, EntryCountPolicy>::nextPublishedEntry()
+    {
+        while(isPublished(peekPosition_))
+        {
+            HighQEntry & entry = entryAt(peekPosition_);
+            ++peekPosition_;
+            if(entry.status_ == HighQEntry::Status::OK)
+            {
+                ++statConsumed_;
+                return &entry;
+            }
+        }
+        return 0;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    const Message * BasicConsumer<WaitPolicy, EntryCountPolicy>::tryPeekNext()
+    {
+        ++statTrys_;
+        if(peekError_)
+        {
+            throw std::runtime_error(peekError_);
+        }
+        if(!subscriberPosition_ && peekPosition_ < readPosition_)
+        {
+            // Nothing is outstanding.  Catch up with messages taken by the get methods.
+            peekPosition_ = readPosition_;
+        }
+        auto entry = nextPublishedEntry();
+        return entry == 0 ? 0 : &entry->message_;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    const Message * BasicConsumer<WaitPolicy, EntryCountPolicy>::peekNext()
+    {
+        ++statGets_;
+        const Message * message = 0;
+        waitFor([this, &message]()
+        {
+            message = BasicConsumer::tryPeekNext();
+            return message != 0;
+        });
+        return message;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::releasePeeked()
+    {
+        if(subscriberPosition_)
+        {
+            if(subscriberPosition_->position_ != peekPosition_)
+            {
+                publishSubscriberPosition(peekPosition_);
+            }
+        }
+        else if(readPosition_ < peekPosition_)
+        {
+            // Readers never write to the entries.  Only the read position changes.
+            if(readPositionInterval_ > 1)
+            {
+                readPosition_ = peekPosition_;
+                publishReadPosition();
+            }
+            else
+            {
+                sharedReadPosition_.store(peekPosition_, std::memory_order_release);
+            }
+            notifyProducer();
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::copyEntry(HighQEntry & entry, Message & message)
+    {
+        const byte_t * data = entry.message_.get();
+        size_t used = entry.message_.getUsed();
+        if(entry.inlineUsed_ != 0)
+        {
+            data = entry.inline_;
+            used = entry.inlineUsed_;
+        }
+        else if(sharedPool_)
+        {
+            // The Message in the entry holds the address of the pool in the publishing process.
+            data = reinterpret_cast<const byte_t *>(sharedPool_) + entry.message_.getOffset();
+        }
+        message.setEmpty();
+        if(used > message.available())
+        {
+            // Only possible if a producer is overwriting the entry.  The copy will be discarded.
+            used = message.available();
+        }
+        message.appendBinaryCopy(data, used);
+        entry.message_.copyMetaInfoTo(message);
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::tryCopyNext(Message & message)
+    {
+        ++statTrys_;
+        auto entry = nextPublishedEntry();
+        if(entry == 0)
+        {
+            return false;
+        }
+        copyEntry(*entry, message);
+        releasePeeked();
+        return true;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicConsumer<WaitPolicy, EntryCountPolicy>::tryCopyNextBatch(Message * messages, size_t limit)
+    {
+        size_t count = 0;
+        HighQEntry * entry = 0;
+        while(count < limit && (entry = nextPublishedEntry()) != 0)
+        {
+            copyEntry(*entry, messages[count]);
+            ++count;
+        }
+        // Release all of the entries to the producer(s) at once.
+        releasePeeked();
+        return count;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::tryCopyUnlessOverwritten(Message & message, bool mayOverrun)
+    {
+        while(true)
+        {
+            Position readPosition = readPosition_;
+            if(!isPublished(readPosition))
+            {
+                return false;
+            }
+            if(readPosition + entryCount_ < cachedPublishPosition_)
+            {
+                // Lapped.  This entry has certainly been overwritten.
+                if(!mayOverrun)
+                {
+                    return false;
+                }
+                skipOverwritten(readPosition);
+                continue;
+            }
+            HighQEntry & entry = entryAccessor_[readPosition];
+            if(entry.sequence_.load(std::memory_order_acquire) == readPosition)
+            {
+                bool copied = entry.status_ == HighQEntry::Status::OK;
+                if(copied)
+                {
+                    copyEntry(entry, message);
+                }
+                // If the stamp is unchanged no producer touched the entry while it was being copied.
+                std::atomic_thread_fence(std::memory_order::memory_order_acquire);
+                if(entry.sequence_.load(std::memory_order_relaxed) == readPosition)
+                {
+                    // The producers never wait for the consumer, so there is no need to notify them.
+                    readPosition_ = readPosition + 1;
+                    if(copied)
+                    {
+                        ++statConsumed_;
+                        return true;
+                    }
+                    continue;
+                }
+            }
+            if(!mayOverrun)
+            {
+                return false;
+            }
+            skipOverwritten(readPosition);
+        }
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicConsumer<WaitPolicy, EntryCountPolicy>::tryCopyUnlessOverwrittenBatch(Message * messages, size_t limit, bool mayOverrun)
+    {
+        // Only skip lost messages before the first one in the batch so a caller
+        // can tell that everything in the batch follows the overrun.
+        size_t count = 0;
+        while(count < limit && tryCopyUnlessOverwritten(messages[count], mayOverrun && count == 0))
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::skipOverwritten(Position position)
+    {
+        cachedPublishPosition_ = publishPosition_.load(std::memory_order_acquire);
+        // Entries older than this have been reused.  The entry at position is at least being rewritten.
+        Position end = cachedPublishPosition_ - entryCount_;
+        if(end <= position)
+        {
+            end = position + 1;
+        }
+        if(position != overrunEnd_)
+        {
+            overrunStart_ = position;
+        }
+        overrunEnd_ = end;
+        statOverruns_ += end - position;
+        readPosition_ = end;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    uint64_t BasicConsumer<WaitPolicy, EntryCountPolicy>::getOverruns() const
+    {
+        return statOverruns_;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::getLatestOverrun(Position & start, Position & end) const
+    {
+        start = overrunStart_;
+        end = overrunEnd_;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    void BasicConsumer<WaitPolicy, EntryCountPolicy>::publishSubscriberPosition(Position position)
+    {
+        Position previous = subscriberPosition_->position_;
+        subscriberPosition_->position_ = position;
+        // The read position is the slowest subscriber's position.  Only a subscriber
+        // that was at the read position can move it.  Detached subscribers do not count.
+        Position readPosition = sharedReadPosition_;
+        if(previous == readPosition)
+        {
+            Position slowest = HighQSubscriberPosition::Detached;
+            for(size_t nSubscriber = 0; nSubscriber < subscriberCount_; ++nSubscriber)
+            {
+                Position subscriber = subscriberPositions_[nSubscriber].position_;
+                if(subscriber < slowest)
+                {
+                    slowest = subscriber;
+                }
+            }
+            while(slowest != HighQSubscriberPosition::Detached && readPosition < slowest
+                && !sharedReadPosition_.compare_exchange_weak(readPosition, slowest))
+            {
+            }
+        }
+        notifyProducer();
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicConsumer<WaitPolicy, EntryCountPolicy>::getNextBatch(Message * messages, size_t limit)
+    {
+        if(limit == 0)
+        {
+            return 0;
+        }
+        size_t count = BasicConsumer::tryGetNextBatch(messages, limit);
+        if(count == 0 && BasicConsumer::getNext(messages[0]))
+        {
+            // getNext() did the waiting.  Pick up anything else that arrived with it.
+            if(overwrite_)
+            {
+                // Don't skip lost messages after the one getNext() found.
+                count = 1 + tryCopyUnlessOverwrittenBatch(messages + 1, limit - 1, false);
+            }
+            else
+            {
+                count = 1 + BasicConsumer::tryGetNextBatch(messages + 1, limit - 1);
+            }
+        }
+        return count;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    std::ostream & BasicConsumer<WaitPolicy, EntryCountPolicy>::writeStats(std::ostream & out)const
+    {
+        out << "Consumed: " << statConsumed_ << " Get: " << statGets_ << " Try: " << statTrys_ << " Batch: " << statBatches_ << " Collide: " << statCollisions_ << " Overrun: " << statOverruns_ << " Priority: " << statPriority_ << " Spin: " << statSpins_ << " Yield: " << statYields_ << " Sleep: " << statSleeps_ << " Wait: " << statWaits_;
+        return waitBudget_.writeStats(out) << std::endl;
+    }
+
+    template <typename WaitPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicConsumer<WaitPolicy, EntryCountPolicy>::getNext(Message & message)
+    {
+        ++statGets_;
+        return waitFor([this, &message]()
+        {
+            return BasicConsumer::tryGetNext(message);
+        });
+    }
+}
@@ -0,0 +1,1354 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/Connection.hpp>
+#include <HighQueue/Policies.hpp>
+#include <HighQueue/details/HQResolver.hpp>
+#include <HighQueue/details/HQReservePosition.hpp>
+#include <HighQueue/details/HQEntryAccessor.hpp>
+#include <HighQueue/details/HQConflationSlot.hpp>
+#include <HighQueue/details/HQAbandonedPositions.hpp>
+#include <HighQueue/details/HQPriorityLane.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
+#include <HighQueue/details/HQWaitBudget.hpp>
+
+namespace HighQueue
+{
+    /// @brief Support for publishing messages to an HighQueue
+    /// In addition to having the Connection which is used to construct
+    /// this object, you will need a Message which has been initialized
+    /// by calling the Connection::allocate() method.
+    ///
+    /// The policies fix some decisions at compile time so the per message code does not test them.
+    /// Producer uses the policies that take every decision from the HighQueue's configuration.
+    /// @tparam SoloPolicy ConfiguredSolo, Solo, or NotSolo
+    /// @tparam WaitPolicy how the consumer waits: ConfiguredWait, PollingWait, MutexWait, or FutexWait
+    /// @tparam DiscardPolicy ConfiguredDiscard, Discard, or NoDiscard
+    /// @tparam EntryCountPolicy AnyEntryCount or PowerOfTwoEntryCount
+    /// @throws runtime_error from the constructor if a fixed policy does not match the HighQueue.
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    class BasicProducer
+    {
+    public:
+        /// @brief Chooses the key for each message published to a conflating HighQueue.
+        typedef std::function<ConflationKey(const Message &)> KeyExtractor;
+
+        /// @brief Construct and attach to a connection
+        /// @param connection provides access to the HighQueue
+        /// @param solo indicates that this is the only producer.
+        ///        solo producers run faster using techniques that would be 
+        ///        unsafe with multiple producers.
+        explicit BasicProducer(ConnectionPtr & connection);
+
+        /// @brief Destructor
+        ~BasicProducer();
+            
+        /// @brief Publish the data contained in a message.
+        ///
+        /// If the visible window of the HighQueue is full this call
+        /// waits forever.  (todo: fix this!)
+        ///
+        /// If the HighQueue was created with lockFreeProducers_ and this is not
+        /// a solo producer, the entry is claimed with an atomic increment of the
+        /// reserve position so other producers can fill their entries at the same time.
+        ///
+        /// After this call the message will point to a different (unused)
+        /// area in memory.  You must call Message::get() to find this memory
+        /// area.  Do not save the result of a previous Message::get() call,
+        /// this call invalidates previous get() results.
+        ///
+        /// If the HighQueue was created with inlinePayloads_ and the message fits
+        /// in HighQEntry::InlineCapacity bytes, the data is copied into the entry
+        /// and the message keeps its (now empty) memory.
+        ///
+        /// If the HighQueue was created with overwriteWhenFull_ this call never waits.
+        /// A full HighQueue overwrites its oldest entry.  The data is copied into the
+        /// entry's own memory and the message keeps its (now empty) memory.
+        ///
+        /// If the HighQueue was created with conflateByKey_ the key extractor chooses
+        /// the message's key.  See publish(Message &, ConflationKey).  Without a key
+        /// extractor this throws runtime_error.
+        ///
+        /// If the HighQueue was created with priorityLanes_ the message's type chooses
+        /// its lane.  See setLane().
+        ///
+        /// @param message contains the data to be published.         
+        void publish(Message & message);
+
+        /// @brief Publish the data contained in an array of messages.
+        ///
+        /// The messages are published in order.  As many entries as the
+        /// HighQueue has available are reserved and published together and
+        /// the consumer is notified once, rather than once per message.
+        /// If the HighQueue cannot hold all of the messages this call waits
+        /// for the consumer to make room then publishes the rest.
+        ///
+        /// As with publish(Message &), after this call each message will point
+        /// to a different (unused) area in memory.
+        ///
+        /// Messages bound for a priority lane are published as they are reached
+        /// and the messages between them are published in batches.
+        ///
+        /// @param messages points to the first message to be published. See MessageArray.
+        /// @param count is the number of messages to publish.
+        void publish(Message * messages, size_t count);
+
+        /// @brief Publish to a conflating HighQueue (CreationParameters::conflateByKey_).
+        ///
+        /// If a message with the same key has been published but not yet consumed it
+        /// is replaced in place, keeping its place in the HighQueue.  Otherwise the
+        /// message is published normally.  So is a message whose key finds no room
+        /// within HighQConflationSlot::MaxProbe slots of its home slot.
+        ///
+        /// @param message contains the data to be published.
+        /// @param key identifies messages that supersede each other.
+        /// @throws runtime_error if the HighQueue does not conflate.
+        void publish(Message & message, ConflationKey key);
+
+        /// @brief Choose how publish(Message &) finds the key in a conflating HighQueue.
+        /// There is no default: a conflating HighQueue needs either a key extractor or an explicit key.
+        void setKeyExtractor(const KeyExtractor & extractor);
+
+        /// @brief Publish to a priority lane (CreationParameters::priorityLanes_).
+        ///
+        /// The consumer reads higher lanes first, so the message goes ahead of everything
+        /// waiting in lower lanes.  If the lane is full this call polls until the consumer
+        /// makes room.
+        ///
+        /// @param message contains the data to be published.
+        /// @param lane from 1 to the number of lanes.  Lane 0 is the HighQueue's own entries.
+        /// @throws runtime_error if there is no such lane.
+        void publishToLane(Message & message, size_t lane);
+
+        /// @brief Choose the lane publish() uses for messages of this type.
+        /// By default Shutdown and Heartbeat messages use the highest lane and all others use lane 0.
+        /// @throws runtime_error if there is no such lane.
+        void setLane(Message::MessageType type, size_t lane);
+
+        /// @brief How many priority lanes the HighQueue has in addition to its own entries.
+        size_t getLaneCount() const
+        {
+            return laneCount_;
+        }
+
+        /// @brief Claim the next entry so a message can be built directly in the HighQueue.
+        ///
+        /// The returned message is the entry's own message, emptied and ready to be filled.
+        /// Fill it (including the type and timestamp) and then call commit().  No Message
+        /// of the producer's own is needed and no memory blocks are swapped.
+        ///
+        /// Only one claim may be outstanding at a time.  Consumers wait for a claimed
+        /// entry, so commit() should follow promptly.  Unless this is a solo producer or the
+        /// HighQueue was created with lockFreeProducers_, other producers also wait until commit().
+        ///
+        /// If the HighQueue is full this call waits like publish().
+        /// Claimed messages are never conflated and always use lane 0.
+        /// @returns the message to fill, or nullptr if the producer is stopping.
+        Message * claim();
+
+        /// @brief Publish the message returned by claim().
+        /// @throws runtime_error if there is no outstanding claim.
+        void commit();
+
+        /// @brief Give up the entry returned by claim() without publishing anything.
+        /// The entry is stamped SKIP so consumers pass over it.
+        /// @throws runtime_error if there is no outstanding claim.
+        void abandonClaim();
+
+        /// @brief Do other producers wait while a claim is outstanding?
+        bool claimBlocksProducers() const
+        {
+            return !isSolo() && !lockFree_;
+        }
+
+        /// @brief Cancel the outstanding publish and stop publishing
+        void stop();
+
+        /// @brief for diagnosing and performance measurements, dump statistics
+        std::ostream & writeStats(std::ostream & out)const;
+    private:
+        Position reserve();
+        bool unreserve(Position position);
+        void abandon(Position position, Position end);
+        bool canPublish(Position position, bool ownsPosition = true);
+        bool isConsumed(Position position);
+        void useCurrentRing();
+        void switchRing(Position position);
+
+        bool waitToPublish(Position reserved);
+        void publishToQueue(Message & message);
+        void publishToQueue(Message * messages, size_t count);
+        bool publish(Position reserved, Message & message);
+        void fillEntry(HighQEntry & entry, Message & message);
+        size_t publishBatch(Position position, Message * messages, size_t count);
+        void notifyConsumer(bool urgent = false);
+        bool wakeDue();
+        void markWriting(HighQEntry & entry);
+        size_t conflationHome(ConflationKey key) const;
+        HighQConflationSlot * findConflationSlot(ConflationKey key);
+        void deleteConflationSlot(size_t slot);
+
+        size_t laneFor(Message::MessageType type) const
+        {
+            size_t index = size_t(type);
+            return index < laneForType_.size() ? laneForType_[index] : 0;
+        }
+
+        bool isSolo() const
+        {
+            return Policy::choose<SoloPolicy>(solo_);
+        }
+        bool consumerUsesMutex() const
+        {
+            return WaitPolicy::fixed ? WaitPolicy::mutex : consumerUsesMutex_;
+        }
+        bool consumerUsesFutex() const
+        {
+            return WaitPolicy::fixed ? WaitPolicy::futex : consumerUsesFutex_;
+        }
+        bool discards() const
+        {
+            return Policy::choose<DiscardPolicy>(discardMessagesIfNoConsumer_);
+        }
+    private:
+        ConnectionPtr connection_;
+        bool solo_;
+        bool stopping_;
+        HQHeader * header_;
+        size_t entryCount_;
+        WaitStrategy waitStrategy_;
+        bool consumerUsesMutex_;
+        bool consumerUsesFutex_;
+        /// @brief Wake the consumer after this many messages (see WaitStrategy::coalesceWakeups)
+        size_t wakeCount_;
+        /// @brief ... or when the oldest message it has not been woken for is this many nanoseconds old.
+        uint64_t wakeLatency_;
+        size_t wakesPending_;
+        uint64_t wakePendingSince_;
+        bool discardMessagesIfNoConsumer_;
+        bool lockFree_;
+        bool inlinePayloads_;
+        bool overwrite_;
+        bool conflate_;
+        bool resizable_;
+        uint32_t ringGeneration_;
+        /// @brief See CreationParameters::readPositionInterval_
+        size_t readPositionInterval_;
+
+        HighQResolver resolver_;
+        volatile Position & readPosition_;
+        AtomicPosition & publishPosition_;
+        volatile HighQReservePosition & reserveStructure_;
+        volatile AtomicPosition & reservePosition_;
+        volatile Position & reserveSoloPosition_;
+        SpinLock & reserveSpinLock_;
+        HighQBasicEntryAccessor<EntryCountPolicy> entryAccessor_;
+        HQMemoryBlockPool * sharedPool_;
+        HighQAbandonedPositions * abandoned_;
+        HighQConflationSlot * conflationSlots_;
+        size_t conflationMask_;
+        KeyExtractor keyExtractor_;
+        size_t laneCount_;
+        HighQPriorityLane * lanes_;
+        std::vector<uint8_t> laneForType_;
+
+        Position publishable_;
+        HighQWaitBudget waitBudget_;
+
+        bool claimed_;
+        Position claimPosition_;
+        SpinLock::Guard claimGuard_;
+
+        /// @brief The counters that tools such as hqstat can read while the HighQueue runs.
+        /// privateStats_ is used if all the HighQueue's slots are taken.
+        HighQStatistics & statistics_;
+        HighQStatRecord privateStats_;
+        HighQStatRecord & stats_;
+
+        HighQStatCounter & statFulls_;
+        uint64_t statOverwrites_;
+        uint64_t statConflations_;
+        uint64_t statDiscards_;
+        uint64_t statSkips_;
+        uint64_t statPublishWaits_;
+        uint64_t statPublishInLine_;
+        HighQStatCounter & statPublishes_;
+        uint64_t statBatches_;
+        uint64_t statInlines_;
+        uint64_t statClaims_;
+        uint64_t statPriority_;
+        uint64_t statResizes_;
+        uint64_t statWakes_;
+        HighQStatCounter & statSpins_;
+        HighQStatCounter & statYields_;
+        HighQStatCounter & statSleeps_;
+        HighQStatCounter & statWaits_;
+
+
+    };
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::BasicProducer(ConnectionPtr & connection)
+    : connection_(connection)
+    , solo_(Policy::choose<SoloPolicy>(connection_->canSolo()))
+    , stopping_(false)
+    , header_(connection_->getHeader())
+    , entryCount_(header_->entryCount_)
+    , waitStrategy_(header_->producerWaitStrategy_)
+    , consumerUsesMutex_(header_->consumerWaitStrategy_.mutexUsed_)
+    , consumerUsesFutex_(header_->consumerWaitStrategy_.futexUsed_)
+    , wakeCount_(header_->consumerWaitStrategy_.coalesced() ? header_->consumerWaitStrategy_.wakeCount_ : 1)
+    , wakeLatency_(uint64_t(header_->consumerWaitStrategy_.wakeLatency_.count()))
+    , wakesPending_(0)
+    , wakePendingSince_(0)
+    , discardMessagesIfNoConsumer_(header_->discardMessagesIfNoConsumer_)
+    , lockFree_(!solo_ && header_->lockFreeProducers_ && !discardMessagesIfNoConsumer_
+        && !header_->overwriteWhenFull_ && !header_->conflateByKey_)
+    , inlinePayloads_(header_->inlinePayloads_)
+    , overwrite_(header_->overwriteWhenFull_)
+    , conflate_(header_->conflateByKey_)
+    , resizable_(header_->maxEntryCount_ != 0)
+    , ringGeneration_(0)
+    , readPositionInterval_(header_->readPositionInterval_)
+    , resolver_(header_)
+    , readPosition_(*resolver_.resolve<volatile Position>(header_->readPosition_))
+    , publishPosition_(*resolver_.resolve<AtomicPosition>(header_->publishPosition_))
+    , reserveStructure_(*resolver_.resolve<volatile HighQReservePosition>(header_->reservePosition_))
+    , reservePosition_(reserveStructure_.reservePosition_)
+    , reserveSoloPosition_(reinterpret_cast<volatile Position &>(reservePosition_))
+    , reserveSpinLock_(const_cast<SpinLock &>(reserveStructure_.reserveSpinLock_))
+    , entryAccessor_(resolver_, header_->entries_, header_->entryCount_)
+    , sharedPool_(header_->memoryPool_ == 0 ? 0 : resolver_.resolve<HQMemoryBlockPool>(header_->memoryPool_))
+    , abandoned_(header_->abandonedPositions_ == 0 ? 0 : resolver_.resolve<HighQAbandonedPositions>(header_->abandonedPositions_))
+    , conflationSlots_(conflate_ ? resolver_.resolve<HighQConflationSlot>(header_->conflationSlots_) : 0)
+    , conflationMask_(header_->conflationSlotCount_ - 1)
+    , laneCount_(header_->priorityLaneCount_)
+    , lanes_(laneCount_ == 0 ? 0 : resolver_.resolve<HighQPriorityLane>(header_->priorityLanes_))
+    , laneForType_(size_t(Message::MessageType::ExtraTypeBase), 0)
+    , publishable_(0)
+    , waitBudget_(waitStrategy_)
+    , claimed_(false)
+    , claimPosition_(0)
+    , statistics_(*resolver_.resolve<HighQStatistics>(header_->statistics_))
+    , privateStats_()
+    , stats_(statistics_.claim(HighQStatSlot::ProducerOwner, privateStats_))
+    , statFulls_(stats_.fulls_)
+    , statOverwrites_(0)
+    , statConflations_(0)
+    , statSkips_(0)
+    , statPublishWaits_(0)
+    , statPublishInLine_(0)
+    , statPublishes_(stats_.publishes_)
+    , statBatches_(0)
+    , statInlines_(0)
+    , statClaims_(0)
+    , statPriority_(0)
+    , statResizes_(0)
+    , statWakes_(0)
+    , statSpins_(stats_.spins_)
+    , statYields_(stats_.yields_)
+    , statSleeps_(stats_.sleeps_)
+    , statWaits_(stats_.waits_)
+    {
+        try
+        {
+            if(SoloPolicy::fixed && SoloPolicy::value && !connection_->canSolo())
+            {
+                throw std::runtime_error("Solo producer policy requires a Connection that can solo.");
+            }
+            Policy::verifyWait<WaitPolicy>(consumerUsesMutex_, consumerUsesFutex_);
+            Policy::verify<DiscardPolicy>(discardMessagesIfNoConsumer_, "discardMessagesIfNoConsumer");
+            if(laneCount_ != 0)
+            {
+                // Control messages should not wait behind queued data.
+                laneForType_[size_t(Message::MessageType::Shutdown)] = uint8_t(laneCount_);
+                laneForType_[size_t(Message::MessageType::Heartbeat)] = uint8_t(laneCount_);
+            }
+            if(resizable_)
+            {
+                if(EntryCountPolicy::powerOfTwo)
+                {
+                    header_->requirePowerOfTwoEntryCount();
+                }
+                useCurrentRing();
+            }
+        }
+        catch(...)
+        {
+            statistics_.release(stats_);
+            throw;
+        }
+        ++header_->producersPresent_;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::~BasicProducer()
+    {
+        --header_->producersPresent_;
+        statistics_.release(stats_);
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::unreserve(Position reserve)
+    {
+        if(isSolo())
+        {
+            reserveSoloPosition_ = reserve;
+            publishPosition_ = reserve;
+            return true;
+        }
+        // Other producers may already hold later Positions, so a lock-free reservation can't be undone.
+        // The caller gives its Positions up with abandon().
+        return true;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::abandon(Position position, Position end)
+    {
+        // Lock-free: [position, end) were reserved but will not be filled.  The consumer reads in order,
+        // so stamp each one SKIP to let it move on.  An entry still holding an unread message is stamped once
+        // the consumer has taken it.  With no consumer attached the rest are left for the consumer that
+        // attaches later to stamp.  See HighQAbandonedPositions.
+        for(; position < end; ++position)
+        {
+            while(!canPublish(position, false))
+            {
+                if(!header_->consumerPresent_ && abandoned_ != 0 && abandoned_->record(position, end))
+                {
+                    statSkips_ += end - position;
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            HighQEntry & entry = entryAccessor_[position];
+            entry.status_ = HighQEntry::Status::SKIP;
+            entry.sequence_.store(position, std::memory_order_release);
+            ++statSkips_;
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::canPublish(Position position, bool ownsPosition)
+    {
+        if(resizable_ && !isSolo() && header_->ringGeneration_.load(std::memory_order_acquire) != ringGeneration_)
+        {
+            // Another producer switched to a resized ring.
+            useCurrentRing();
+        }
+        if(publishable_ > position)
+        {
+            return true;
+        }
+        if(resizable_ && ownsPosition && header_->resizeState_.load(std::memory_order_acquire) == HQHeader::ResizeReady)
+        {
+            switchRing(position);
+        }
+        if(readPositionInterval_ > 1 && isConsumed(position + readPositionInterval_ - 1))
+        {
+            // The consumer has not published its read position, but it has taken the entries
+            // this producer needs next.  Skip reading the consumer's cache line.
+            publishable_ = position + readPositionInterval_;
+            return true;
+        }
+        Position readPosition = readPosition_;
+        publishable_ = readPosition + entryCount_;
+        statistics_.recordDepth(position - readPosition);
+        if(publishable_ > position)
+        {
+            return true;
+        }
+        if(readPositionInterval_ > 1 && isConsumed(position))
+        {
+            publishable_ = position + 1;
+            return true;
+        }
+        if(overwrite_)
+        {
+            // Reuse the oldest entry whether or not it has been read.
+            ++statOverwrites_;
+            publishable_ = position + 1;
+            return true;
+        }
+        ++statFulls_;
+        if(discards() && !header_->consumerPresent_)
+        {
+            ++statDiscards_;
+            readPosition_ = publishPosition_.load(std::memory_order_consume);
+            publishable_ = readPosition_ + entryCount_;
+            return true;
+        }
+        return false;
+    }
+
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::isConsumed(Position position)
+    {
+        // True if the consumer has taken the Position that last used this entry.
+        // The consumer reads in order, so every earlier entry is free, too.
+        return entryAccessor_[position].consumed_.load(std::memory_order_acquire) + entryCount_ == position;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::useCurrentRing()
+    {
+        ringGeneration_ = header_->ringGeneration_.load(std::memory_order_acquire);
+        const HighQRing & ring = header_->rings_[ringGeneration_ % 2];
+        entryAccessor_ = HighQBasicEntryAccessor<EntryCountPolicy>(resolver_, ring.entries_, ring.entryCount_);
+        entryCount_ = ring.entryCount_;
+        publishable_ = 0;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::switchRing(Position position)
+    {
+        // Solo or protected by the spin lock, and position is the next to be published.
+        // It becomes the first Position in the resized ring.
+        uint32_t generation = ringGeneration_ + 1;
+        HighQRing & ring = header_->rings_[generation % 2];
+        ring.start_ = position;
+        header_->entries_ = ring.entries_;
+        header_->entryCount_ = ring.entryCount_;
+        header_->ringGeneration_.store(generation, std::memory_order_release);
+        header_->resizeState_.store(HQHeader::ResizeIdle, std::memory_order_release);
+        ++statResizes_;
+        useCurrentRing();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::waitToPublish(Position position)
+    {
+        waitBudget_.start();
+        // Without the spin lock the position may be stale.  Only a solo producer may switch rings here.
+        while(!canPublish(position, isSolo()))
+        {
+            if(stopping_ && unreserve(position))
+            {
+                return false;
+            }
+
+            if(waitBudget_.spin())
+            {
+                spinDelay();
+                ++statSpins_;
+                std::atomic_thread_fence(std::memory_order::memory_order_consume);
+            }
+            else if(waitBudget_.yield())
+            {
+                ++statYields_;
+                std::this_thread::yield();
+            }
+            else if(waitBudget_.sleep())
+            {
+                ++statSleeps_;
+                std::this_thread::sleep_for(waitStrategy_.sleepPeriod_);
+            }
+            else if(waitStrategy_.futexUsed_)
+            {
+                ++statWaits_;
+                auto expected = header_->producerFutex_.prepareToPark();
+                publishable_ = readPosition_ + entryCount_;
+                if(publishable_ <= position && !stopping_
+                    && !header_->producerFutex_.park(expected, waitStrategy_.mutexWaitTimeout_))
+                {
+                    publishable_ = readPosition_ + entryCount_;
+                    if(publishable_ <= position)
+                    {
+                        // todo: define a better exception
+                        throw std::runtime_error("Producer wait timeout.");
+                    }
+                }
+            }
+            else
+            {
+                ++statWaits_;
+                std::unique_lock<std::mutex> guard(header_->waitMutex_);
+                // Announce the wait before the last look so a consumer that misses the announcement
+                // made its room visible first.
+                header_->producerWaiting_ = true;
+                publishable_ = readPosition_ + entryCount_;
+                if(publishable_ <= position)
+                {
+                    if(header_->producerWaitConditionVariable_.wait_for(guard, waitStrategy_.mutexWaitTimeout_)
+                        == std::cv_status::timeout)
+                    {
+                        publishable_ = readPosition_ + entryCount_;
+                        if(publishable_ <= position)
+                        {
+                            // todo: define a better exception
+                            throw std::runtime_error("Producer wait timeout.");
+                        }
+                    }
+                }
+            }
+            publishable_ = readPosition_ + entryCount_;
+        }
+        waitBudget_.finish();
+        return true;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publish(Position reserved, Message & message)
+    {
+        HighQEntry & entry = entryAccessor_[reserved];
+        if(overwrite_)
+        {
+            markWriting(entry);
+        }
+        if(entry.status_ != HighQEntry::Status::SKIP)
+        {
+            fillEntry(entry, message);
+            entry.sequence_.store(reserved, std::memory_order_release);
+            return true;
+        }
+        // Stamp skipped entries too so a consumer checking sequence_ will move past them.
+        entry.sequence_.store(reserved, std::memory_order_release);
+        ++statSkips_;
+        return false;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::fillEntry(HighQEntry & entry, Message & message)
+    {
+        size_t used = message.getUsed();
+        if(inlinePayloads_ && used != 0 && used <= HighQEntry::InlineCapacity)
+        {
+            // Small enough to copy.  The message keeps its block.
+            std::memcpy(entry.inline_, message.get(), used);
+            entry.inlineUsed_ = uint8_t(used);
+            message.copyMetaInfoTo(entry.message_);
+            message.setEmpty();
+            ++statInlines_;
+        }
+        else if(overwrite_)
+        {
+            // The consumer copies entries while they may be overwritten, so an entry must keep its own block.
+            // Swapping would change the block the consumer is copying from (possibly to one in another pool.)
+            entry.inlineUsed_ = 0;
+            if(sharedPool_)
+            {
+                // The entry's Message may hold the address of the pool in another process.
+                entry.message_.rebase(sharedPool_);
+            }
+            entry.message_.setEmpty();
+            entry.message_.appendBinaryCopy(message.get(), used);
+            message.copyMetaInfoTo(entry.message_);
+            message.setEmpty();
+        }
+        else
+        {
+            entry.inlineUsed_ = 0;
+            message.moveTo(entry.message_);
+            if(sharedPool_)
+            {
+                // The block we got back may have been put into the entry by another process.
+                message.rebase(sharedPool_);
+            }
+        }
+        entry.status_ = HighQEntry::Status::OK;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::markWriting(HighQEntry & entry)
+    {
+        // The consumer may be copying this entry.  Let it know the contents are about to change.
+        entry.sequence_.store(HighQEntry::Writing, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order::memory_order_release);
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::notifyConsumer(bool urgent)
+    {
+        bool futex = consumerUsesFutex();
+        if(!futex && !consumerUsesMutex())
+        {
+            std::atomic_thread_fence(std::memory_order::memory_order_release);
+            return;
+        }
+
+        // Pairs with the consumer announcing that it is about to sleep: either we see the announcement
+        // or the consumer sees what we published.  Nobody asleep means no mutex and no system call.
+        std::atomic_thread_fence(std::memory_order::memory_order_seq_cst);
+        bool sleeping = futex
+            ? header_->consumerFutex_.mayBeParked()
+            : header_->consumerWaiting_.load(std::memory_order::memory_order_relaxed);
+        if(!sleeping)
+        {
+            wakesPending_ = 0;
+            return;
+        }
+        if(wakeCount_ > 1 && !urgent && !wakeDue())
+        {
+            return;
+        }
+
+        ++statWakes_;
+        if(futex)
+        {
+            header_->consumerFutex_.unpark();
+            return;
+        }
+        std::unique_lock<std::mutex> guard(header_->waitMutex_);
+        if(header_->consumerWaiting_)
+        {
+            header_->consumerWaiting_ = false;
+            header_->consumerWaitConditionVariable_.notify_all();
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    bool BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::wakeDue()
+    {
+        if(++wakesPending_ >= wakeCount_)
+        {
+            wakesPending_ = 0;
+            return true;
+        }
+        if(wakeLatency_ != 0)
+        {
+            // The clock is only read while the consumer sleeps.
+            auto now = Stopwatch::now();
+            if(wakesPending_ == 1)
+            {
+                wakePendingSince_ = now;
+            }
+            else if(now - wakePendingSince_ >= wakeLatency_)
+            {
+                wakesPending_ = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publish(Message & message)
+    {
+        if(laneCount_ != 0)
+        {
+            size_t lane = laneFor(message.getType());
+            if(lane != 0)
+            {
+                publishToLane(message, lane);
+                return;
+            }
+        }
+        publishToQueue(message);
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publishToQueue(Message & message)
+    {
+        if(conflate_)
+        {
+            if(!keyExtractor_)
+            {
+                throw std::runtime_error("Producer: a conflating HighQueue needs a key.  Use publish(Message &, ConflationKey) or setKeyExtractor().");
+            }
+            publish(message, keyExtractor_(message));
+            return;
+        }
+        ++statPublishes_;
+        if(isSolo())
+        {
+            bool published = false;
+            while(!published && !stopping_)
+            {
+                Position position = publishPosition_; // solo: atomic not needed
+                if(canPublish(position))
+                {
+                    published = publish(position, message);
+                    publishPosition_.store(position + 1, std::memory_order_release);
+                }
+                else
+                {
+                    waitToPublish(position);
+                }
+            }
+            notifyConsumer();
+            return;
+        }
+
+        if(lockFree_)
+        {
+            bool published = false;
+            while(!published)
+            {
+                Position position = reservePosition_.fetch_add(1, std::memory_order_relaxed);
+                if(!canPublish(position) && !waitToPublish(position))
+                {
+                    // stopping.
+                    abandon(position, position + 1);
+                    notifyConsumer();
+                    return;
+                }
+                published = publish(position, message);
+            }
+            notifyConsumer();
+            return;
+        }
+
+        auto mutexTimedOut = false;
+        auto published = false;
+        waitBudget_.start();
+        SpinLock::Guard guard(reserveSpinLock_);
+        while(!published)
+        {
+            Position position = publishPosition_; // protected by spin lock.   Atomic not needed
+            if(canPublish(position))
+            {
+                published = publish(position, message);
+                publishPosition_ .store(position + 1, std::memory_order_release);
+            }
+            else
+            {
+                SpinLock::Unguard unguard(guard);
+                if(stopping_ )
+                {
+                    return;
+                }
+
+                if(waitBudget_.spin())
+                {
+                    spinDelay();
+                    ++statSpins_;
+                    std::atomic_thread_fence(std::memory_order::memory_order_consume);
+                }
+                else if(waitBudget_.yield())
+                {
+                    ++statYields_;
+                    std::this_thread::yield();
+                }
+                else if(waitBudget_.sleep())
+                {
+                    ++statSleeps_;
+                    std::this_thread::sleep_for(waitStrategy_.sleepPeriod_);
+                }
+                else if(waitStrategy_.futexUsed_ && !mutexTimedOut)
+                {
+                    ++statWaits_;
+                    auto expected = header_->producerFutex_.prepareToPark();
+                    // This position was acquired without the spinlock.
+                    // Check it, but don't use it to publish!
+                    position = publishPosition_;
+                    if(!canPublish(position, false) && !stopping_)
+                    {
+                        mutexTimedOut = !header_->producerFutex_.park(expected, waitStrategy_.mutexWaitTimeout_);
+                    }
+                }
+                else if(!waitStrategy_.futexUsed_ && !mutexTimedOut)
+                {
+                    ++statWaits_;
+                    std::unique_lock<std::mutex> mutexGuard(header_->waitMutex_);
+                    // This position was acquired without the spinlock. 
+                    // Check it, but don't use it to publish!
+                    position = publishPosition_; // Mutex protected.  Atomic not needed
+                    header_->producerWaiting_ = true;
+                    if(!canPublish(position, false))
+                    {
+                        mutexTimedOut = (header_->producerWaitConditionVariable_.wait_for(mutexGuard, waitStrategy_.mutexWaitTimeout_)
+                            == std::cv_status::timeout);
+                    }
+                }
+                else
+                {
+                    // todo: define a better exception
+                    throw std::runtime_error("Producer wait timeout.");
+                }
+            }
+        }
+        waitBudget_.finish();
+        notifyConsumer();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publish(Message * messages, size_t count)
+    {
+        if(laneCount_ == 0)
+        {
+            publishToQueue(messages, count);
+            return;
+        }
+        size_t start = 0;
+        for(size_t nMessage = 0; nMessage < count; ++nMessage)
+        {
+            size_t lane = laneFor(messages[nMessage].getType());
+            if(lane != 0)
+            {
+                if(start < nMessage)
+                {
+                    publishToQueue(messages + start, nMessage - start);
+                }
+                publishToLane(messages[nMessage], lane);
+                start = nMessage + 1;
+            }
+        }
+        if(start < count)
+        {
+            publishToQueue(messages + start, count - start);
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publishToQueue(Message * messages, size_t count)
+    {
+        if(conflate_)
+        {
+            // Each message has to be checked against the messages already in the HighQueue.
+            ++statBatches_;
+            for(size_t nMessage = 0; nMessage < count; ++nMessage)
+            {
+                publishToQueue(messages[nMessage]);
+            }
+            return;
+        }
+        statPublishes_ += count;
+        ++statBatches_;
+        size_t published = 0;
+        if(isSolo())
+        {
+            while(published < count && !stopping_)
+            {
+                Position position = publishPosition_; // solo: atomic not needed
+                if(canPublish(position))
+                {
+                    published += publishBatch(position, messages + published, count - published);
+                }
+                else
+                {
+                    waitToPublish(position);
+                }
+            }
+            notifyConsumer();
+            return;
+        }
+
+        if(lockFree_)
+        {
+            while(published < count)
+            {
+                // Claim the rest of the batch at once.
+                size_t claimed = count - published;
+                Position position = reservePosition_.fetch_add(claimed, std::memory_order_relaxed);
+                Position end = position + claimed;
+                for(; position < end; ++position)
+                {
+                    if(!canPublish(position) && !waitToPublish(position))
+                    {
+                        // stopping.  Give up the rest of the batch.
+                        abandon(position, end);
+                        notifyConsumer();
+                        return;
+                    }
+                    if(publish(position, messages[published]))
+                    {
+                        ++published;
+                    }
+                }
+            }
+            notifyConsumer();
+            return;
+        }
+
+        SpinLock::Guard guard(reserveSpinLock_);
+        while(published < count)
+        {
+            Position position = publishPosition_; // protected by spin lock.   Atomic not needed
+            if(canPublish(position))
+            {
+                published += publishBatch(position, messages + published, count - published);
+            }
+            else
+            {
+                SpinLock::Unguard unguard(guard);
+                if(stopping_)
+                {
+                    return;
+                }
+                // Note position may be stale by the time the wait ends, so it is
+                // only used to decide when to try again.
+                waitToPublish(position);
+            }
+        }
+        notifyConsumer();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publish(Message & message, ConflationKey key)
+    {
+        if(!conflate_)
+        {
+            throw std::runtime_error("Producer: keyed publish requires a HighQueue created with conflateByKey_.");
+        }
+        ++statPublishes_;
+        SpinLock::Guard guard;
+        if(!isSolo())
+        {
+            // The spin lock protects the conflation slots as well as the publish position.
+            guard = SpinLock::Guard(reserveSpinLock_);
+        }
+        while(!stopping_)
+        {
+            HighQConflationSlot * slot = findConflationSlot(key);
+            if(slot != 0 && slot->position_ != HighQConflationSlot::Unused)
+            {
+                Position position = slot->position_;
+                // The previous message for this key has not been consumed.
+                // Replace it unless the consumer is taking it right now.
+                Position expected = position;
+                if(entryAccessor_[position].sequence_.compare_exchange_strong(expected, HighQEntry::Writing, std::memory_order_acquire))
+                {
+                    publish(position, message); // restores the stamp
+                    ++statConflations_;
+                    return;
+                }
+            }
+            Position position = publishPosition_; // solo or protected by spin lock.  Atomic not needed
+            if(canPublish(position))
+            {
+                publish(position, message);
+                if(slot != 0)
+                {
+                    slot->key_ = key;
+                    slot->position_ = position;
+                }
+                publishPosition_.store(position + 1, std::memory_order_release);
+                notifyConsumer();
+                return;
+            }
+            SpinLock::Unguard unguard(guard);
+            waitToPublish(position);
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::conflationHome(ConflationKey key) const
+    {
+        return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) & conflationMask_;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    HighQConflationSlot * BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::findConflationSlot(ConflationKey key)
+    {
+        // Probe from the key's home slot until the key or an unused slot turns up.
+        // Slots whose message has been consumed are deleted as they are passed so the table never fills up.
+        Position readPosition = readPosition_;
+        size_t index = conflationHome(key);
+        size_t probeLimit = std::min(size_t(HighQConflationSlot::MaxProbe), conflationMask_ + 1);
+        size_t probe = 0;
+        while(probe < probeLimit)
+        {
+            HighQConflationSlot & slot = conflationSlots_[index];
+            if(slot.position_ == HighQConflationSlot::Unused)
+            {
+                return &slot;
+            }
+            if(slot.position_ < readPosition)
+            {
+                // Fills this slot from further along the probe sequence, so look at it again.
+                deleteConflationSlot(index);
+                continue;
+            }
+            if(slot.key_ == key)
+            {
+                return &slot;
+            }
+            index = (index + 1) & conflationMask_;
+            ++probe;
+        }
+        // Too many unconsumed keys share this neighborhood.  The caller publishes without conflating.
+        return 0;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::deleteConflationSlot(size_t hole)
+    {
+        // Backward shift deletion: move each following slot that may live in the hole back into it
+        // so every key stays reachable from its home slot without tombstones.
+        conflationSlots_[hole].position_ = HighQConflationSlot::Unused;
+        size_t next = (hole + 1) & conflationMask_;
+        while(conflationSlots_[next].position_ != HighQConflationSlot::Unused)
+        {
+            size_t home = conflationHome(conflationSlots_[next].key_);
+            if(((next - home) & conflationMask_) >= ((next - hole) & conflationMask_))
+            {
+                conflationSlots_[hole] = conflationSlots_[next];
+                conflationSlots_[next].position_ = HighQConflationSlot::Unused;
+                hole = next;
+            }
+            next = (next + 1) & conflationMask_;
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::setKeyExtractor(const KeyExtractor & extractor)
+    {
+        keyExtractor_ = extractor;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publishToLane(Message & message, size_t lane)
+    {
+        if(lane == 0)
+        {
+            publishToQueue(message);
+            return;
+        }
+        if(lane > laneCount_)
+        {
+            throw std::runtime_error("Producer: no such priority lane.");
+        }
+        HighQPriorityLane & priorityLane = lanes_[lane - 1];
+        auto entries = resolver_.resolve<HighQEntry>(priorityLane.entries_);
+        ++statPublishes_;
+        ++statPriority_;
+        SpinLock::Guard guard;
+        if(!isSolo())
+        {
+            guard = SpinLock::Guard(priorityLane.spinLock_);
+        }
+        waitBudget_.start();
+        while(!stopping_)
+        {
+            Position position = priorityLane.publishPosition_.position_.load(std::memory_order_relaxed); // solo or protected by spin lock
+            if(position < priorityLane.readPosition_.position_.load(std::memory_order_acquire) + priorityLane.entryCount_)
+            {
+                fillEntry(entries[position % priorityLane.entryCount_], message);
+                priorityLane.publishPosition_.position_.store(position + 1, std::memory_order_release);
+                waitBudget_.finish();
+                // Priority messages are not held back by coalesced wakeups.
+                notifyConsumer(true);
+                return;
+            }
+            // The lanes are meant for occasional messages, so the consumer does not
+            // signal when it makes room in one.  Poll.
+            SpinLock::Unguard unguard(guard);
+            if(waitBudget_.spin())
+            {
+                ++statSpins_;
+                spinDelay();
+            }
+            else if(waitBudget_.yield())
+            {
+                ++statYields_;
+                std::this_thread::yield();
+            }
+            else
+            {
+                ++statSleeps_;
+                std::this_thread::sleep_for(waitStrategy_.sleepPeriod_);
+            }
+        }
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::setLane(Message::MessageType type, size_t lane)
+    {
+        if(lane > laneCount_)
+        {
+            throw std::runtime_error("Producer: no such priority lane.");
+        }
+        size_t index = size_t(type);
+        if(index >= laneForType_.size())
+        {
+            laneForType_.resize(index + 1, 0);
+        }
+        laneForType_[index] = uint8_t(lane);
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    size_t BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::publishBatch(Position position, Message * messages, size_t count)
+    {
+        // canPublish() has already established that entries up to publishable_ are available.
+        Position end = publishable_;
+        size_t published = 0;
+        while(position < end && published < count)
+        {
+            if(publish(position, messages[published]))
+            {
+                ++published;
+            }
+            ++position;
+        }
+        // One store makes the whole batch visible to the consumer.
+        publishPosition_.store(position, std::memory_order_release);
+        return published;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    Message * BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::claim()
+    {
+        if(claimed_)
+        {
+            throw std::runtime_error("Producer::claim() called while a claim is outstanding.");
+        }
+        SpinLock::Guard guard;
+        if(!isSolo() && !lockFree_)
+        {
+            // The spin lock is held until commit() so entries are published in order.
+            guard = SpinLock::Guard(reserveSpinLock_);
+        }
+        while(!stopping_)
+        {
+            Position position;
+            if(isSolo() || !lockFree_)
+            {
+                position = publishPosition_; // solo or protected by spin lock.  Atomic not needed
+                if(!canPublish(position))
+                {
+                    SpinLock::Unguard unguard(guard);
+                    waitToPublish(position);
+                    continue;
+                }
+            }
+            else
+            {
+                position = reservePosition_.fetch_add(1, std::memory_order_relaxed);
+                if(!canPublish(position) && !waitToPublish(position))
+                {
+                    // stopping.
+                    abandon(position, position + 1);
+                    notifyConsumer();
+                    return nullptr;
+                }
+            }
+
+            HighQEntry & entry = entryAccessor_[position];
+            if(entry.status_ == HighQEntry::Status::SKIP)
+            {
+                entry.sequence_.store(position, std::memory_order_release);
+                if(!lockFree_)
+                {
+                    publishPosition_.store(position + 1, std::memory_order_release);
+                }
+                ++statSkips_;
+                continue;
+            }
+            if(overwrite_)
+            {
+                markWriting(entry);
+            }
+            entry.inlineUsed_ = 0;
+            if(sharedPool_)
+            {
+                // The block in the entry may have been put there by another process.
+                entry.message_.rebase(sharedPool_);
+            }
+            entry.message_.setEmpty();
+            claimed_ = true;
+            claimPosition_ = position;
+            claimGuard_ = std::move(guard);
+            return &entry.message_;
+        }
+        return nullptr;
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::commit()
+    {
+        if(!claimed_)
+        {
+            throw std::runtime_error("Producer::commit() called without a claim.");
+        }
+        HighQEntry & entry = entryAccessor_[claimPosition_];
+        entry.status_ = HighQEntry::Status::OK;
+        entry.sequence_.store(claimPosition_, std::memory_order_release);
+        if(!lockFree_)
+        {
+            publishPosition_.store(claimPosition_ + 1, std::memory_order_release);
+        }
+        claimed_ = false;
+        claimGuard_ = SpinLock::Guard();
+        ++statPublishes_;
+        ++statClaims_;
+        notifyConsumer();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::abandonClaim()
+    {
+        if(!claimed_)
+        {
+            throw std::runtime_error("Producer::abandonClaim() called without a claim.");
+        }
+        HighQEntry & entry = entryAccessor_[claimPosition_];
+        entry.status_ = HighQEntry::Status::SKIP;
+        entry.sequence_.store(claimPosition_, std::memory_order_release);
+        if(!lockFree_)
+        {
+            publishPosition_.store(claimPosition_ + 1, std::memory_order_release);
+        }
+        claimed_ = false;
+        claimGuard_ = SpinLock::Guard();
+        ++statSkips_;
+        notifyConsumer();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    void BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::stop()
+    {
+        stopping_ = true;
+        std::unique_lock<std::mutex> guard(header_->waitMutex_);
+        header_->producerWaitConditionVariable_.notify_all();
+        header_->producerFutex_.unparkAll();
+    }
+
+    template <typename SoloPolicy, typename WaitPolicy, typename DiscardPolicy, typename EntryCountPolicy>
+    inline
+    std::ostream & BasicProducer<SoloPolicy, WaitPolicy, DiscardPolicy, EntryCountPolicy>::writeStats(std::ostream & out) const
+    {
+        out << "Published " << statPublishes_
+                   << " Batches: " << statBatches_
+                   << " Inline: " << statInlines_
+                   << " Claims: " << statClaims_
+                   << " Priority: " << statPriority_
+                   << " Resized: " << statResizes_
+                   << " Wakes: " << statWakes_
+                   << " Full: " << statFulls_
+                   << " Overwrite: " << statOverwrites_
+                   << " Skip: " << statSkips_
+                   << " WaitOtherPublishers: " << statPublishWaits_
+                   << "/" << statPublishInLine_
+                   << " Spin: " << statSpins_ 
+                   << " Yield: " << statYields_ 
+                   << " Sleep: " << statSleeps_ 
+                   << " Wait: " << statWaits_
+                   << " Solo: " << (solo_ ? "Yes" : "No")
+                   << " LockFree: " << (lockFree_ ? "Yes" : "No");
+        if(conflate_)
+        {
+            out << " Conflated: " << statConflations_
+                << " ConflationRatio: " << (statPublishes_ == 0 ? 0.0 : double(statConflations_) / double(statPublishes_));
+        }
+        return waitBudget_.writeStats(out) << std::endl;
+
+    }
+}
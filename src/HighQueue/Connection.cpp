@@ -4,21 +4,79 @@
 #include <HighQueue/details/HQAllocator.hpp>
 #include <HighQueue/details/HQEntry.hpp>
 #include <HighQueue/details/HQResolver.hpp>
+#include <HighQueue/details/HQConflationSlot.hpp>
+#include <HighQueue/details/HQAbandonedPositions.hpp>
+#include <HighQueue/details/HQPriorityLane.hpp>
+#include <HighQueue/details/HQRing.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
+#include <HighQueue/details/HQPageMemory.hpp>
+#include <Common/Log.hpp>
+
+#include <cerrno>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif // _WIN32
 
 using namespace HighQueue;
 
+namespace
+{
+    /// @brief How long openExistingShared will wait for another process to finish creating the HighQueue.
+    const auto sharedAttachTimeout = std::chrono::seconds(5);
+    const auto sharedAttachPoll = std::chrono::milliseconds(1);
+
+    /// @brief POSIX shared memory names must begin with a slash.
+    std::string sharedMemoryName(const std::string & name)
+    {
+        if(!name.empty() && name[0] == '/')
+        {
+            return name;
+        }
+        return "/" + name;
+    }
+
+    /// @brief The name of the shared memory that holds a local HighQueue with published statistics.
+    /// The process id keeps local HighQueues with the same name in different processes apart.
+    std::string publishedMemoryName(const std::string & name)
+    {
+        std::stringstream shmName;
+        shmName << "/HighQueue." << getpid() << '.';
+        for(auto ch : name)
+        {
+            shmName << (ch == '/' ? '_' : ch);
+        }
+        return shmName.str();
+    }
+
+    std::string sharedMemoryError(const std::string & what, const std::string & name)
+    {
+        std::stringstream msg;
+        msg << "HighQueue shared memory \"" << name << "\": " << what << ": " << std::strerror(errno);
+        return msg.str();
+    }
+}
+
 Connection::Connection()
     : expectedProducers_(0)
+, messageSize_(0)
+, sharedMemory_(0)
+, sharedSize_(0)
+, publishedMemory_(0)
+, publishedSize_(0)
 , header_(0)
 {
 }
 
 Connection::~Connection()
 {
-    if(memoryPool_ && header_)
+    if(memoryPool_ && header_ && !sharedMemory_)
     {
         header_->releaseInternalMessages();
     }
+    unmapShared();
+    unpublishLocal();
 }
 
 void Connection::willProduce()
@@ -28,13 +86,19 @@ void Connection::willProduce()
 
 bool Connection::canSolo()const
 {
-    return expectedProducers_ == 1;
+    // Producers in other processes are invisible to this Connection, so
+    // a shared HighQueue can never be sure it has only one producer.
+    return expectedProducers_ == 1 && !sharedMemory_;
 }
 
+bool Connection::isShared()const
+{
+    return sharedMemory_ != 0;
+}
 
 void Connection::close()
 {
-    if(memoryPool_ && header_)
+    if(memoryPool_ && header_ && !sharedMemory_)
     {
         header_->releaseInternalMessages();
     }
@@ -46,27 +110,45 @@ void Connection::createLocal(
       const MemoryPoolPtr & pool)
 {
     memoryPool_ = pool;
+    messageSize_ = parameters.messageSize_;
     if(!memoryPool_)
     {
-        memoryPool_.reset(new MemoryPool(parameters.messageSize_, parameters.messageCount_));
+        memoryPool_.reset(new MemoryPool(parameters.messageSize_,
+            parameters.messageCount_ + HighQPriorityLane::entriesNeeded(parameters) + HighQRing::entriesNeeded(parameters),
+            parameters.pageOptions_));
     }
 
     const size_t allocatedSize = spaceNeededForHeader(parameters);
-    queueMemory_.reset(new byte_t[allocatedSize]);
     try
     {
-        byte_t * block = queueMemory_.get();
+        byte_t * block = 0;
+        if(parameters.publishStatistics_)
+        {
+            block = publishLocal(name, allocatedSize);
+            HighQPageMemory::prepare(block, allocatedSize, parameters.pageOptions_);
+        }
+        else
+        {
+            HighQPageMemory::Backing backing;
+            queueMemory_ = HighQPageMemory::allocate(allocatedSize, parameters.pageOptions_, &backing);
+            block = queueMemory_.get();
+            if(parameters.pageOptions_.hugePages_)
+            {
+                LogInfo("HighQueue " << name << ": " << allocatedSize << " bytes backed by " << HighQPageMemory::backingName(backing));
+            }
+        }
         byte_t * alignedBlock = HQAllocator::align(block, CacheLineSize);
         size_t availableSize = allocatedSize - (alignedBlock - block);
 
         HQAllocator allocator(availableSize, sizeof(HQHeader));
-        header_ = new (alignedBlock)HQHeader(name, allocator, parameters, &memoryPool_->getPool());
+        header_ = new (alignedBlock)HQHeader(name, allocator, parameters, &memoryPool_->getPool(messageSize_));
     }
     catch(...)
     {
         memoryPool_.reset();
         queueMemory_.reset();
         header_ = 0;
+        unpublishLocal();
         throw;
     }
 }
@@ -80,23 +162,275 @@ HQHeader * Connection::getHeader() const
     throw std::runtime_error("Using uninitialized Connection");
 }
             
+#ifndef _WIN32
+void Connection::openOrCreateShared(const std::string & name, const CreationParameters & parameters)
+{
+    if(parameters.producerWaitStrategy_.mutexUsed_ || parameters.consumerWaitStrategy_.mutexUsed_)
+    {
+        // A process that died holding the wait mutex would block every other process for good.
+        // A futex has no owner, so nothing is left locked.
+        throw std::runtime_error("A shared memory HighQueue can't wait on a mutex.  Use a WaitStrategy with useFutex.");
+    }
+    auto shmName = sharedMemoryName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if(fd < 0)
+    {
+        if(errno == EEXIST)
+        {
+            openExistingShared(name);
+            return;
+        }
+        throw std::runtime_error(sharedMemoryError("create failed", shmName));
+    }
+
+    const size_t allocatedSize = spaceNeededForShared(parameters);
+    if(ftruncate(fd, off_t(allocatedSize)) != 0)
+    {
+        auto error = sharedMemoryError("resize failed", shmName);
+        ::close(fd);
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error(error);
+    }
+    void * memory = mmap(0, allocatedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+    {
+        auto error = sharedMemoryError("map failed", shmName);
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error(error);
+    }
+
+    HighQPageMemory::prepare(reinterpret_cast<byte_t *>(memory), allocatedSize, parameters.pageOptions_);
+    try
+    {
+        // mmap returns page aligned memory so the header is already cache line aligned.
+        // The memory pool is constructed inside the block by the header.
+        HQAllocator allocator(allocatedSize, sizeof(HQHeader));
+        auto header = new (memory) HQHeader(name, allocator, parameters, 0, true);
+        (void)header;
+        attachShared(reinterpret_cast<byte_t *>(memory), allocatedSize);
+    }
+    catch(...)
+    {
+        munmap(memory, allocatedSize);
+        shm_unlink(shmName.c_str());
+        header_ = 0;
+        throw;
+    }
+}
+
+void Connection::openExistingShared(const std::string & name)
+{
+    auto shmName = sharedMemoryName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR, 0666);
+    if(fd < 0)
+    {
+        throw std::runtime_error(sharedMemoryError("open failed", shmName));
+    }
+
+    // The creator may not have sized the segment yet.
+    auto deadline = std::chrono::steady_clock::now() + sharedAttachTimeout;
+    struct stat status;
+    while(true)
+    {
+        if(fstat(fd, &status) != 0)
+        {
+            auto error = sharedMemoryError("stat failed", shmName);
+            ::close(fd);
+            throw std::runtime_error(error);
+        }
+        if(status.st_size >= off_t(sizeof(HQHeader)))
+        {
+            break;
+        }
+        if(std::chrono::steady_clock::now() > deadline)
+        {
+            ::close(fd);
+            throw std::runtime_error(sharedMemoryError("timed out waiting for creator", shmName));
+        }
+        std::this_thread::sleep_for(sharedAttachPoll);
+    }
+    const size_t allocatedSize = size_t(status.st_size);
+    void * memory = mmap(0, allocatedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+    {
+        throw std::runtime_error(sharedMemoryError("map failed", shmName));
+    }
+
+    auto header = reinterpret_cast<HQHeader *>(memory);
+    volatile Signature & signature = header->signature_;
+    while(signature != HQHeader::LiveSignature)
+    {
+        if(signature == HQHeader::DeadSignature || std::chrono::steady_clock::now() > deadline)
+        {
+            munmap(memory, allocatedSize);
+            std::stringstream msg;
+            msg << "HighQueue shared memory \"" << shmName << "\" is not live.  Signature: " << std::hex << signature;
+            throw std::runtime_error(msg.str());
+        }
+        std::this_thread::sleep_for(sharedAttachPoll);
+    }
+    std::atomic_thread_fence(std::memory_order::memory_order_acquire);
+    if(header->version_ != HQHeader::Version || header->memoryPool_ == 0)
+    {
+        munmap(memory, allocatedSize);
+        throw std::runtime_error("HighQueue shared memory \"" + shmName + "\" has an incompatible layout.");
+    }
+    attachShared(reinterpret_cast<byte_t *>(memory), allocatedSize);
+}
+
+bool Connection::removeShared(const std::string & name)
+{
+    auto shmName = sharedMemoryName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR, 0666);
+    if(fd < 0)
+    {
+        return false;
+    }
+    struct stat status;
+    if(fstat(fd, &status) == 0 && status.st_size >= off_t(sizeof(HQHeader)))
+    {
+        void * memory = mmap(0, sizeof(HQHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(memory != MAP_FAILED)
+        {
+            reinterpret_cast<HQHeader *>(memory)->signature_ = HQHeader::DeadSignature;
+            munmap(memory, sizeof(HQHeader));
+        }
+    }
+    ::close(fd);
+    return shm_unlink(shmName.c_str()) == 0;
+}
+
+void Connection::attachShared(byte_t * sharedMemory, size_t sharedSize)
+{
+    sharedMemory_ = sharedMemory;
+    sharedSize_ = sharedSize;
+    header_ = reinterpret_cast<HQHeader *>(sharedMemory);
+    HighQResolver resolver(header_);
+    memoryPool_ = std::make_shared<MemoryPool>(*resolver.resolve<HQMemoryBlockPool>(header_->memoryPool_));
+}
+
+void Connection::unmapShared()
+{
+    if(sharedMemory_)
+    {
+        memoryPool_.reset();
+        header_ = 0;
+        munmap(sharedMemory_, sharedSize_);
+        sharedMemory_ = 0;
+        sharedSize_ = 0;
+    }
+}
+
+byte_t * Connection::publishLocal(const std::string & name, size_t size)
+{
+    auto shmName = publishedMemoryName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+    {
+        throw std::runtime_error(sharedMemoryError("create failed", shmName));
+    }
+    if(ftruncate(fd, off_t(size)) != 0)
+    {
+        auto error = sharedMemoryError("resize failed", shmName);
+        ::close(fd);
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error(error);
+    }
+    void * memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(memory == MAP_FAILED)
+    {
+        auto error = sharedMemoryError("map failed", shmName);
+        shm_unlink(shmName.c_str());
+        throw std::runtime_error(error);
+    }
+    publishedName_ = shmName;
+    publishedMemory_ = reinterpret_cast<byte_t *>(memory);
+    publishedSize_ = size;
+    return publishedMemory_;
+}
+
+void Connection::unpublishLocal()
+{
+    if(publishedMemory_)
+    {
+        if(header_)
+        {
+            // Tell readers that are still attached.
+            header_->signature_ = HQHeader::DeadSignature;
+            header_ = 0;
+        }
+        shm_unlink(publishedName_.c_str());
+        munmap(publishedMemory_, publishedSize_);
+        publishedMemory_ = 0;
+        publishedSize_ = 0;
+        publishedName_.clear();
+    }
+}
+#else // _WIN32
 void Connection::openOrCreateShared(const std::string & name, const CreationParameters & parameters)
 {
-// todo
+    throw std::runtime_error("Shared memory HighQueues are not supported on this platform.");
 }
 
 void Connection::openExistingShared(const std::string & name)
 {
-// todo
+    throw std::runtime_error("Shared memory HighQueues are not supported on this platform.");
+}
+
+bool Connection::removeShared(const std::string & name)
+{
+    return false;
+}
+
+void Connection::attachShared(byte_t * sharedMemory, size_t sharedSize)
+{
+}
+
+void Connection::unmapShared()
+{
+}
+
+byte_t * Connection::publishLocal(const std::string & name, size_t size)
+{
+    throw std::runtime_error("Publishing HighQueue statistics is not supported on this platform.");
+}
+
+void Connection::unpublishLocal()
+{
 }
+#endif // _WIN32
 
 size_t Connection::spaceNeededForHeader(const CreationParameters & parameters)
 {
     size_t headerSize = HQAllocator::align(sizeof(HQHeader), CacheLineSize);
-    size_t entriesSize = HighQEntry::alignedSize() * parameters.entryCount_;
-    size_t positionsSize = CacheLineSize * 3; // note the assumption that each position fitx in a single cache line
+    size_t maxEntryCount = HighQRing::maxEntryCount(parameters);
+    size_t entriesSize = maxEntryCount == 0
+        ? HighQEntry::alignedSize() * parameters.entryCount_
+        : HighQEntry::alignedSize() * maxEntryCount * 2 + CacheLineSize;
+    size_t positionsSize = CacheLineSize * (4 + parameters.subscriberCount_); // note the assumption that each position fitx in a single cache line
+    size_t conflationSize = parameters.conflateByKey_
+        ? HQAllocator::align(sizeof(HighQConflationSlot) * HighQConflationSlot::slotCount(parameters.entryCount_), CacheLineSize)
+        : 0;
+    size_t abandonedSize = parameters.lockFreeProducers_
+        ? HQAllocator::align(sizeof(HighQAbandonedPositions), CacheLineSize)
+        : 0;
+    size_t laneCount = HighQPriorityLane::laneCount(parameters);
+    size_t lanesSize = laneCount == 0
+        ? 0
+        : HQAllocator::align(sizeof(HighQPriorityLane) * laneCount, CacheLineSize)
+            + HighQEntry::alignedSize() * HighQPriorityLane::entriesNeeded(parameters);
+    size_t statisticsSize = HQAllocator::align(sizeof(HighQStatistics), CacheLineSize);
     size_t cacheAlignmentSize = CacheLineSize;
-    return headerSize + entriesSize + positionsSize + CacheLineSize;
+    return headerSize + entriesSize + positionsSize + abandonedSize + conflationSize + lanesSize + statisticsSize + CacheLineSize;
+}
+
+size_t Connection::spaceNeededForShared(const CreationParameters & parameters)
+{
+    return spaceNeededForHeader(parameters) + HQMemoryBlockPool::spaceNeeded(parameters.messageSize_,
+        parameters.messageCount_ + HighQPriorityLane::entriesNeeded(parameters) + HighQRing::entriesNeeded(parameters));
 }
 
 void Connection::allocate(Message & message)
@@ -105,7 +439,7 @@ void Connection::allocate(Message & message)
     {
         throw std::runtime_error("Using uninitialized Connection");
     }
-    memoryPool_->allocate(message);
+    memoryPool_->allocate(message, messageSize_);
 }
 
 bool Connection::tryAllocate(Message & message)
@@ -114,7 +448,38 @@ bool Connection::tryAllocate(Message & message)
     {
         throw std::runtime_error("Using uninitialized Connection");
     }
-    return memoryPool_->tryAllocate(message);
+    return memoryPool_->tryAllocate(message, messageSize_);
+}
+
+bool Connection::resize(size_t entryCount)
+{
+    if(!memoryPool_)
+    {
+        throw std::runtime_error("Using uninitialized Connection");
+    }
+    return getHeader()->resize(entryCount, &memoryPool_->getPool(messageSize_));
+}
+
+size_t Connection::getEntryCount() const
+{
+    auto header = getHeader();
+    return header->rings_[header->ringGeneration_.load(std::memory_order_acquire) % 2].entryCount_;
+}
+
+size_t Connection::getBacklog() const
+{
+    auto header = getHeader();
+    HighQResolver resolver(header);
+    Position readPosition = resolver.resolve<AtomicPosition>(header->readPosition_)->load(std::memory_order_acquire);
+    Position publishPosition = resolver.resolve<AtomicPosition>(header->publishPosition_)->load(std::memory_order_acquire);
+    return publishPosition > readPosition ? size_t(publishPosition - readPosition) : 0;
+}
+
+const HighQStatistics & Connection::getStatistics() const
+{
+    auto header = getHeader();
+    HighQResolver resolver(header);
+    return *resolver.resolve<HighQStatistics>(header->statistics_);
 }
 
 size_t Connection::getMessageCapacity()const
@@ -123,5 +488,14 @@ size_t Connection::getMessageCapacity()const
     {
         throw std::runtime_error("Using uninitialized Connection");
     }
-    return memoryPool_->getBlockCapacity();
+    return memoryPool_->getBlockCapacity(messageSize_);
+}
+
+bool Connection::owns(const Message & message)const
+{
+    if(!memoryPool_)
+    {
+        throw std::runtime_error("Using uninitialized Connection");
+    }
+    return memoryPool_->owns(message);
 }
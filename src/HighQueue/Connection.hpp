@@ -42,8 +42,17 @@ namespace HighQueue
             
         /// @brief Attempt to attach to an existing HighQueue in shared memory.  If none
         /// is found, then create a new one.
+        ///
+        /// The header, the entries and the memory pool all live in a single named
+        /// shared memory segment, so Messages for this HighQueue must be allocated
+        /// from this Connection.
+        ///
+        /// A process may die at any time, so the wait strategies may park on a futex but not on
+        /// a mutex.  A producer that dies while holding the reserve spin lock still blocks the
+        /// other producers.  Use lockFreeProducers_ if producers live in separate processes.
         /// @param name Identifies this shared memory block so other processes can find it.
         /// @param parameters configure the operation of the HighQueue
+        /// @throws runtime_error if either wait strategy uses a mutex.
         void openOrCreateShared(
             const std::string & name, 
             const CreationParameters & parameters); 
@@ -53,9 +62,22 @@ namespace HighQueue
         void close();
 
         /// @brief Connect to an existing HighQueue in shared memory.
+        /// Waits briefly for another process to finish initializing the HighQueue.
         /// @param name will be used to find the shared memory block.
+        /// @throws runtime_error if the HighQueue does not exist, is dead, or never becomes live.
         void openExistingShared(const std::string & name);
 
+        /// @brief Mark a shared memory HighQueue dead and remove its name from the system.
+        ///
+        /// Processes that are already attached continue to use the memory until they close,
+        /// but no new process can attach.
+        /// @param name identifies the shared memory block.
+        /// @returns true if the HighQueue existed.
+        static bool removeShared(const std::string & name);
+
+        /// @brief Does this connection refer to a HighQueue in shared memory?
+        bool isShared()const;
+
         /// @brief Populate a message with a block from the HighQueue's memory pool
         /// @param the message to be populated.
         /// @returns true if there was memory available.
@@ -68,7 +90,37 @@ namespace HighQueue
 
         /// @brief Get the capacity of each message used with this HighQueue
         size_t getMessageCapacity()const;
+
+        /// @brief Did message's block come from this HighQueue's memory pool?
+        /// A producer that publishes a block from another pool moves that block into this HighQueue for good.
+        bool owns(const Message & message)const;
             
+        /// @brief Change the number of entries while producers and consumers are running.
+        ///
+        /// Only for a HighQueue created with CreationParameters::maxEntryCount_.  The new entries are
+        /// prepared here.  The producers switch to them the next time they find the HighQueue full
+        /// or reach the end of the space they know is free.  Messages already published stay where
+        /// they are and are consumed first.  The HighQueue may grow or shrink.  It holds no more
+        /// than the new number of messages once the switch has happened.
+        ///
+        /// Once any client uses PowerOfTwoEntryCount only powers of two are accepted.
+        /// @param entryCount the new number of entries, up to maxEntryCount_.
+        /// @returns false if an earlier resize has not finished.  Try again later.
+        /// @throws runtime_error if the HighQueue cannot be resized to this size.
+        bool resize(size_t entryCount);
+
+        /// @brief How many entries the producers are using now.
+        size_t getEntryCount() const;
+
+        /// @brief How many published entries have not been consumed.
+        /// Approximate while producers and consumers are running.  Not maintained with lockFreeProducers_.
+        size_t getBacklog() const;
+
+        /// @brief The counters the Producers and Consumers update while they run.
+        /// Other processes can read them if the HighQueue is shared or was created with
+        /// CreationParameters::publishStatistics_.  See the hqstat application.
+        const HighQStatistics & getStatistics() const;
+
         /// @brief Provide direct access to internal implementation details.
         HQHeader * getHeader() const;
             
@@ -79,12 +131,30 @@ namespace HighQueue
         /// @returns a byte count suitable for use in "new byte_t[count]" or even malloc.
         static size_t spaceNeededForHeader(const CreationParameters & parameters);
 
+        /// @brief A helper function to determine how much space is needed in a shared memory block
+        /// to hold an HighQueue and its memory pool.
+        /// @param parameters will be used to create the HighQueue
+        static size_t spaceNeededForShared(const CreationParameters & parameters);
+
         void willProduce();
         bool canSolo()const;
+    private:
+        void attachShared(byte_t * sharedMemory, size_t sharedSize);
+        void unmapShared();
+        byte_t * publishLocal(const std::string & name, size_t size);
+        void unpublishLocal();
     private:
         size_t expectedProducers_;
         MemoryPoolPtr memoryPool_;
-        std::unique_ptr<byte_t[]> queueMemory_; 
+        /// @brief Selects the pool's size class for this queue's Messages.  See CreationParameters::messageSize_
+        size_t messageSize_;
+        std::shared_ptr<byte_t> queueMemory_;
+        byte_t * sharedMemory_;
+        size_t sharedSize_;
+        /// @brief Named shared memory holding a local HighQueue with published statistics.
+        std::string publishedName_;
+        byte_t * publishedMemory_;
+        size_t publishedSize_;
         HQHeader * header_;
     };
 }
@@ -5,6 +5,7 @@
 #pragma once
 #include "CreationParametersFwd.hpp"
 #include <HighQueue/WaitStrategy.hpp>
+#include <HighQueue/details/HQPageMemory.hpp>
 
 namespace HighQueue
 {
@@ -24,6 +25,60 @@ namespace HighQueue
         /// @brief What is the minimum number of messages needed (one extra may be allocated just because...)
         /// Not needed when an external memory pool will be used.
         size_t messageCount_;
+        /// @brief Should multiple producers claim entries using an atomic increment rather than a spin lock?
+        /// Producers then fill their entries in parallel.  Ignored if discardMessagesIfNoConsumer_ is true.
+        bool lockFreeProducers_;
+        /// @brief May several consumers take messages from this queue?
+        /// Each message is delivered to exactly one of them.  When true discardMessagesIfNoConsumer_ is ignored.
+        bool competingConsumers_;
+        /// @brief If nonzero, every message is delivered to each of this many subscribing consumers.
+        /// Producers wait for the slowest subscriber, so all of them should attach.
+        /// Cannot be combined with competingConsumers_.  When nonzero discardMessagesIfNoConsumer_ is ignored.
+        size_t subscriberCount_;
+        /// @brief Should payloads of up to HighQEntry::InlineCapacity bytes be copied into the entry itself?
+        /// Small messages then never swap memory blocks.  Ignored when subscriberCount_ is nonzero.
+        bool inlinePayloads_;
+        /// @brief Should a full HighQueue overwrite its oldest entries rather than make producers wait?
+        /// The consumer skips the messages it lost and counts them as overruns.
+        /// Ignored with competingConsumers_ or a nonzero subscriberCount_.  Producers use the spin lock
+        /// rather than lockFreeProducers_.
+        bool overwriteWhenFull_;
+        /// @brief Should a message replace an unconsumed message with the same key rather than being queued behind it?
+        /// The key is passed to Producer::publish(Message &, ConflationKey) or chosen by the Producer's key extractor.
+        /// Ignored with competingConsumers_, a nonzero subscriberCount_, or overwriteWhenFull_.
+        /// Producers use the spin lock rather than lockFreeProducers_.
+        bool conflateByKey_;
+        /// @brief How many priority lanes, each a small ring read ahead of the HighQueue's own entries.
+        /// Up to 3 (so 4 rings in all.)  Producers send Shutdown and Heartbeat messages to the highest lane
+        /// so they don't wait behind queued data.  Ignored with competingConsumers_ or a nonzero subscriberCount_.
+        size_t priorityLanes_;
+        /// @brief How many entries in each priority lane.  Each takes a Message from the pool in addition
+        /// to messageCount_.  Must not be zero if there are priority lanes.
+        size_t priorityEntryCount_;
+        /// @brief If nonzero, the HighQueue can be resized while it is in use (see Connection::resize())
+        /// to at most this many entries (or entryCount_ if that is larger).
+        /// Room is reserved for two sets of this many entries, and the memory pool needs this many
+        /// Messages in addition to messageCount_.  A pool the HighQueue creates for itself includes them.
+        /// Ignored with lockFreeProducers_, overwriteWhenFull_, or conflateByKey_.
+        size_t maxEntryCount_;
+        /// @brief Should a local HighQueue live in named shared memory so tools such as hqstat can read its statistics?
+        /// The name includes the process id.  It is removed when the Connection is destroyed.
+        /// HighQueues created with Connection::openOrCreateShared are always visible.
+        bool publishStatistics_;
+        /// @brief The consumer publishes its read position every this many entries rather than after each one,
+        /// and whenever it runs out of messages.  The producers then rarely read the consumer's cache line.
+        /// They check the entry they want to reuse instead.  0 or 1 publishes after every entry.
+        /// Ignored with competingConsumers_, a nonzero subscriberCount_, overwriteWhenFull_, or conflateByKey_.
+        size_t readPositionInterval_;
+        /// @brief While a single consumer takes entry i it asks the processor to start loading entry
+        /// i + prefetchDistance_ and the memory block that entry's message uses, so they are in cache
+        /// when it gets there.  Helps most when the entries and pool are larger than the L2 cache.
+        /// 0 (the default) does not prefetch.  Limited to entryCount_ - 1.
+        size_t prefetchDistance_;
+        /// @brief How the pages under a local HighQueue's entries, and under a memory pool it creates for
+        /// itself, are provided: huge pages, and whether to fault them in (or lock them) before use.
+        /// Named shared memory is never backed by huge pages, but may be prefaulted or locked.
+        PageOptions pageOptions_;
 
         CreationParameters()
             : producerWaitStrategy_()
@@ -32,6 +87,19 @@ namespace HighQueue
             , entryCount_(0)
             , messageSize_(0)
             , messageCount_(0)
+            , lockFreeProducers_(false)
+            , competingConsumers_(false)
+            , subscriberCount_(0)
+            , inlinePayloads_(false)
+            , overwriteWhenFull_(false)
+            , conflateByKey_(false)
+            , priorityLanes_(0)
+            , priorityEntryCount_(64)
+            , maxEntryCount_(0)
+            , publishStatistics_(false)
+            , readPositionInterval_(1)
+            , prefetchDistance_(0)
+            , pageOptions_()
         {}
 
         CreationParameters(
@@ -48,6 +116,19 @@ namespace HighQueue
             , entryCount_(entryCount)
             , messageSize_(messageSize)
             , messageCount_(messageCount)
+            , lockFreeProducers_(false)
+            , competingConsumers_(false)
+            , subscriberCount_(0)
+            , inlinePayloads_(false)
+            , overwriteWhenFull_(false)
+            , conflateByKey_(false)
+            , priorityLanes_(0)
+            , priorityEntryCount_(64)
+            , maxEntryCount_(0)
+            , publishStatistics_(false)
+            , readPositionInterval_(1)
+            , prefetchDistance_(0)
+            , pageOptions_()
         {}
     };
 }
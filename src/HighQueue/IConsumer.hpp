@@ -37,11 +37,30 @@ public:
     /// Note: uses the WaitStrategy to wait.
     virtual bool getNext(Message & message) = 0;
 
+    /// @brief Get as many messages as are available, up to a limit.
+    ///
+    /// @param messages points to the first of limit messages to be populated. See MessageArray.
+    /// @param limit is the maximum number of messages to return.
+    /// @returns immediately.  The number of messages populated. Zero if no data is available.
+    virtual size_t tryGetNextBatch(Message * messages, size_t limit) = 0;
+
+    /// @brief Get as many messages as are available, up to a limit.  Wait if none are available.
+    ///
+    /// @param messages points to the first of limit messages to be populated. See MessageArray.
+    /// @param limit is the maximum number of messages to return.
+    /// @returns the number of messages populated.  Zero only if shutting down.
+    virtual size_t getNextBatch(Message * messages, size_t limit) = 0;
+
     /// @brief for diagnosing and performance measurements, dump statistics
     virtual std::ostream & writeStats(std::ostream & out)const = 0;
 
     /// @brief stop receiving messages.
     virtual void stop() = 0;
+
+    /// @brief Start loading whatever the next get will read.  Only a hint; the default does nothing.
+    virtual void prefetchNext()
+    {
+    }
     
     void setName(const std::string & name)
     {
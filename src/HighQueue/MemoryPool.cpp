@@ -2,24 +2,77 @@
 #include <Common/HighQueuePch.hpp>
 #include "MemoryPool.hpp"
 #include <HighQueue/details/HQAllocator.hpp>
+#include <algorithm>
 
 using namespace HighQueue;
 
-MemoryPool::MemoryPool(size_t blockSize, size_t count)
-    : allocatedSize_(HQMemoryBlockPool::spaceNeeded(blockSize, count) + CacheLineSize)
-    , memory_(new byte_t[allocatedSize_])
-    , pool_(*new (memory_.get()) HQMemoryBlockPool(allocatedSize_, blockSize))
-    , numberOfAllocations_(0)
+MemoryPool::MemoryPool(size_t blockSize, size_t count, const PageOptions & pageOptions)
+    : numberOfAllocations_(0)
 {
+    addClass(blockSize, count, pageOptions);
+}
+
+MemoryPool::MemoryPool(const SizeClasses & sizeClasses, const PageOptions & pageOptions)
+    : numberOfAllocations_(0)
+{
+    if(sizeClasses.empty())
+    {
+        throw std::invalid_argument("MemoryPool: no size classes.");
+    }
+    auto sorted = sizeClasses;
+    std::sort(sorted.begin(), sorted.end());
+    for(auto & sizeClass : sorted)
+    {
+        addClass(sizeClass.first, sizeClass.second, pageOptions);
+    }
+}
+
+MemoryPool::MemoryPool(HQMemoryBlockPool & pool)
+    : numberOfAllocations_(0)
+{
+    SizeClass sizeClass;
+    sizeClass.pool_ = &pool;
+    classes_.push_back(sizeClass);
 }
 
 MemoryPool::~MemoryPool()
 {
+    for(auto & sizeClass : classes_)
+    {
+        if(sizeClass.memory_)
+        {
+            sizeClass.pool_->retireThreadCaches();
+        }
+    }
+}
+
+void MemoryPool::addClass(size_t blockSize, size_t count, const PageOptions & pageOptions)
+{
+    auto allocatedSize = HQMemoryBlockPool::spaceNeeded(blockSize, count) + CacheLineSize;
+    SizeClass sizeClass;
+    sizeClass.memory_ = HighQPageMemory::allocate(allocatedSize, pageOptions);
+    sizeClass.pool_ = new (sizeClass.memory_.get()) HQMemoryBlockPool(allocatedSize, blockSize);
+    classes_.push_back(sizeClass);
+}
+
+size_t MemoryPool::classFor(size_t sizeHint)const
+{
+    if(sizeHint != 0)
+    {
+        for(size_t index = 0; index + 1 < classes_.size(); ++index)
+        {
+            if(classes_[index].pool_->getBlockCapacity() >= sizeHint)
+            {
+                return index;
+            }
+        }
+    }
+    return classes_.size() - 1;
 }
 
 bool MemoryPool::tryAllocate(Message & message)
 {
-    if(pool_.tryAllocate(message))
+    if(classes_.back().pool_->tryAllocate(message))
     {
         ++numberOfAllocations_;
         return true;
@@ -29,13 +82,72 @@ bool MemoryPool::tryAllocate(Message & message)
 
 void MemoryPool::allocate(Message & message)
 {
-    pool_.allocate(message);
+    classes_.back().pool_->allocate(message);
     ++numberOfAllocations_;
 }
 
+bool MemoryPool::tryAllocate(Message & message, size_t sizeHint)
+{
+    for(auto index = classFor(sizeHint); index < classes_.size(); ++index)
+    {
+        if(classes_[index].pool_->tryAllocate(message))
+        {
+            ++numberOfAllocations_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MemoryPool::allocate(Message & message, size_t sizeHint)
+{
+    if(!tryAllocate(message, sizeHint))
+    {
+        throw std::runtime_error("Memory allocation for message failed");
+    }
+}
+
+void MemoryPool::enableThreadCaches(size_t batchSize, bool drainWhenEmpty)
+{
+    for(auto & sizeClass : classes_)
+    {
+        if(!sizeClass.memory_)
+        {
+            throw std::runtime_error("MemoryPool: per-thread caches need a pool owned by this process.");
+        }
+        sizeClass.pool_->enableThreadCaches(batchSize, drainWhenEmpty);
+    }
+}
+
+void MemoryPool::drainThreadCaches()
+{
+    for(auto & sizeClass : classes_)
+    {
+        sizeClass.pool_->drainThreadCaches();
+    }
+}
+
 size_t MemoryPool::getBlockCapacity()const
 {
-    return pool_.getBlockCapacity();
+    return classes_.back().pool_->getBlockCapacity();
+}
+
+size_t MemoryPool::getBlockCapacity(size_t sizeHint)const
+{
+    return classes_[classFor(sizeHint)].pool_->getBlockCapacity();
+}
+
+bool MemoryPool::owns(const Message & message)const
+{
+    auto container = message.getContainer();
+    for(auto & sizeClass : classes_)
+    {
+        if(container == reinterpret_cast<byte_t *>(sizeClass.pool_))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 size_t MemoryPool::numberOfAllocations()const
@@ -5,42 +5,110 @@
 #pragma once
 #include "MemoryPoolFwd.hpp"
 #include <HighQueue/details/HQMemoryBlockPool.hpp>
+#include <HighQueue/details/HQPageMemory.hpp>
 #include <HighQueue/MessageFwd.hpp>
 
 namespace HighQueue
 {
+    /// @brief The memory blocks for Messages.
+    ///
+    /// A MemoryPool may have several size classes, each an HQMemoryBlockPool with blocks of one size.
+    /// A Message that needs only a few bytes can then take a small block rather than one sized for
+    /// the largest Message anyone needs.  Blocks go back to the class they came from when the
+    /// Message is released.
     class HighQueue_Export MemoryPool
     {
     public:
-        /// @brief Construct.
-        MemoryPool(size_t blockSize, size_t count);
+        /// @brief The block size and the number of blocks for each size class.
+        typedef std::vector<std::pair<size_t, size_t> > SizeClasses;
+
+        /// @brief Construct with a single size class.
+        /// @param pageOptions say how the pages under the blocks are provided.
+        MemoryPool(size_t blockSize, size_t count, const PageOptions & pageOptions = PageOptions());
+
+        /// @brief Construct with several size classes.
+        /// @throws invalid_argument if there are none.
+        explicit MemoryPool(const SizeClasses & sizeClasses, const PageOptions & pageOptions = PageOptions());
+
+        /// @brief Construct a wrapper around a pool that lives in memory owned by someone else.
+        /// This is used for the pool inside a shared memory HighQueue.
+        explicit MemoryPool(HQMemoryBlockPool & pool);
 
         ~MemoryPool();
 
-        /// @brief Populate a message with a block from the HighQueue's memory pool
+        /// @brief Populate a message with a block from the largest size class.
         /// @param the message to be populated.
         /// @returns true if there was memory available.
         bool tryAllocate(Message & message);
 
-        /// @brief Populate a message with a block from the HighQueue's memory pool
+        /// @brief Populate a message with a block from the largest size class.
         /// @param the message to be populated.
         /// @throws runtime_error if no memory was available
         void allocate(Message & message);
 
-        /// @brief Get the capacity of each block in this pool
+        /// @brief Populate a message with a block from the smallest size class that holds sizeHint bytes.
+        /// If that class is empty a larger one is used.
+        /// @param sizeHint how many bytes the message needs.  Zero asks for the largest size class.
+        /// @returns true if there was memory available.
+        bool tryAllocate(Message & message, size_t sizeHint);
+
+        /// @brief Populate a message with a block from the smallest size class that holds sizeHint bytes.
+        /// @throws runtime_error if no memory was available
+        void allocate(Message & message, size_t sizeHint);
+
+        /// @brief Let each thread keep a few free blocks of its own.  See HQMemoryBlockPool::enableThreadCaches()
+        /// @throws runtime_error if the pool lives in memory owned by someone else (it may be shared with other processes.)
+        void enableThreadCaches(size_t batchSize, bool drainWhenEmpty = true);
+
+        /// @brief Ask every thread to give back the blocks it keeps.
+        void drainThreadCaches();
+
+        /// @brief Get the capacity of each block in the largest size class
         size_t getBlockCapacity()const;
 
+        /// @brief Get the capacity of the blocks used for messages of sizeHint bytes.
+        size_t getBlockCapacity(size_t sizeHint)const;
+
+        /// @brief The largest size class.
         HQMemoryBlockPool & getPool()
         {
-            return pool_;
+            return *classes_.back().pool_;
         }
 
+        /// @brief The size class used for messages of sizeHint bytes.
+        HQMemoryBlockPool & getPool(size_t sizeHint)
+        {
+            return *classes_[classFor(sizeHint)].pool_;
+        }
+
+        /// @brief How many size classes there are.  They are ordered from smallest to largest blocks.
+        size_t getClassCount()const
+        {
+            return classes_.size();
+        }
+
+        HQMemoryBlockPool & getClass(size_t index)
+        {
+            return *classes_[index].pool_;
+        }
+
+        /// @brief Did message's block come from one of this pool's size classes?
+        bool owns(const Message & message)const;
+
         size_t numberOfAllocations()const;
 
     private:
-        size_t allocatedSize_;
-        std::shared_ptr<byte_t> memory_;
-        HQMemoryBlockPool & pool_;
+        /// @brief The index of the smallest class that can hold sizeHint bytes (or the largest class.)
+        size_t classFor(size_t sizeHint)const;
+        void addClass(size_t blockSize, size_t count, const PageOptions & pageOptions);
+
+    private:
+        struct SizeClass
+        {
+            std::shared_ptr<byte_t> memory_;
+            HQMemoryBlockPool * pool_;
+        };
+        std::vector<SizeClass> classes_;
         size_t numberOfAllocations_;
     };
 }
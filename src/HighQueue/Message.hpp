@@ -37,6 +37,14 @@ namespace HighQueue
         template <typename AllocatorPtr>
         explicit Message(AllocatorPtr & allocator);
 
+        /// @brief construct an empty Message with room for at least sizeHint bytes
+        /// @tparam AllocatorPtr points to an Allocator that has size classes (i.e. a MemoryPool)
+        /// concept Allocator {
+        ///    void allocate(Message & message, size_t sizeHint);
+        /// };
+        template <typename AllocatorPtr>
+        Message(AllocatorPtr & allocator, size_t sizeHint);
+
         Message() = delete;
         Message(const Message &) = delete;
         Message(Message &&) = delete;
@@ -82,6 +90,9 @@ namespace HighQueue
         /// @param returns the number of bytes used.
         size_t getUsed() const;
 
+        /// @brief How many bytes can this message hold?
+        size_t getCapacity() const;
+
         /// @brief How many objects of type T can be added to the message.
         /// @tparam T is the type of object
         template <typename T = byte_t>
@@ -237,6 +248,12 @@ namespace HighQueue
         /// @brief Undo a set.  Return the memory to the pool (if any), and make the message Invalid.
         void release();
 
+        /// @brief Attach the current block to this process's view of the pool that contains it.
+        /// A HighQueue in shared memory may be mapped at different addresses in different processes.
+        /// After a block is swapped out of such a HighQueue its container must be re-resolved locally.
+        /// @param pool The local address of the pool that owns this message's block.
+        void rebase(HQMemoryBlockPool * pool);
+
         /// @brief Get the base address of the block of memory containing this message's memory.
         /// NOTE: this is not an interesting function.  Do not use it.
         byte_t * getContainer()const;
@@ -277,6 +294,20 @@ namespace HighQueue
         allocator->allocate(*this);
     }
 
+    template <typename AllocatorPtr>
+    Message::Message(AllocatorPtr & allocator, size_t sizeHint)
+        : container_(0)
+        , capacity_(0)
+        , offset_(0)
+        , used_(0)
+        , read_(0)
+        , type_(Message::MessageType::Unused)
+        , timestamp_(0)
+        , sequence_(0)
+    {
+        allocator->allocate(*this, sizeHint);
+    }
+
 
     inline
     size_t Message::setUsed(size_t used)
@@ -301,6 +332,12 @@ namespace HighQueue
         return used_;
     }
 
+    inline
+    size_t Message::getCapacity() const
+    {
+        return capacity_;
+    }
+
     template <typename T>
     T* Message::getWritePosition()const
     {
@@ -399,6 +436,12 @@ namespace HighQueue
         rhs.sequence_ = sequence_;
     }
     
+    inline
+    void Message::rebase(HQMemoryBlockPool * pool)
+    {
+        container_ = reinterpret_cast<byte_t *>(pool);
+    }
+
     inline
     void Message::moveTo(Message & rhs)
     {
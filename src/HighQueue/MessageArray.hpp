@@ -0,0 +1,97 @@
+/// @file MessageArray.hpp
+// Copyright (c) 2016 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/Message.hpp>
+
+namespace HighQueue
+{
+    /// @brief A fixed size, contiguous array of Messages.
+    ///
+    /// Messages can be neither copied nor moved, so they cannot live in a std::vector.
+    /// This provides the contiguous Message * that the batch methods
+    /// Producer::publish(Message *, size_t) and Consumer::tryGetNextBatch() expect.
+    class MessageArray
+    {
+    public:
+        /// @brief Construct size messages, each populated from allocator.
+        /// @tparam AllocatorPtr see the Message constructor.
+        template <typename AllocatorPtr>
+        MessageArray(AllocatorPtr & allocator, size_t size);
+
+        /// @brief destruct the messages, returning their memory to the pool.
+        ~MessageArray();
+
+        MessageArray(const MessageArray &) = delete;
+        MessageArray & operator=(const MessageArray &) = delete;
+
+        /// @brief Access the first message in the array
+        Message * get()const;
+
+        /// @brief Access a message in the array
+        Message & operator[](size_t index)const;
+
+        /// @brief How many messages are in the array
+        size_t size()const;
+
+    private:
+        std::unique_ptr<byte_t[]> storage_;
+        Message * messages_;
+        size_t size_;
+    };
+
+    template <typename AllocatorPtr>
+    MessageArray::MessageArray(AllocatorPtr & allocator, size_t size)
+        : storage_(new byte_t[sizeof(Message) * size])
+        , messages_(reinterpret_cast<Message *>(storage_.get()))
+        , size_(0)
+    {
+        try
+        {
+            while(size_ < size)
+            {
+                new (messages_ + size_) Message(allocator);
+                ++size_;
+            }
+        }
+        catch(...)
+        {
+            while(size_ > 0)
+            {
+                --size_;
+                messages_[size_].~Message();
+            }
+            throw;
+        }
+    }
+
+    inline
+    MessageArray::~MessageArray()
+    {
+        while(size_ > 0)
+        {
+            --size_;
+            messages_[size_].~Message();
+        }
+    }
+
+    inline
+    Message * MessageArray::get()const
+    {
+        return messages_;
+    }
+
+    inline
+    Message & MessageArray::operator[](size_t index)const
+    {
+        return messages_[index];
+    }
+
+    inline
+    size_t MessageArray::size()const
+    {
+        return size_;
+    }
+}
@@ -7,6 +7,7 @@ using namespace HighQueue;
 MultiQueueConsumer::MultiQueueConsumer()
 : stopping_(false)
 , consumerPos_(0)
+, prefetch_(false)
 {
 }
 
@@ -17,6 +18,7 @@ MultiQueueConsumer::~MultiQueueConsumer()
 void MultiQueueConsumer::addQueue(ConnectionPtr & connection, const std::string & name)
 {
     ConsumerPtr consumer = std::make_shared<Consumer>(connection);
+    prefetch_ = prefetch_ || connection->getHeader()->prefetchDistance_ != 0;
 
     if(name.empty())
     {
@@ -54,6 +56,11 @@ bool MultiQueueConsumer::tryGetNext(Message & message)
     size_t end = consumerPos_ + consumers_.size();
     for(size_t pos = start; !found && !stopping_ && pos < end; ++pos)
     {
+        if(prefetch_)
+        {
+            // Let the next candidate's entry load while this queue is checked.
+            consumers_[(pos + 1) % consumers_.size()]->prefetchNext();
+        }
         found = consumers_[pos % consumers_.size()]->tryGetNext(message);
     }
     return found;
@@ -69,6 +76,32 @@ bool MultiQueueConsumer::getNext(Message & message)
     return found;
 }
 
+size_t MultiQueueConsumer::tryGetNextBatch(Message * messages, size_t limit)
+{
+    size_t count = 0;
+    size_t start = nextConsumer();
+    size_t end = start + consumers_.size();
+    for(size_t pos = start; count < limit && !stopping_ && pos < end; ++pos)
+    {
+        if(prefetch_)
+        {
+            consumers_[(pos + 1) % consumers_.size()]->prefetchNext();
+        }
+        count += consumers_[pos % consumers_.size()]->tryGetNextBatch(messages + count, limit - count);
+    }
+    return count;
+}
+
+size_t MultiQueueConsumer::getNextBatch(Message * messages, size_t limit)
+{
+    size_t count = 0;
+    while(count == 0 && limit > 0 && !stopping_)
+    {
+        count = tryGetNextBatch(messages, limit);
+    }
+    return count;
+}
+
 std::ostream & MultiQueueConsumer::writeStats(std::ostream & out) const
 {
     for(ConsumerVec::const_iterator it = consumers_.begin(); it != consumers_.end(); ++it)
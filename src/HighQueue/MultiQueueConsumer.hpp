@@ -19,6 +19,8 @@ namespace HighQueue
         virtual ~MultiQueueConsumer();
 
         /// @brief Add a new queue to the collection we are listening to.
+        /// If the HighQueue was created with CreationParameters::prefetchDistance_ each queue
+        /// prefetches the next queue's entry before it is checked.
         /// @param connection Is the connection to the HighQueue
         void addQueue(ConnectionPtr & connection, const std::string & name = "");
 
@@ -43,6 +45,24 @@ namespace HighQueue
         /// Note: uses the WaitStrategy to wait.
         virtual bool getNext(Message & message);
 
+        /// @brief Get as many messages as are available from all queues, up to a limit.
+        ///
+        /// Each queue is drained with a single read position update.  The queue that
+        /// is checked first rotates from call to call so a busy queue cannot starve the others.
+        ///
+        /// @param messages points to the first of limit messages to be populated. See MessageArray.
+        /// @param limit is the maximum number of messages to return.
+        /// @returns immediately.  The number of messages populated. Zero if no data is available.
+        virtual size_t tryGetNextBatch(Message * messages, size_t limit);
+
+        /// @brief Get as many messages as are available from all queues, up to a limit.
+        /// Wait if none are available.
+        ///
+        /// @param messages points to the first of limit messages to be populated. See MessageArray.
+        /// @param limit is the maximum number of messages to return.
+        /// @returns the number of messages populated.  Zero only if shutting down.
+        virtual size_t getNextBatch(Message * messages, size_t limit);
+
         /// @brief for diagnosing and performance measurements, dump statistics
         virtual std::ostream & writeStats(std::ostream & out)const;
 
@@ -57,6 +77,7 @@ namespace HighQueue
         typedef std::vector<ConsumerPtr> ConsumerVec;
         ConsumerVec consumers_;
         size_t consumerPos_;
+        bool prefetch_;
 
         bool stopping_;
     };
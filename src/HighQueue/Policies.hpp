@@ -0,0 +1,166 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief Compile time policies for BasicProducer and BasicConsumer.
+    ///
+    /// Each policy either fixes a choice at compile time, so the per message code tests a
+    /// constant and the compiler removes the branch, or defers to the HighQueue's configuration.
+    /// The "Configured" policies reproduce the behavior of Producer and Consumer.
+    /// A fixed policy that does not match the HighQueue is reported by the constructor.
+
+    /// @brief Decide solo publishing from Connection::canSolo().
+    struct ConfiguredSolo
+    {
+        static const bool fixed = false;
+        static const bool value = false;
+    };
+
+    /// @brief This is the only producer.  The Connection must agree.
+    struct Solo
+    {
+        static const bool fixed = true;
+        static const bool value = true;
+    };
+
+    /// @brief There may be other producers.  Always safe.
+    struct NotSolo
+    {
+        static const bool fixed = true;
+        static const bool value = false;
+    };
+
+    /// @brief How the other side of the HighQueue waits (consumers for a producer, producers for a consumer.)
+    /// That decides what must be done to wake it.  Decide from its WaitStrategy.
+    struct ConfiguredWait
+    {
+        static const bool fixed = false;
+        static const bool mutex = false;
+        static const bool futex = false;
+    };
+
+    /// @brief The other side only spins, yields and sleeps, so it never needs to be woken.
+    struct PollingWait
+    {
+        static const bool fixed = true;
+        static const bool mutex = false;
+        static const bool futex = false;
+    };
+
+    /// @brief The other side waits on the mutex and condition variable.
+    struct MutexWait
+    {
+        static const bool fixed = true;
+        static const bool mutex = true;
+        static const bool futex = false;
+    };
+
+    /// @brief The other side parks on a futex.
+    struct FutexWait
+    {
+        static const bool fixed = true;
+        static const bool mutex = false;
+        static const bool futex = true;
+    };
+
+    /// @brief Decide from CreationParameters::discardMessagesIfNoConsumer_.
+    struct ConfiguredDiscard
+    {
+        static const bool fixed = false;
+        static const bool value = false;
+    };
+
+    /// @brief Discard messages when the HighQueue is full and no consumer is present.
+    struct Discard
+    {
+        static const bool fixed = true;
+        static const bool value = true;
+    };
+
+    /// @brief Never discard messages.
+    struct NoDiscard
+    {
+        static const bool fixed = true;
+        static const bool value = false;
+    };
+
+    /// @brief Find entries with a modulo.  Works for any entry count.
+    struct AnyEntryCount
+    {
+        static const bool powerOfTwo = false;
+        static Position index(Position position, size_t entryCount, size_t /*mask*/)
+        {
+            return position % entryCount;
+        }
+        static bool accepts(size_t /*entryCount*/)
+        {
+            return true;
+        }
+    };
+
+    /// @brief Find entries with a mask.  The entry count must be a power of two.
+    struct PowerOfTwoEntryCount
+    {
+        static const bool powerOfTwo = true;
+        static Position index(Position position, size_t /*entryCount*/, size_t mask)
+        {
+            return position & mask;
+        }
+        static bool accepts(size_t entryCount)
+        {
+            return entryCount != 0 && (entryCount & (entryCount - 1)) == 0;
+        }
+    };
+
+    namespace Policy
+    {
+        /// @brief The value to use for a boolean policy.
+        template <typename BoolPolicy>
+        inline bool choose(bool configured)
+        {
+            return BoolPolicy::fixed ? BoolPolicy::value : configured;
+        }
+
+        /// @brief Throw if a fixed boolean policy disagrees with the HighQueue.
+        template <typename BoolPolicy>
+        inline void verify(bool configured, const char * what)
+        {
+            if(BoolPolicy::fixed && BoolPolicy::value != configured)
+            {
+                std::stringstream msg;
+                msg << "Compile time policy does not match HighQueue: " << what << " is " << (configured ? "true" : "false");
+                throw std::runtime_error(msg.str());
+            }
+        }
+
+        /// @brief Throw if a fixed wait policy disagrees with the other side's WaitStrategy.
+        template <typename WaitPolicy>
+        inline void verifyWait(bool mutexUsed, bool futexUsed)
+        {
+            if(WaitPolicy::fixed && (WaitPolicy::mutex != mutexUsed || WaitPolicy::futex != futexUsed))
+            {
+                std::stringstream msg;
+                msg << "Compile time wait policy does not match HighQueue: mutex is " << (mutexUsed ? "used" : "not used")
+                    << "; futex is " << (futexUsed ? "used" : "not used");
+                throw std::runtime_error(msg.str());
+            }
+        }
+
+        /// @brief Throw if the entry count policy can't handle the HighQueue.
+        template <typename EntryCountPolicy>
+        inline void verifyEntryCount(size_t entryCount)
+        {
+            if(!EntryCountPolicy::accepts(entryCount))
+            {
+                std::stringstream msg;
+                msg << "Compile time policy requires a power of two entry count.  HighQueue has " << entryCount;
+                throw std::runtime_error(msg.str());
+            }
+        }
+    }
+}
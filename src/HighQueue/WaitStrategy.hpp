@@ -13,6 +13,19 @@ namespace HighQueue
     /// A count of zero means skip that strategy
     /// A count of FOREVER means continue with that strategy -- do not continue to the following strategies.
     ///
+    /// The final stage waits on a mutex/condition variable, or on a futex if useFutex is true.
+    /// Futex waits work across processes and publishers make no system call unless someone is waiting.
+    ///
+    /// An adaptive strategy (see adaptive()) ignores spinCount_ and yieldCount_.  Instead it keeps
+    /// a moving estimate of how long recent waits lasted and spins, then yields, for about twice that
+    /// long -- but never longer than maxSpinPeriod_ and maxYieldPeriod_.  When waits are longer than
+    /// that (an idle feed) it goes straight to the sleep and mutex/futex stages.
+    ///
+    /// Producers only wake a consumer that has reached the mutex/futex stage.  A consumer strategy may
+    /// also coalesce those wakeups (see coalesceWakeups()): each producer then wakes the sleeping consumer
+    /// after wakeCount_ messages or wakeLatency_, whichever comes first.  The consumer checks for itself
+    /// every wakeLatency_ so messages published just before a producer goes idle are not stranded.
+    ///
     /// TODO: Support not implemented fully yet!  Right now it yields forever.
     /// TODO: ultimate timeout and or the ability to cancel for shut down purposes is not implemented yet!
     /// 
@@ -25,20 +38,81 @@ namespace HighQueue
         std::chrono::nanoseconds sleepPeriod_;
         std::chrono::nanoseconds mutexWaitTimeout_;
         bool mutexUsed_;
+        bool futexUsed_;
+        bool adaptive_;
+        std::chrono::nanoseconds maxSpinPeriod_;
+        std::chrono::nanoseconds maxYieldPeriod_;
+        size_t wakeCount_;
+        std::chrono::nanoseconds wakeLatency_;
 
         explicit WaitStrategy(
             size_t spinCount = 0,
             size_t yieldCount = 0,
             size_t sleepCount = FOREVER,
             std::chrono::nanoseconds sleepPeriod = std::chrono::nanoseconds(10),
-            std::chrono::nanoseconds mutexWaitTimeout = std::chrono::seconds(5))
+            std::chrono::nanoseconds mutexWaitTimeout = std::chrono::seconds(5),
+            bool useFutex = false)
         : spinCount_(spinCount)
         , yieldCount_(yieldCount)
         , sleepCount_(sleepCount)
         , sleepPeriod_(sleepPeriod)
         , mutexWaitTimeout_(mutexWaitTimeout)
-        , mutexUsed_(spinCount_ != FOREVER && yieldCount_ != FOREVER && sleepCount_ != FOREVER)
+        , mutexUsed_(!useFutex && spinCount_ != FOREVER && yieldCount_ != FOREVER && sleepCount_ != FOREVER)
+        , futexUsed_(useFutex && spinCount_ != FOREVER && yieldCount_ != FOREVER && sleepCount_ != FOREVER)
+        , adaptive_(false)
+        , maxSpinPeriod_(0)
+        , maxYieldPeriod_(0)
+        , wakeCount_(1)
+        , wakeLatency_(0)
+        {
+        }
+
+        /// @brief Wake a sleeping consumer only every wakeCount messages, but no later than wakeLatency.
+        /// Only applies to the mutex/futex stage of a consumer's strategy.
+        /// @param wakeCount how many messages a producer publishes before it wakes the consumer.
+        /// @param wakeLatency the longest a message waits for the consumer to wake.  Zero means no limit
+        ///        other than mutexWaitTimeout_.
+        WaitStrategy & coalesceWakeups(
+            size_t wakeCount,
+            std::chrono::nanoseconds wakeLatency = std::chrono::microseconds(100))
+        {
+            wakeCount_ = wakeCount == 0 ? 1 : wakeCount;
+            wakeLatency_ = wakeLatency;
+            return *this;
+        }
+
+        /// @brief Are wakeups coalesced?
+        bool coalesced() const
+        {
+            return wakeCount_ > 1 && (mutexUsed_ || futexUsed_);
+        }
+
+        /// @brief How long the consumer sleeps before it checks for messages itself.
+        std::chrono::nanoseconds parkPeriod() const
+        {
+            if(coalesced() && wakeLatency_.count() != 0 && wakeLatency_ < mutexWaitTimeout_)
+            {
+                return wakeLatency_;
+            }
+            return mutexWaitTimeout_;
+        }
+
+        /// @brief Construct a strategy that chooses its spin and yield periods from recent waits.
+        /// @param maxSpinPeriod is the longest a single wait will spin.
+        /// @param maxYieldPeriod is the longest a single wait will spin and yield before sleeping.
+        static WaitStrategy adaptive(
+            std::chrono::nanoseconds maxSpinPeriod = std::chrono::microseconds(20),
+            std::chrono::nanoseconds maxYieldPeriod = std::chrono::microseconds(200),
+            size_t sleepCount = 0,
+            std::chrono::nanoseconds sleepPeriod = std::chrono::nanoseconds(10),
+            std::chrono::nanoseconds mutexWaitTimeout = std::chrono::seconds(5),
+            bool useFutex = false)
         {
+            WaitStrategy strategy(0, 0, sleepCount, sleepPeriod, mutexWaitTimeout, useFutex);
+            strategy.adaptive_ = true;
+            strategy.maxSpinPeriod_ = maxSpinPeriod;
+            strategy.maxYieldPeriod_ = maxYieldPeriod;
+            return strategy;
         }
     };
 }
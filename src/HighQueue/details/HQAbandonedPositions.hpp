@@ -0,0 +1,81 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+#include <Common/SpinLock.hpp>
+
+namespace HighQueue
+{
+    /// @brief Positions reserved by lock-free producers that stopped while no consumer was attached.
+    ///
+    /// A stopping lock-free producer stamps the Positions it reserved SKIP, but it can't do that while
+    /// the entries still hold unread messages.  With no consumer to make room it records the Positions
+    /// here instead, and the consumer stamps them when it reaches them.  Only these rare paths use the
+    /// table, under its own spin lock.
+    struct HighQAbandonedPositions
+    {
+        static const size_t RangeCount = 8;
+
+        SpinLock spinLock_;
+        /// @brief How many ranges are in use.  Lets the consumer skip the lock when there are none.
+        std::atomic<uint32_t> count_;
+        /// @brief [start_[n], end_[n]) were abandoned.  An end_ of zero marks a free range.
+        Position start_[RangeCount];
+        Position end_[RangeCount];
+
+        HighQAbandonedPositions()
+            : count_(0)
+        {
+            for(size_t nRange = 0; nRange < RangeCount; ++nRange)
+            {
+                start_[nRange] = 0;
+                end_[nRange] = 0;
+            }
+        }
+
+        /// @brief Record [start, end) for the consumer to stamp.
+        /// @returns false if every range is in use.
+        bool record(Position start, Position end)
+        {
+            SpinLock::Guard guard(spinLock_);
+            for(size_t nRange = 0; nRange < RangeCount; ++nRange)
+            {
+                if(end_[nRange] == 0)
+                {
+                    start_[nRange] = start;
+                    end_[nRange] = end;
+                    count_.fetch_add(1, std::memory_order_release);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief Was position abandoned?  If so the caller stamps it SKIP.
+        /// A range is forgotten once its last Position has been taken.
+        bool take(Position position)
+        {
+            if(count_.load(std::memory_order_acquire) == 0)
+            {
+                return false;
+            }
+            SpinLock::Guard guard(spinLock_);
+            for(size_t nRange = 0; nRange < RangeCount; ++nRange)
+            {
+                if(start_[nRange] <= position && position < end_[nRange])
+                {
+                    if(position + 1 == end_[nRange])
+                    {
+                        start_[nRange] = 0;
+                        end_[nRange] = 0;
+                        count_.fetch_sub(1, std::memory_order_release);
+                    }
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+}
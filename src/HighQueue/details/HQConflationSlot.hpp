@@ -0,0 +1,44 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief Remembers the latest Position published for a key in a conflating HighQueue.
+    ///
+    /// The slots are an open addressed hash table.  Only producers use them, and only
+    /// while holding the reserve spin lock (or as the solo producer.)  A slot whose Position
+    /// has been consumed is deleted by backward shifting when a probe passes it.
+    struct HighQConflationSlot
+    {
+        /// @brief No message is ever published at this Position, so the slot is empty.
+        static const Position Unused = 0;
+
+        /// @brief The most slots a probe examines.  A key that finds no room is published without conflating.
+        static const size_t MaxProbe = 32;
+
+        ConflationKey key_;
+        Position position_;
+
+        HighQConflationSlot()
+            : key_(0)
+            , position_(Unused)
+        {
+        }
+
+        /// @brief The number of slots for a HighQueue with entryCount entries.
+        /// A power of two with room to spare since at most entryCount slots are in use at once.
+        static size_t slotCount(size_t entryCount)
+        {
+            size_t count = 1;
+            while(count < entryCount * 2)
+            {
+                count <<= 1;
+            }
+            return count;
+        }
+    };
+}
@@ -18,7 +18,9 @@
 ///   Producers create and publish data into the HighQueue.   
 ///   Consumers accept and process data from the HighQueue.
 ///
-/// Each instance of an HighQueue supports multiple Producers, but only a single Consumer.
+/// Each instance of an HighQueue supports multiple Producers, but only a single Consumer unless it was created
+/// with CreationParameters::competingConsumers_ or CreationParameters::subscriberCount_.  Competing Consumers take
+/// turns so each message is delivered to exactly one of them.  Subscribers each see every message.
 ///
 /// Client API:
 ///
@@ -96,8 +98,77 @@
 /// of letting different clients in different processes work effectively with an HighQueue contained in shared memory 
 /// -- even if the shared memory is mapped into different virtual memory addresses in different processes.
 ///
-/// Caveat: At the time this documentation is being written the Shared Memory suport is incomplete and there are a few issues
-/// to resolve before it goes live.
+/// Shared memory HighQueues (Connection::openOrCreateShared) place the header, the entries, and the memory pool in a
+/// single named segment.  The one exception to "offsets everywhere" is Message::container_, which is an address; Producers
+/// and Consumers of a shared HighQueue re-resolve it (Message::rebase) each time a block is swapped out of an entry.
+/// Clients of a shared HighQueue wait on a futex rather than the wait mutex, so a process that dies leaves nothing
+/// locked -- except the reserve spin lock, if it dies while publishing without lockFreeProducers_.
+///
+/// Multiple Producers
+///
+/// By default multiple producers take turns using a spin lock.  If the HighQueue is created with
+/// CreationParameters::lockFreeProducers_ each producer claims an entry by atomically incrementing the reserve position
+/// and fills it without waiting for the others.  Entries may therefore be completed out of order, so each producer stamps
+/// HighQEntry::sequence_ with the entry's Position as its last step.  The consumer reads an entry only when the stamp
+/// matches the Position it is waiting for.  A producer that stops stamps the Positions it reserved SKIP.  If they still
+/// hold unread messages and no consumer is attached it records them in HighQAbandonedPositions for the next consumer.
+///
+/// Multiple Consumers
+///
+/// When consumers compete, each one claims entries by a compare-and-swap on a separate claim position then
+/// stamps HighQEntry::consumed_ with the entry's Position once the message has been moved out of the entry.
+/// Consumers may finish out of order, but the read position only advances across entries whose stamp
+/// matches, so entries are returned to the producers in order.  Any consumer may advance the read position
+/// past entries claimed by the others.
+///
+/// A broadcast HighQueue (CreationParameters::subscriberCount_) delivers every message to each subscriber.  Every
+/// subscriber has its own position (HighQSubscriberPosition) and reads entries in place rather than swapping
+/// messages out of them.  The read position is kept at the slowest subscriber's position so the producers will not
+/// reuse an entry until every subscriber has passed it.
+///
+/// Overwriting
+///
+/// A HighQueue created with CreationParameters::overwriteWhenFull_ never makes a producer wait.  When it is full the
+/// producer reuses the oldest entry whether or not it has been read.  Before writing an entry the producer stamps
+/// HighQEntry::sequence_ with HighQEntry::Writing, copies the message into the entry's own block, and stamps the entry's
+/// Position when it is done.  Neither side swaps blocks, so an entry's block never changes under a consumer that
+/// is copying it.  The consumer copies the message out of the entry, then checks the stamp again.  If the stamp
+/// changed the consumer was lapped: it discards the copy, moves its read position forward and counts the lost
+/// messages as overruns.
+///
+/// Conflating
+///
+/// A HighQueue created with CreationParameters::conflateByKey_ keeps at most one unconsumed message per key.  Producers
+/// remember the Position of the latest message published for each key in a table of HighQConflationSlots.  If that
+/// message has not been consumed the producer replaces it in place rather than publishing a new entry.  Producer and
+/// consumer both take the entry by changing HighQEntry::sequence_ from the entry's Position to HighQEntry::Writing.
+/// Whoever gets there first wins: a producer that loses publishes a new entry, and a consumer waits for the producer
+/// to restore the stamp.  Slots whose message has been consumed are deleted as producers probe past them, and a key
+/// that finds no room near its home slot is published without conflating.
+///
+/// Priority lanes
+///
+/// A HighQueue created with CreationParameters::priorityLanes_ has up to three small rings of entries (HighQPriorityLanes)
+/// besides its own.  Each has its own read and publish Positions.  The consumer checks the lanes, highest first, before
+/// it reads the HighQueue's own entries, so a Shutdown or Heartbeat published to a lane is delivered next no matter how
+/// much data is queued.  Producers publish to a lane under the lane's spin lock.  The single consumer reads the lanes
+/// without locking, exactly as it reads the HighQueue's own entries.
+///
+/// Lazy read position
+///
+/// With CreationParameters::readPositionInterval_ the consumer keeps its read position privately and publishes it
+/// every few entries, or when it runs out of messages.  Instead it stores each Position it takes in
+/// HighQEntry::consumed_, a cache line it has just used anyway.  A producer that runs out of space it knows is free
+/// checks the entry it will need readPositionInterval_ entries from now.  Only if that entry is still in use does it
+/// read the consumer's read position.
+///
+/// Statistics
+///
+/// Every HighQueue holds a HighQStatistics block next to its header.  Each Producer and Consumer claims one of its
+/// cache-line slots and counts publishes, fulls, spins, yields, sleeps and waits there with relaxed stores, so the
+/// counters cost no more than the private ones they replace.  A shared HighQueue, or a local one created with
+/// CreationParameters::publishStatistics_, lives in named shared memory where the hqstat application can map it
+/// read-only and report rates while the program runs.
 ///
 /// Avoiding Memory Moves.
 ///
@@ -119,7 +190,8 @@
 /// In general the goal is to have a single writer for each cache line (although multiple readers are allowed.)  On the 
 /// other hand, some high performance message passing systems pay close attention to the effect of cache-line prefetch.
 /// In my tests, this effect is minor or disappears completely in a practical implementation (at least in C++), so it 
-/// was ignored.  
+/// was ignored.  A consumer can ask for software prefetch of the entries (and message blocks) ahead of it when they
+/// are too big for the cache.  It is off by default.  See CreationParameters::prefetchDistance_.
 /// 
 /// Java developers of high performance systems report encountering issues related to having too many object references 
 /// which must be visited by the garbage collector.   If the offset approach used in the HighQueue can be mapped 
@@ -135,6 +207,7 @@ namespace HighQueue
     typedef uint32_t Signature;
     typedef uint64_t Position;
     typedef std::atomic<Position> AtomicPosition;
+    typedef uint64_t ConflationKey;
     typedef std::mutex Mutex;
     typedef std::condition_variable ConditionVariable;
     typedef std::unique_lock<Mutex> MutexGuard;
@@ -9,9 +9,20 @@
 
 namespace HighQueue
 {
+    /// @brief One slot in the HighQueue.
+    ///
+    /// With 64 bit pointers the Message fills the first cache line and the control fields
+    /// start the second.  The rest of the second line holds small payloads inline
+    /// (see CreationParameters::inlinePayloads_) so they never need a memory block of their own.
     PRE_CACHE_ALIGN
     struct HighQEntry
     {
+        /// @brief The largest payload that can be stored in the entry itself.
+        static const size_t InlineCapacity = 40;
+        /// @brief Stored in sequence_ while a producer overwrites the entry (CreationParameters::overwriteWhenFull_)
+        /// or while a message in a conflating HighQueue is replaced or taken (CreationParameters::conflateByKey_).
+        static const Position Writing = ~Position(0);
+
         enum class Status : uint8_t
         {
             OK,
@@ -20,11 +31,25 @@ namespace HighQueue
         };
         Message message_;
         Status status_;
+        /// @brief If nonzero the payload is in inline_ rather than in message_'s memory block.
+        /// message_ still carries the type, timestamp and sequence.
+        uint8_t inlineUsed_;
+        /// @brief The Position that was most recently published to this entry.
+        /// Stored last, with release semantics, so a consumer that sees its own
+        /// read Position here knows the entry is complete.
+        std::atomic<Position> sequence_;
+        /// @brief The Position most recently consumed from this entry by one of several competing consumers.
+        /// The read position advances past an entry only when this matches.
+        std::atomic<Position> consumed_;
+        byte_t inline_[InlineCapacity];
 
         template <typename Allocator>
         HighQEntry(Allocator & allocator)
             : message_(allocator)
             , status_(Status::EMPTY)
+            , inlineUsed_(0)
+            , sequence_(0)
+            , consumed_(0)
         {
         }
 
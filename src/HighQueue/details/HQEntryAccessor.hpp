@@ -6,31 +6,42 @@
 #include <HighQueue/details/HQDefinitions.hpp>
 #include <HighQueue/details/HQEntry.hpp>
 #include <HighQueue/details/HQResolver.hpp>
+#include <HighQueue/Policies.hpp>
 
 namespace HighQueue
 {
-    class HighQEntryAccessor
+    /// @brief Find the entry for a Position.
+    /// @tparam EntryCountPolicy decides how a Position is mapped into the ring of entries.  See Policies.hpp
+    template <typename EntryCountPolicy>
+    class HighQBasicEntryAccessor
     {
     public:
-        HighQEntryAccessor(HighQResolver & resolver, Offset entryOffset, size_t entryCount);
+        HighQBasicEntryAccessor(HighQResolver & resolver, Offset entryOffset, size_t entryCount);
 
         HighQEntry & operator[](Position index)const;
     private:
         HighQEntry * entries_;
         size_t entryCount_;
+        size_t mask_;
     };
 
+    typedef HighQBasicEntryAccessor<AnyEntryCount> HighQEntryAccessor;
+
+    template <typename EntryCountPolicy>
     inline
-    HighQEntryAccessor::HighQEntryAccessor(HighQResolver & resolver, Offset entryOffset, size_t entryCount)
+    HighQBasicEntryAccessor<EntryCountPolicy>::HighQBasicEntryAccessor(HighQResolver & resolver, Offset entryOffset, size_t entryCount)
         : entries_(resolver.resolve<HighQEntry>(entryOffset))
         , entryCount_(entryCount)
+        , mask_(entryCount - 1)
     {
+        Policy::verifyEntryCount<EntryCountPolicy>(entryCount);
     }
 
+    template <typename EntryCountPolicy>
     inline
-    HighQEntry & HighQEntryAccessor::operator[](Position index)const
+    HighQEntry & HighQBasicEntryAccessor<EntryCountPolicy>::operator[](Position index)const
     {
-        return entries_[index % entryCount_];
+        return entries_[EntryCountPolicy::index(index, entryCount_, mask_)];
     }
 
 } // HighQueue
@@ -0,0 +1,43 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include <Common/HighQueuePch.hpp>
+#include "HQFutex.hpp"
+
+#ifndef _WIN32
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#endif // _WIN32
+
+using namespace HighQueue;
+
+#ifndef _WIN32
+// Note: FUTEX_PRIVATE_FLAG is not used so the word can be shared between processes.
+bool HighQFutex::park(uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    auto nanoseconds = timeout.count();
+    struct timespec limit;
+    limit.tv_sec = time_t(nanoseconds / 1000000000LL);
+    limit.tv_nsec = long(nanoseconds % 1000000000LL);
+    auto result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word_), FUTEX_WAIT, expected, &limit, 0, 0);
+    // EAGAIN: the word changed before we slept.  EINTR: a signal arrived.  Either way let the caller look again.
+    return result == 0 || errno != ETIMEDOUT;
+}
+
+void HighQFutex::wakeAll()
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word_), FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+#else // _WIN32
+bool HighQFutex::park(uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    throw std::runtime_error("Futex waits are not supported on this platform.");
+}
+
+void HighQFutex::wakeAll()
+{
+}
+#endif // _WIN32
@@ -0,0 +1,69 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <Common/HighQueue_Export.hpp>
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief A 32 bit word that a thread can park on until another thread (or process) unparks it.
+    ///
+    /// The low bit is set while someone may be parked.  The rest of the word is a generation count
+    /// that changes on every unpark, so a waiter that missed the unpark does not go to sleep.
+    /// unpark() does not make a system call unless the low bit is set.
+    /// Because the word contains no addresses it works in shared memory.
+    struct HighQueue_Export HighQFutex
+    {
+        static const uint32_t WaiterBit = 1;
+
+        std::atomic<uint32_t> word_;
+
+        HighQFutex()
+            : word_(0)
+        {}
+
+        /// @brief Announce that the caller is about to park.
+        /// The caller should check its condition once more before calling park().
+        /// @returns the value to pass to park()
+        uint32_t prepareToPark()
+        {
+            return word_.fetch_or(WaiterBit) | WaiterBit;
+        }
+
+        /// @brief Wait until unpark() is called or the timeout expires.
+        /// @param expected the value returned by prepareToPark()
+        /// @returns false if the timeout expired.
+        bool park(uint32_t expected, std::chrono::nanoseconds timeout);
+
+        /// @brief Wake any parked threads.  Cheap if nobody is parked.
+        /// Call after publishing the change the parked threads are waiting for.
+        void unpark()
+        {
+            std::atomic_thread_fence(std::memory_order::memory_order_seq_cst);
+            uint32_t word = word_.load(std::memory_order::memory_order_relaxed);
+            if((word & WaiterBit) != 0 && word_.compare_exchange_strong(word, word + 1))
+            {
+                wakeAll();
+            }
+        }
+
+        /// @brief Might someone be parked?
+        /// Call after a seq_cst fence that follows publishing the change they are waiting for.
+        bool mayBeParked() const
+        {
+            return (word_.load(std::memory_order::memory_order_relaxed) & WaiterBit) != 0;
+        }
+
+        /// @brief Wake any parked threads whether or not they have announced themselves.
+        /// Used when shutting down.
+        void unparkAll()
+        {
+            word_.fetch_add(2);
+            wakeAll();
+        }
+    private:
+        void wakeAll();
+    };
+}
@@ -8,33 +8,91 @@
 #include <HighQueue/details/HQResolver.hpp>
 #include <HighQueue/details/HQEntry.hpp>
 #include <HighQueue/details/HQReservePosition.hpp>
+#include <HighQueue/details/HQSubscriberPosition.hpp>
+#include <HighQueue/details/HQConflationSlot.hpp>
+#include <HighQueue/details/HQAbandonedPositions.hpp>
+#include <HighQueue/details/HQPriorityLane.hpp>
 #include <HighQueue/details/HQMemoryBlockPool.hpp>
+#include <HighQueue/Policies.hpp>
 
 using namespace HighQueue;
 
+namespace
+{
+    size_t effectiveReadPositionInterval(const CreationParameters & parameters)
+    {
+        if(parameters.readPositionInterval_ <= 1
+            || parameters.competingConsumers_
+            || parameters.subscriberCount_ != 0
+            || parameters.overwriteWhenFull_
+            || parameters.conflateByKey_)
+        {
+            return 1;
+        }
+        return std::min(parameters.readPositionInterval_, parameters.entryCount_);
+    }
+
+    /// Discarding, overwriting and conflating producers publish under the reserve spin lock.
+    /// The consumer must not expect lock-free stamps from them.
+    bool effectiveLockFreeProducers(const CreationParameters & parameters)
+    {
+        bool singleConsumer = !parameters.competingConsumers_ && parameters.subscriberCount_ == 0;
+        return parameters.lockFreeProducers_
+            && !(parameters.discardMessagesIfNoConsumer_ && singleConsumer)
+            && !(parameters.overwriteWhenFull_ && singleConsumer)
+            && !(parameters.conflateByKey_ && singleConsumer);
+    }
+}
+
 HQHeader::HQHeader(
     const std::string & name,
     HQAllocator & allocator,
     const CreationParameters & parameters,
-    HQMemoryBlockPool * pool)
+    HQMemoryBlockPool * pool,
+    bool processShared)
 : signature_(InitializingSignature)
 , version_(Version)
-, discardMessagesIfNoConsumer_(parameters.discardMessagesIfNoConsumer_)
+, discardMessagesIfNoConsumer_(parameters.discardMessagesIfNoConsumer_ && !parameters.competingConsumers_ && parameters.subscriberCount_ == 0)
+, lockFreeProducers_(effectiveLockFreeProducers(parameters))
+, competingConsumers_(parameters.competingConsumers_)
+, subscriberCount_(parameters.subscriberCount_)
+, inlinePayloads_(parameters.inlinePayloads_ && parameters.subscriberCount_ == 0)
+, overwriteWhenFull_(parameters.overwriteWhenFull_ && !parameters.competingConsumers_ && parameters.subscriberCount_ == 0)
+, conflateByKey_(parameters.conflateByKey_ && !parameters.competingConsumers_ && parameters.subscriberCount_ == 0 && !overwriteWhenFull_)
+, priorityLaneCount_(HighQPriorityLane::laneCount(parameters))
 , producerWaitStrategy_(parameters.producerWaitStrategy_)
 , consumerWaitStrategy_(parameters.consumerWaitStrategy_)
 , entryCount_(parameters.entryCount_)
+, readPositionInterval_(effectiveReadPositionInterval(parameters))
+, prefetchDistance_(parameters.entryCount_ > 1 ? std::min(parameters.prefetchDistance_, parameters.entryCount_ - 1) : 0)
 , entries_(0)
+, maxEntryCount_(HighQRing::maxEntryCount(parameters))
+, powerOfTwoEntryCount_(false)
+, rings_()
+, ringGeneration_(0)
+, resizeState_(ResizeIdle)
 , readPosition_(0)
 , publishPosition_(0)
 , reservePosition_(0)
+, claimPosition_(0)
+, subscriberPositions_(0)
+, abandonedPositions_(0)
+, conflationSlots_(0)
+, conflationSlotCount_(0)
+, priorityLanes_(0)
+, statistics_(0)
 , memoryPool_(0)
 , consumerPresent_(false)
 , producersPresent_(0)
+, consumersPresent_(0)
+, subscribersAttached_(0)
 , waitMutex_()
 , producerWaitConditionVariable_()
 , consumerWaitConditionVariable_()
 , producerWaiting_(false)
 , consumerWaiting_(false)
+, producerFutex_()
+, consumerFutex_()
 {
     std::memset(name_, '\0', sizeof(name_));
     size_t bytesToCopy = name.size();
@@ -44,9 +102,30 @@ HQHeader::HQHeader(
     }
     std::memcpy(name_, name.data(), bytesToCopy);
 
+    if(competingConsumers_ && subscriberCount_ != 0)
+    {
+        throw std::runtime_error("A HighQueue cannot have both competing consumers and subscribers.");
+    }
+    if(priorityLaneCount_ > HighQPriorityLane::MaxLanes)
+    {
+        throw std::runtime_error("A HighQueue can have at most 3 priority lanes.");
+    }
+    if(priorityLaneCount_ != 0 && parameters.priorityEntryCount_ == 0)
+    {
+        throw std::runtime_error("A HighQueue with priority lanes needs at least one entry in each lane.");
+    }
+
     HighQResolver resolver(this);
 
-    entries_ = allocator.allocate(HighQEntry::alignedSize() * entryCount_, CacheLineSize);
+    // A resizable HighQueue reserves room for the largest ring in each area.
+    size_t areaEntryCount = maxEntryCount_ != 0 ? maxEntryCount_ : entryCount_;
+    entries_ = allocator.allocate(HighQEntry::alignedSize() * areaEntryCount, CacheLineSize);
+    rings_[0].entries_ = entries_;
+    rings_[0].entryCount_ = entryCount_;
+    if(maxEntryCount_ != 0)
+    {
+        rings_[1].entries_ = allocator.allocate(HighQEntry::alignedSize() * areaEntryCount, CacheLineSize);
+    }
     readPosition_ = allocator.allocate(CacheLineSize, CacheLineSize);
     auto readPosition = resolver.resolve<AtomicPosition>(readPosition_);
     *readPosition = entryCount_;
@@ -59,9 +138,53 @@ HQHeader::HQHeader(
     auto reservePosition = resolver.resolve<HighQReservePosition>(reservePosition_);
     new (reservePosition) HighQReservePosition(entryCount_);
 //    reservePosition->reservePosition_ = entryCount_;
+
+    if(lockFreeProducers_)
+    {
+        abandonedPositions_ = allocator.allocate(sizeof(HighQAbandonedPositions), CacheLineSize);
+        new (resolver.resolve<HighQAbandonedPositions>(abandonedPositions_)) HighQAbandonedPositions;
+    }
+
+    claimPosition_ = allocator.allocate(CacheLineSize, CacheLineSize);
+    auto claimPosition = resolver.resolve<AtomicPosition>(claimPosition_);
+    *claimPosition = entryCount_;
+
+    if(subscriberCount_ != 0)
+    {
+        subscriberPositions_ = allocator.allocate(sizeof(HighQSubscriberPosition) * subscriberCount_, CacheLineSize);
+        auto subscriberPositions = resolver.resolve<HighQSubscriberPosition>(subscriberPositions_);
+        for(size_t nSubscriber = 0; nSubscriber < subscriberCount_; ++nSubscriber)
+        {
+            new (subscriberPositions + nSubscriber) HighQSubscriberPosition(entryCount_);
+        }
+    }
+    if(conflateByKey_)
+    {
+        conflationSlotCount_ = HighQConflationSlot::slotCount(entryCount_);
+        conflationSlots_ = allocator.allocate(sizeof(HighQConflationSlot) * conflationSlotCount_, CacheLineSize);
+        auto conflationSlots = resolver.resolve<HighQConflationSlot>(conflationSlots_);
+        for(size_t nSlot = 0; nSlot < conflationSlotCount_; ++nSlot)
+        {
+            new (conflationSlots + nSlot) HighQConflationSlot;
+        }
+    }
+    if(priorityLaneCount_ != 0)
+    {
+        priorityLanes_ = allocator.allocate(sizeof(HighQPriorityLane) * priorityLaneCount_, CacheLineSize);
+        auto lanes = resolver.resolve<HighQPriorityLane>(priorityLanes_);
+        for(size_t nLane = 0; nLane < priorityLaneCount_; ++nLane)
+        {
+            auto lane = new (lanes + nLane) HighQPriorityLane(parameters.priorityEntryCount_);
+            lane->entries_ = allocator.allocate(HighQEntry::alignedSize() * lane->entryCount_, CacheLineSize);
+        }
+    }
+    statistics_ = allocator.allocate(sizeof(HighQStatistics), CacheLineSize);
+    new (resolver.resolve<HighQStatistics>(statistics_)) HighQStatistics;
+
     if(pool == 0)
     {
-        auto messagePoolSize = HQMemoryBlockPool::spaceNeeded(parameters.messageSize_, parameters.messageCount_);
+        auto messagePoolSize = HQMemoryBlockPool::spaceNeeded(parameters.messageSize_,
+            parameters.messageCount_ + HighQPriorityLane::entriesNeeded(parameters) + HighQRing::entriesNeeded(parameters));
         memoryPool_ = allocator.allocate(messagePoolSize, CacheLineSize);
         pool = new (resolver.resolve<HQMemoryBlockPool>(memoryPool_))
             HQMemoryBlockPool(messagePoolSize, parameters.messageSize_);
@@ -69,9 +192,37 @@ HQHeader::HQHeader(
 
     allocateInternalMessages(pool);
 
+    if(processShared)
+    {
+        makeProcessShared();
+    }
+
+    std::atomic_thread_fence(std::memory_order::memory_order_release);
     signature_ = LiveSignature;
 }
 
+void HQHeader::makeProcessShared()
+{
+#ifdef _WIN32
+    throw std::runtime_error("Process shared HighQueues are not supported on this platform.");
+#else // _WIN32
+    // std::mutex and std::condition_variable are thin wrappers around pthread objects.
+    // Reinitialize the underlying objects with the process-shared attribute.
+    pthread_mutexattr_t mutexAttributes;
+    pthread_mutexattr_init(&mutexAttributes);
+    pthread_mutexattr_setpshared(&mutexAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(waitMutex_.native_handle(), &mutexAttributes);
+    pthread_mutexattr_destroy(&mutexAttributes);
+
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setpshared(&conditionAttributes, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(producerWaitConditionVariable_.native_handle(), &conditionAttributes);
+    pthread_cond_init(consumerWaitConditionVariable_.native_handle(), &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+#endif // _WIN32
+}
+
 void HQHeader::allocateInternalMessages(HQMemoryBlockPool * pool)
 {
     HighQResolver resolver(this);
@@ -82,18 +233,123 @@ void HQHeader::allocateInternalMessages(HQMemoryBlockPool * pool)
         HighQEntry & entry = entryPointer[nEntry];
         new (&entry) HighQEntry(pool);
     }
+    rings_[0].constructed_ = entryCount_;
+    auto lanes = resolver.resolve<HighQPriorityLane>(priorityLanes_);
+    for(size_t nLane = 0; nLane < priorityLaneCount_; ++nLane)
+    {
+        auto laneEntries = resolver.resolve<HighQEntry>(lanes[nLane].entries_);
+        for(size_t nEntry = 0; nEntry < lanes[nLane].entryCount_; ++nEntry)
+        {
+            new (laneEntries + nEntry) HighQEntry(pool);
+        }
+    }
 }
 
 void HQHeader::releaseInternalMessages()
 {
     HighQResolver resolver(this);
-    auto entryPointer = resolver.resolve<HighQEntry>(entries_);
+    for(auto & ring : rings_)
+    {
+        auto entryPointer = resolver.resolve<HighQEntry>(ring.entries_);
+        for(size_t nEntry = 0; nEntry < ring.constructed_; ++nEntry)
+        {
+            HighQEntry & entry = entryPointer[nEntry];
+            Message & message = entry.message_;
+            message.release();
+        }
+        ring.constructed_ = 0;
+    }
+    auto lanes = resolver.resolve<HighQPriorityLane>(priorityLanes_);
+    for(size_t nLane = 0; nLane < priorityLaneCount_; ++nLane)
+    {
+        auto laneEntries = resolver.resolve<HighQEntry>(lanes[nLane].entries_);
+        for(size_t nEntry = 0; nEntry < lanes[nLane].entryCount_; ++nEntry)
+        {
+            laneEntries[nEntry].message_.release();
+        }
+    }
+}
 
-    for(size_t nEntry = 0; nEntry < entryCount_; ++nEntry)
+
+void HQHeader::requirePowerOfTwoEntryCount()
+{
+    // Sequentially consistent so either resize() sees the flag or this sees the resize it let through.
+    powerOfTwoEntryCount_ = true;
+    while(resizeState_ == ResizePreparing)
     {
-        HighQEntry & entry = entryPointer[nEntry];
-        Message & message = entry.message_;
-        message.release();
+        std::this_thread::yield();
+    }
+    if(resizeState_ == ResizeReady)
+    {
+        const HighQRing & pending = rings_[(ringGeneration_ + 1) % 2];
+        if(!PowerOfTwoEntryCount::accepts(pending.entryCount_))
+        {
+            std::stringstream msg;
+            msg << "HighQueue " << name_ << " is being resized to " << pending.entryCount_ << " entries.  Compile time policy requires a power of two.";
+            throw std::runtime_error(msg.str());
+        }
     }
 }
 
+bool HQHeader::resize(size_t entryCount, HQMemoryBlockPool * pool)
+{
+    if(maxEntryCount_ == 0)
+    {
+        throw std::runtime_error("This HighQueue was not created with a maxEntryCount_ so it cannot be resized.");
+    }
+    if(entryCount == 0 || entryCount > maxEntryCount_)
+    {
+        std::stringstream msg;
+        msg << "HighQueue " << name_ << " cannot be resized to " << entryCount << " entries.  The limit is " << maxEntryCount_;
+        throw std::runtime_error(msg.str());
+    }
+    uint32_t expected = ResizeIdle;
+    if(!resizeState_.compare_exchange_strong(expected, ResizePreparing))
+    {
+        return false;
+    }
+    if(powerOfTwoEntryCount_ && !PowerOfTwoEntryCount::accepts(entryCount))
+    {
+        // Checked after taking the resize state.  See requirePowerOfTwoEntryCount().
+        resizeState_ = ResizeIdle;
+        std::stringstream msg;
+        msg << "HighQueue " << name_ << " cannot be resized to " << entryCount << " entries.  A client requires a power of two.";
+        throw std::runtime_error(msg.str());
+    }
+    HighQResolver resolver(this);
+    auto generation = ringGeneration_.load(std::memory_order_acquire);
+    Position readPosition = resolver.resolve<AtomicPosition>(readPosition_)->load(std::memory_order_acquire);
+    if(readPosition < rings_[generation % 2].start_)
+    {
+        // The consumers still need the entries in the idle area.
+        resizeState_ = ResizeIdle;
+        return false;
+    }
+
+    HighQRing & ring = rings_[(generation + 1) % 2];
+    auto entryPointer = resolver.resolve<HighQEntry>(ring.entries_);
+    try
+    {
+        for(size_t nEntry = 0; nEntry < ring.constructed_; ++nEntry)
+        {
+            // The block may have been put into the entry by another process.
+            Message & message = entryPointer[nEntry].message_;
+            message.rebase(pool);
+            message.release();
+        }
+        ring.constructed_ = 0;
+        for(size_t nEntry = 0; nEntry < entryCount; ++nEntry)
+        {
+            new (entryPointer + nEntry) HighQEntry(pool);
+            ring.constructed_ = nEntry + 1;
+        }
+    }
+    catch(...)
+    {
+        resizeState_ = ResizeIdle;
+        throw;
+    }
+    ring.entryCount_ = entryCount;
+    resizeState_.store(ResizeReady, std::memory_order_release);
+    return true;
+}
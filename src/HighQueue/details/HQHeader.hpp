@@ -7,6 +7,9 @@
 #include <HighQueue/details/HQDefinitions.hpp>
 #include <HighQueue/details/HQMemoryBlockPoolFwd.hpp>
 #include <HighQueue/details/HQAllocator.hpp>
+#include <HighQueue/details/HQFutex.hpp>
+#include <HighQueue/details/HQRing.hpp>
+#include <HighQueue/details/HQStatistics.hpp>
 #include <HighQueue/CreationParameters.hpp>
 
 namespace HighQueue
@@ -24,6 +27,11 @@ namespace HighQueue
         const static Signature DeadSignature = 0xFEEDD1ED;
         const static uint8_t Version = 0;
 
+        /// @brief Values for resizeState_
+        const static uint32_t ResizeIdle = 0;
+        const static uint32_t ResizePreparing = 1;
+        const static uint32_t ResizeReady = 2;
+
         /// @brief Verify that this is a HighQueue and that it is properly initialized
         Signature signature_;
         
@@ -35,6 +43,31 @@ namespace HighQueue
         
         /// @brief If true, when the queue is full and no consumer is available messages will be discarded.
         bool discardMessagesIfNoConsumer_;
+
+        /// @brief If true, producers claim entries by incrementing the reserve position.
+        /// Consumers must check HighQEntry::sequence_ to find out when an entry is complete.
+        /// Cleared when discarding, overwriting or conflating since those producers use the spin lock.
+        bool lockFreeProducers_;
+
+        /// @brief If true, several consumers claim entries by incrementing the claim position.
+        /// The read position advances (in order) only when claimed entries have been consumed.
+        bool competingConsumers_;
+
+        /// @brief If nonzero every message is delivered to each of this many subscribers.
+        size_t subscriberCount_;
+
+        /// @brief If true, small payloads are copied into HighQEntry::inline_ rather than swapping blocks.
+        bool inlinePayloads_;
+
+        /// @brief If true, producers never wait.  A full HighQueue overwrites its oldest entries.
+        /// Producers mark each entry while they write it so the consumer can tell it was lapped.
+        bool overwriteWhenFull_;
+
+        /// @brief If true, a message replaces an unconsumed message with the same key.
+        bool conflateByKey_;
+
+        /// @brief How many priority lanes are read ahead of this HighQueue's own entries.
+        size_t priorityLaneCount_;
         
         /// @brief A strategy to control how the producer waits when the queue is full
         WaitStrategy producerWaitStrategy_;
@@ -43,13 +76,41 @@ namespace HighQueue
         WaitStrategy consumerWaitStrategy_;
         
         /// @brief What is the maximum number of messages this queue can hold?
+        /// For a resizable HighQueue this describes the current ring.  Clients use rings_.
         size_t entryCount_;
         
+        /// @brief How many entries the consumer takes before it publishes its read position.
+        /// When more than one the consumer stores each Position it takes in HighQEntry::consumed_
+        /// so producers can tell the entry is free before the read position says so.
+        size_t readPositionInterval_;
+
+        /// @brief How far ahead of the entry it is taking a single consumer prefetches.
+        /// See CreationParameters::prefetchDistance_.
+        size_t prefetchDistance_;
+
         /// @brief offset to the entries that contain the messages: HQEntry[entryCount_]
         ///
         /// This array is indexed by [Position % entryCount_].  It can be thought of as an infinite vector
         /// where only the last entryCount_ entries are visible.
         Offset entries_;
+
+        /// @brief If nonzero the HighQueue can be resized to at most this many entries.
+        size_t maxEntryCount_;
+
+        /// @brief Set when a client that uses PowerOfTwoEntryCount attaches.
+        /// From then on resize() accepts only powers of two.
+        std::atomic<bool> powerOfTwoEntryCount_;
+
+        /// @brief The areas that hold the entries of a resizable HighQueue.
+        /// rings_[ringGeneration_ % 2] is current.  rings_[0] always describes the original entries.
+        HighQRing rings_[2];
+
+        /// @brief Counts the resizes the producers have switched to.
+        std::atomic<uint32_t> ringGeneration_;
+
+        /// @brief ResizeIdle, ResizePreparing (the idle ring is being filled), or ResizeReady
+        /// (the producers will switch to the idle ring at the next opportunity.)
+        std::atomic<uint32_t> resizeState_;
         
         /// @brief Offset to a cacheline containing Position of the next entry to be read.
         Offset readPosition_;
@@ -61,6 +122,30 @@ namespace HighQueue
         /// An Position must be reserved before it is published.
         Offset reservePosition_;
 
+        /// @brief Offset to a cacheline containing Position of the next entry to be claimed by a consumer.
+        /// Used only when consumers compete.  Always >= the read position.
+        Offset claimPosition_;
+
+        /// @brief Offset to HighQSubscriberPosition[subscriberCount_] (one cache line each)
+        /// Used only for broadcast queues.  The read position is the minimum of these.
+        Offset subscriberPositions_;
+
+        /// @brief Offset to the HighQAbandonedPositions.
+        /// Used only with lockFreeProducers_.
+        Offset abandonedPositions_;
+
+        /// @brief Offset to HighQConflationSlot[conflationSlotCount_]
+        /// Used only by conflating queues.
+        Offset conflationSlots_;
+        size_t conflationSlotCount_;
+
+        /// @brief Offset to HighQPriorityLane[priorityLaneCount_]
+        /// Lane n (counting from 1) is at index n - 1.
+        Offset priorityLanes_;
+
+        /// @brief Offset to the HighQStatistics that Producers and Consumers update as they run.
+        Offset statistics_;
+
         /// @brief Offset to a memory pool used allocate memory for Messages
         /// This is for use when the HighQueeue resides in shared memory meaning the Message buffers
         /// must be in the same shared memmory block as the HighQueue itself.
@@ -82,6 +167,14 @@ namespace HighQueue
         /// Mostly for diagnostic purposes.
         std::atomic<uint32_t> producersPresent_;
 
+        /// @brief A count of the consumers attached to the pool
+        /// More than one only when consumers compete.
+        std::atomic<uint32_t> consumersPresent_;
+
+        /// @brief How many subscriber positions have been assigned.
+        /// A subscriber's position is not reused when it detaches.
+        std::atomic<uint32_t> subscribersAttached_;
+
         ////////////////////////////////////////////
         // TODO: Move These to a separate cache line.  
         /// They change on a per-message basis
@@ -90,18 +183,47 @@ namespace HighQueue
         std::condition_variable producerWaitConditionVariable_;
         std::condition_variable consumerWaitConditionVariable_;
         /// @brief true if a producer is waiting on producerWaitConditionVariable_ .. an optimization to avoid unnecessary notifies.
-        bool producerWaiting_;
+        /// Set under waitMutex_ before the producer checks for space one last time, so a consumer that sees
+        /// it false (after a seq_cst fence) can skip the mutex.
+        std::atomic<bool> producerWaiting_;
         /// @brief true if a consummer is waiting on consumerWaitConditionVariable_ .. an optimization to avoid unnecessary notifies.
-        bool consumerWaiting_;
+        /// Set under waitMutex_ before the consumer checks for messages one last time, so a producer that sees
+        /// it false (after a seq_cst fence) can skip the mutex.
+        std::atomic<bool> consumerWaiting_;
+
+        /// @brief Where a producer parks when its WaitStrategy uses a futex.
+        HighQFutex producerFutex_;
+        /// @brief Where a consumer parks when its WaitStrategy uses a futex.
+        HighQFutex consumerFutex_;
 
         /// @brief Initialize the header during construction of a HighQueue
+        /// @param pool if zero a pool will be allocated within the HighQueue itself.
+        /// @param processShared the HighQueue lives in shared memory so the wait mutex and
+        ///        condition variables must work across processes.
         HQHeader(
             const std::string & name, 
             HQAllocator & allocator, 
             const CreationParameters & parameters,
-            HQMemoryBlockPool * pool = 0);
+            HQMemoryBlockPool * pool = 0,
+            bool processShared = false);
         void allocateInternalMessages(HQMemoryBlockPool * pool);
 
+        /// @brief Fill the idle ring with entryCount entries for the producers to switch to.
+        /// @param pool provides a Message for each new entry.
+        /// @returns false if a resize is already underway or the consumers have not finished
+        ///          with the entries left behind by the previous resize.
+        /// @throws runtime_error if the HighQueue is not resizable or entryCount is out of range,
+        ///         or if a client requires a power of two and entryCount is not one.
+        bool resize(size_t entryCount, HQMemoryBlockPool * pool);
+
+        /// @brief Called by a client that uses PowerOfTwoEntryCount before it starts using a resizable HighQueue.
+        /// From then on resize() refuses entry counts that are not powers of two.
+        /// @throws runtime_error if a resize to another count is already waiting for the producers.
+        void requirePowerOfTwoEntryCount();
+
+        /// @brief Reinitialize the wait mutex and condition variables so they can be used from multiple processes.
+        void makeProcessShared();
+
         /// @brief Release all messages back to the memory pool during destruction of a HighQueue
         /// For local HighQueues with shared memory pools this makes the memory available for reuse.
         /// For shared memory HighQueues this is not really necessary.
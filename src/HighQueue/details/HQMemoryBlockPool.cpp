@@ -6,13 +6,134 @@
 
 #include <HighQueue/details/HQMemoryBlockPool.hpp>
 #include <Common/Log.hpp>
+#include <algorithm>
 using namespace HighQueue;
 
+const uint32_t HQMemoryBlockPool::NULL_BLOCK;
+
+namespace
+{
+    /// @brief Guards livePools and every use of a pool from a cache that is not the calling pool's own.
+    std::mutex livePoolsMutex;
+    /// @brief The cacheSerial_ of each pool that has per-thread caches and still exists.
+    std::vector<uint64_t> livePools;
+    std::atomic<uint64_t> nextCacheSerial(1);
+
+    bool isLive(uint64_t serial)
+    {
+        return std::find(livePools.begin(), livePools.end(), serial) != livePools.end();
+    }
+
+    /// @brief The free blocks one thread keeps for one pool.
+    struct BlockCache
+    {
+        HQMemoryBlockPool * pool_;
+        uint64_t serial_;
+        uint32_t drainGeneration_;
+        size_t count_;
+        std::vector<size_t> offsets_;
+
+        BlockCache()
+            : pool_(0)
+            , serial_(0)
+            , drainGeneration_(0)
+            , count_(0)
+        {}
+
+        /// @brief Give every block back to a pool that may not be the caller's.
+        void flushIfLive()
+        {
+            std::lock_guard<std::mutex> guard(livePoolsMutex);
+            if(count_ != 0 && isLive(serial_))
+            {
+                pool_->pushBlocks(offsets_.data(), count_);
+            }
+            count_ = 0;
+        }
+    };
+
+    /// @brief The caches of one thread, one for each pool it has used that still exists.
+    /// A cache is never evicted while its pool lives, so a thread that uses many size classes keeps them all warm.
+    class ThreadBlockCaches
+    {
+    public:
+        ~ThreadBlockCaches()
+        {
+            for(auto & cache : caches_)
+            {
+                cache.flushIfLive();
+            }
+        }
+
+        BlockCache & find(HQMemoryBlockPool & pool)
+        {
+            for(auto & cache : caches_)
+            {
+                if(cache.pool_ == &pool && cache.serial_ == pool.cacheSerial_)
+                {
+                    return cache;
+                }
+            }
+            // This thread's first use of the pool.  Reuse the cache of a pool that no longer exists.
+            BlockCache * cache = 0;
+            {
+                std::lock_guard<std::mutex> guard(livePoolsMutex);
+                for(auto & candidate : caches_)
+                {
+                    if(!isLive(candidate.serial_))
+                    {
+                        cache = &candidate;
+                        break;
+                    }
+                }
+            }
+            if(cache == 0)
+            {
+                caches_.emplace_back();
+                cache = &caches_.back();
+            }
+            cache->pool_ = &pool;
+            cache->serial_ = pool.cacheSerial_;
+            cache->drainGeneration_ = pool.drainGeneration_.load(std::memory_order_relaxed);
+            cache->count_ = 0;
+            cache->offsets_.resize(pool.cacheBatch_ * 2);
+            return *cache;
+        }
+
+    private:
+        std::vector<BlockCache> caches_;
+    };
+
+    thread_local ThreadBlockCaches threadBlockCaches;
+
+    /// @brief Find the calling thread's cache for pool, and empty it if the pool asked for its blocks back.
+    BlockCache & findCache(HQMemoryBlockPool & pool)
+    {
+        auto & cache = threadBlockCaches.find(pool);
+        auto drainGeneration = pool.drainGeneration_.load(std::memory_order_relaxed);
+        if(cache.drainGeneration_ != drainGeneration)
+        {
+            cache.drainGeneration_ = drainGeneration;
+            if(cache.count_ != 0)
+            {
+                pool.pushBlocks(cache.offsets_.data(), cache.count_);
+                cache.count_ = 0;
+            }
+        }
+        return cache;
+    }
+}
+
 HQMemoryBlockPool::HQMemoryBlockPool()
 : poolSize_(0)
 , blockSize_(0)
 , blockCount_(0)
-, rootOffset_(NULL_OFFSET)
+, firstOffset_(0)
+, cacheBatch_(0)
+, drainCaches_(false)
+, cacheSerial_(0)
+, drainGeneration_(0)
+, root_(NULL_BLOCK)
 {
 }
 
@@ -22,7 +143,12 @@ HQMemoryBlockPool::HQMemoryBlockPool(
 : poolSize_(poolSize)
 , blockSize_(cacheAlignedMessageSize(blockSize))
 , blockCount_(0)
-, rootOffset_(NULL_OFFSET)
+, firstOffset_(0)
+, cacheBatch_(0)
+, drainCaches_(false)
+, cacheSerial_(0)
+, drainGeneration_(0)
+, root_(NULL_BLOCK)
 {
     preAllocate(blockSize_, poolSize_);
 }
@@ -38,12 +164,17 @@ size_t HQMemoryBlockPool::preAllocate(size_t blockSize, size_t poolSize)
     {
         throw std::invalid_argument("HQMemoryBlockPool: aligned offset + message size exceeds pool size."); 
     }
+    if((poolSize - current) / CacheLineSize >= NULL_BLOCK)
+    {
+        throw std::invalid_argument("HQMemoryBlockPool: pool too large.");
+    }
     poolSize_ = poolSize;
-    blockSize_ = blockSize;
+    // root_ counts in cache lines, so blocks must be whole cache lines.
+    blockSize_ = cacheAlignedMessageSize(blockSize);
     blockCount_ = 0;
 
     auto baseAddress = reinterpret_cast<byte_t *>(this);
-    rootOffset_ = current;
+    firstOffset_ = current;
     while(current != NULL_OFFSET)
     {
         auto next = current + blockSize_;
@@ -56,21 +187,34 @@ size_t HQMemoryBlockPool::preAllocate(size_t blockSize, size_t poolSize)
         current = next;
         blockCount_ += 1;
     }
+    root_.store(nextRoot(root_.load(std::memory_order_relaxed), 0), std::memory_order_release);
     return blockCount_;
 }
 
 bool HQMemoryBlockPool::tryAllocate(Message & message)
 {
-    SpinLock::Guard guard(lock_);
-    auto offset = rootOffset_;
-    auto ok = offset != NULL_OFFSET;
-    if(ok)
+    if(cacheBatch_ != 0)
     {
-        auto baseAddress = reinterpret_cast<byte_t *>(this);
-        rootOffset_ = reinterpret_cast<size_t &>(baseAddress[offset]);
-        message.set(this, blockSize_, offset, 0);
+        return cachedAllocate(message);
+    }
+    auto baseAddress = reinterpret_cast<byte_t *>(this);
+    auto root = root_.load(std::memory_order_acquire);
+    while(true)
+    {
+        auto offset = blockOffset(uint32_t(root));
+        if(offset == NULL_OFFSET)
+        {
+            return false;
+        }
+        // If another thread takes this block first, next may be garbage, but then the tag
+        // has changed and the exchange fails.
+        auto next = reinterpret_cast<volatile size_t &>(baseAddress[offset]);
+        if(root_.compare_exchange_weak(root, nextRoot(root, blockPosition(next)), std::memory_order_acquire))
+        {
+            message.set(this, blockSize_, offset, 0);
+            return true;
+        }
     }
-    return ok;
 }
 
 void HQMemoryBlockPool::allocate(Message & message)
@@ -88,16 +232,150 @@ void HQMemoryBlockPool::release(Message & message)
     {
         throw std::runtime_error("Message returned to wrong allocator.");
     }
+    if(cacheBatch_ != 0)
+    {
+        cachedRelease(message);
+        return;
+    }
+
+    auto block = blockPosition(message.getOffset());
+    auto root = root_.load(std::memory_order_relaxed);
+    do
+    {
+        *message.get<size_t>() = blockOffset(uint32_t(root));
+    }
+    while(!root_.compare_exchange_weak(root, nextRoot(root, block), std::memory_order_release, std::memory_order_relaxed));
+    message.reset();
+}
+
+size_t HQMemoryBlockPool::popBlocks(size_t * offsets, size_t count)
+{
+    auto baseAddress = reinterpret_cast<byte_t *>(this);
+    auto root = root_.load(std::memory_order_acquire);
+    while(true)
+    {
+        size_t taken = 0;
+        auto offset = blockOffset(uint32_t(root));
+        bool consistent = true;
+        while(offset != NULL_OFFSET && taken < count)
+        {
+            // If another thread changed the list while we walk it the links may be garbage.
+            // The exchange will fail, but don't follow a link out of the pool first.
+            if(offset < firstOffset_ || offset + blockSize_ > poolSize_)
+            {
+                consistent = false;
+                break;
+            }
+            offsets[taken++] = offset;
+            offset = reinterpret_cast<volatile size_t &>(baseAddress[offset]);
+        }
+        if(!consistent)
+        {
+            root = root_.load(std::memory_order_acquire);
+        }
+        else if(taken == 0)
+        {
+            return 0;
+        }
+        else if(root_.compare_exchange_weak(root, nextRoot(root, blockPosition(offset)), std::memory_order_acquire))
+        {
+            return taken;
+        }
+    }
+}
+
+void HQMemoryBlockPool::pushBlocks(const size_t * offsets, size_t count)
+{
+    if(count == 0)
+    {
+        return;
+    }
+    auto baseAddress = reinterpret_cast<byte_t *>(this);
+    for(size_t nBlock = 0; nBlock + 1 < count; ++nBlock)
+    {
+        reinterpret_cast<size_t &>(baseAddress[offsets[nBlock]]) = offsets[nBlock + 1];
+    }
+    auto & last = reinterpret_cast<size_t &>(baseAddress[offsets[count - 1]]);
+    auto block = blockPosition(offsets[0]);
+    auto root = root_.load(std::memory_order_relaxed);
+    do
+    {
+        last = blockOffset(uint32_t(root));
+    }
+    while(!root_.compare_exchange_weak(root, nextRoot(root, block), std::memory_order_release, std::memory_order_relaxed));
+}
+
+void HQMemoryBlockPool::enableThreadCaches(size_t batchSize, bool drainWhenEmpty)
+{
+    if(batchSize == 0)
+    {
+        throw std::invalid_argument("HQMemoryBlockPool: thread cache batch size must not be zero.");
+    }
+    std::lock_guard<std::mutex> guard(livePoolsMutex);
+    if(cacheSerial_ == 0)
+    {
+        cacheSerial_ = nextCacheSerial++;
+        livePools.push_back(cacheSerial_);
+    }
+    drainCaches_ = drainWhenEmpty;
+    cacheBatch_ = batchSize;
+}
+
+void HQMemoryBlockPool::drainThreadCaches()
+{
+    drainGeneration_.fetch_add(1, std::memory_order_relaxed);
+}
 
-    SpinLock::Guard guard(lock_);
-    *message.get<size_t>() = rootOffset_;
-    rootOffset_ = message.getOffset();
+void HQMemoryBlockPool::retireThreadCaches()
+{
+    std::lock_guard<std::mutex> guard(livePoolsMutex);
+    auto pos = std::find(livePools.begin(), livePools.end(), cacheSerial_);
+    if(pos != livePools.end())
+    {
+        livePools.erase(pos);
+    }
+    cacheBatch_ = 0;
+    cacheSerial_ = 0;
+}
+
+bool HQMemoryBlockPool::cachedAllocate(Message & message)
+{
+    auto & cache = findCache(*this);
+    if(cache.count_ == 0)
+    {
+        cache.count_ = popBlocks(cache.offsets_.data(), cacheBatch_);
+        if(cache.count_ == 0)
+        {
+            if(drainCaches_)
+            {
+                // The other threads give their blocks back on their next allocate or release.
+                cache.drainGeneration_ = drainGeneration_.fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+            return false;
+        }
+    }
+    message.set(this, blockSize_, cache.offsets_[--cache.count_], 0);
+    return true;
+}
+
+void HQMemoryBlockPool::cachedRelease(Message & message)
+{
+    auto & cache = findCache(*this);
+    if(cache.count_ == cache.offsets_.size())
+    {
+        // Give back the blocks that have been cached longest.  The recent ones are more likely to be in the CPU cache.
+        auto offsets = cache.offsets_.data();
+        pushBlocks(offsets, cacheBatch_);
+        cache.count_ -= cacheBatch_;
+        std::copy(offsets + cacheBatch_, offsets + cacheBatch_ + cache.count_, offsets);
+    }
+    cache.offsets_[cache.count_++] = message.getOffset();
     message.reset();
 }
 
 bool HQMemoryBlockPool::isEmpty() const
 {
-    return rootOffset_ == NULL_OFFSET;
+    return uint32_t(root_.load(std::memory_order_relaxed)) == NULL_BLOCK;
 }
 
 
@@ -5,7 +5,6 @@
 
 #include <Common/HighQueue_Export.hpp>
 #include <HighQueue/Message.hpp>
-#include <Common/SpinLock.hpp>
 
 namespace HighQueue
 {
@@ -17,11 +16,21 @@ namespace HighQueue
     /// Instead offsets within the block are used to identify memory blocks.
     /// This allows a pool to reside in shared memory which might be mapped
     /// to different addresses in different processes.
+    ///
+    /// The free blocks form a lock-free stack.  Allocating and releasing are each a
+    /// single compare-exchange of root_ unless another thread changes it first.
+    ///
+    /// A pool that belongs to one process may also let each thread keep a few free blocks of
+    /// its own (see enableThreadCaches().)  Threads then move blocks to and from the stack in
+    /// batches, and most allocations and releases do not touch root_ at all.
     struct HighQueue_Export HQMemoryBlockPool
     {
         /// A flag to mark the end of the linked list of memory blocks.
         const size_t NULL_OFFSET = ~(size_t(0));
 
+        /// @brief The block position in root_ when no blocks are free.
+        static const uint32_t NULL_BLOCK = ~uint32_t(0);
+
         /// @brief The size of the entire pool of memory
         size_t poolSize_;
 
@@ -32,11 +41,30 @@ namespace HighQueue
         /// constant: does not change as memory is allocated or freed)
         size_t blockCount_;
             
-        /// @brief The root of a linked list.  This is an offset to the pool base address
-        size_t rootOffset_;
+        /// @brief The offset of the first block.  root_ counts cache lines from here so it fits in 32 bits.
+        size_t firstOffset_;
+
+        /// @brief How many blocks a thread moves to or from the free list at once.
+        /// Zero means threads do not keep blocks of their own.
+        size_t cacheBatch_;
+
+        /// @brief Ask the threads to give back their blocks when the free list runs out.
+        bool drainCaches_;
+
+        /// @brief Identifies this pool to the per-thread caches.  Zero if it has none.
+        uint64_t cacheSerial_;
 
-        /// @brief Synchronize access to rootOffset_
-        SpinLock lock_;
+        /// @brief Incremented to ask every thread to give back its blocks on its next allocate or release.
+        std::atomic<uint32_t> drainGeneration_;
+
+        /// @brief The root of a linked list: the position of the first free block (in cache lines from
+        /// firstOffset_) in the low 32 bits and a tag in the high 32 bits.  Each free block starts with
+        /// the offset of the next one.
+        ///
+        /// Every change to the root changes the tag, so a compare-exchange based on a stale root fails even if
+        /// the same block is back on top of the list (the ABA problem.)  Positions rather than addresses
+        /// keep the root meaningful in every process that maps the pool.
+        std::atomic<uint64_t> root_;
 
         /// @brief Construct an empty pool.
         ///
@@ -71,6 +99,33 @@ namespace HighQueue
         /// @throws runtime_error if the memory did not come from this block.
         void release(Message & message);
 
+        /// @brief Let each thread keep up to 2 * batchSize free blocks of its own.
+        ///
+        /// A thread that runs out takes batchSize blocks from the free list with one
+        /// compare-exchange, and a thread that holds too many gives batchSize back the same way.
+        /// Only for pools used by a single process.  Call before the pool is in use.
+        /// @param drainWhenEmpty asks the other threads to give back their blocks when
+        ///        an allocation finds the free list empty, so idle caches can't starve busy threads.
+        void enableThreadCaches(size_t batchSize, bool drainWhenEmpty = true);
+
+        /// @brief Ask every thread to give back its blocks.
+        /// Each thread does so on its next allocate or release from this pool.
+        void drainThreadCaches();
+
+        /// @brief Stop using per-thread caches because the pool is about to be destroyed.
+        /// Blocks still held by threads are forgotten, not returned.
+        void retireThreadCaches();
+
+        /// @brief Take up to count blocks from the free list at once.
+        /// for internal use (and testing)
+        /// @param offsets receives the offsets of the blocks.
+        /// @returns how many blocks were taken.
+        size_t popBlocks(size_t * offsets, size_t count);
+
+        /// @brief Return count blocks to the free list at once.
+        /// for internal use (and testing)
+        void pushBlocks(const size_t * offsets, size_t count);
+
         /// @brief Are messages available?
         ///
         /// Warning.  This is not threadsafe.  If you really want to know, try to allocate.
@@ -106,5 +161,26 @@ namespace HighQueue
         /// @param messageCount the minimum number of messages.
         /// @returns the number of bytes needed to insure that the size and count requrements can be met.
         static size_t spaceNeeded(size_t messageSize, size_t messageCount);
+
+    private:
+        bool cachedAllocate(Message & message);
+        void cachedRelease(Message & message);
+
+        // Blocks are a whole number of cache lines, so these are shifts rather than divisions.
+        uint32_t blockPosition(size_t offset) const
+        {
+            return offset == NULL_OFFSET ? NULL_BLOCK : uint32_t((offset - firstOffset_) / CacheLineSize);
+        }
+
+        size_t blockOffset(uint32_t block) const
+        {
+            return block == NULL_BLOCK ? NULL_OFFSET : firstOffset_ + size_t(block) * CacheLineSize;
+        }
+
+        /// @brief A new root for block, with the tag after the one in oldRoot
+        static uint64_t nextRoot(uint64_t oldRoot, uint32_t block)
+        {
+            return ((oldRoot >> 32) + 1) << 32 | block;
+        }
     };
 }
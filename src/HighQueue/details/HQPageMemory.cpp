@@ -0,0 +1,298 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include <Common/HighQueuePch.hpp>
+
+#include "HQPageMemory.hpp"
+#include <Common/Log.hpp>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif // _WIN32
+
+using namespace HighQueue;
+
+namespace
+{
+    const size_t defaultHugePageSize = 2 * 1024 * 1024;
+
+    size_t roundUp(size_t size, size_t unit)
+    {
+        return (size + unit - 1) / unit * unit;
+    }
+
+    size_t ordinaryPageSize()
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return size_t(info.dwPageSize);
+#else // _WIN32
+        return size_t(sysconf(_SC_PAGESIZE));
+#endif // _WIN32
+    }
+
+#ifdef __linux__
+    // From <numaif.h>.  The system calls are used directly so HighQueue does not need libnuma.
+    const int mpolPreferred = 1;
+    const unsigned long mpolFlagNode = 1;
+    const unsigned long mpolFlagAddress = 2;
+
+    /// @brief Ask for the pages of a region to come from node.  Only pages not yet touched are affected.
+    void bindToNode(byte_t * memory, size_t size, int node)
+    {
+        auto physical = HighQPageMemory::physicalNode(node);
+        if(physical != node)
+        {
+            LogInfo("NUMA node " << node << " emulated by node " << physical << ".");
+        }
+        const size_t bitsPerWord = sizeof(unsigned long) * CHAR_BIT;
+        std::vector<unsigned long> mask(size_t(physical) / bitsPerWord + 1, 0);
+        mask[size_t(physical) / bitsPerWord] = 1UL << (size_t(physical) % bitsPerWord);
+        if(syscall(SYS_mbind, memory, size, mpolPreferred, mask.data(), mask.size() * bitsPerWord + 1, 0) != 0)
+        {
+            LogWarning("Can't place " << size << " bytes on NUMA node " << physical << ": " << std::strerror(errno));
+        }
+    }
+#endif // __linux__
+
+    /// @brief Write to one byte in every page so the system provides the page now.
+    void touchPages(byte_t * memory, size_t size, size_t pageSize)
+    {
+        volatile byte_t * pages = memory;
+        for(size_t offset = 0; offset < size; offset += pageSize)
+        {
+            pages[offset] = 0;
+        }
+        if(size > 0)
+        {
+            pages[size - 1] = 0;
+        }
+    }
+}
+
+size_t HighQPageMemory::hugePageSize()
+{
+#ifdef _WIN32
+    return GetLargePageMinimum();
+#else // _WIN32
+    static size_t size = 0;
+    if(size == 0)
+    {
+        size = defaultHugePageSize;
+        std::ifstream meminfo("/proc/meminfo");
+        std::string line;
+        while(std::getline(meminfo, line))
+        {
+            if(line.compare(0, 13, "Hugepagesize:") == 0)
+            {
+                size = size_t(std::strtoul(line.c_str() + 13, 0, 10)) * 1024;
+                break;
+            }
+        }
+    }
+    return size;
+#endif // _WIN32
+}
+
+const char * HighQPageMemory::backingName(Backing backing)
+{
+    switch(backing)
+    {
+    case Heap:
+        return "heap";
+    case OrdinaryPages:
+        return "ordinary pages";
+    case TransparentHugePages:
+        return "transparent huge pages";
+    case HugePages:
+        return "huge pages";
+    }
+    return "unknown";
+}
+
+int HighQPageMemory::nodeCount()
+{
+#ifdef __linux__
+    static int count = 0;
+    if(count == 0)
+    {
+        // "0" or "0-1" or "0,2-3"
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string nodes;
+        std::getline(online, nodes);
+        auto last = nodes.find_last_of(",-");
+        count = nodes.empty() ? 1 : std::atoi(nodes.c_str() + (last == std::string::npos ? 0 : last + 1)) + 1;
+    }
+    return count;
+#else // __linux__
+    return 1;
+#endif // __linux__
+}
+
+int HighQPageMemory::physicalNode(int node)
+{
+    return node < 0 ? node : node % nodeCount();
+}
+
+int HighQPageMemory::nodeOfCpu(int cpu)
+{
+#ifdef __linux__
+    for(int node = 0; node < nodeCount(); ++node)
+    {
+        std::stringstream path;
+        path << "/sys/devices/system/node/node" << node << "/cpu" << cpu;
+        if(access(path.str().c_str(), F_OK) == 0)
+        {
+            return node;
+        }
+    }
+#endif // __linux__
+    return -1;
+}
+
+int HighQPageMemory::currentNode()
+{
+#ifdef __linux__
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if(syscall(SYS_getcpu, &cpu, &node, 0) == 0)
+    {
+        return int(node);
+    }
+#endif // __linux__
+    return -1;
+}
+
+int HighQPageMemory::nodeOf(const void * address)
+{
+#ifdef __linux__
+    int node = -1;
+    if(syscall(SYS_get_mempolicy, &node, 0, 0, address, mpolFlagNode | mpolFlagAddress) == 0)
+    {
+        return node;
+    }
+#endif // __linux__
+    return -1;
+}
+
+void HighQPageMemory::prepare(byte_t * memory, size_t size, const PageOptions & options)
+{
+    if(options.prefault_ || options.lockPages_)
+    {
+        touchPages(memory, size, ordinaryPageSize());
+    }
+    if(options.lockPages_)
+    {
+#ifdef _WIN32
+        if(!VirtualLock(memory, size))
+#else // _WIN32
+        if(mlock(memory, size) != 0)
+#endif // _WIN32
+        {
+            LogWarning("Can't lock " << size << " bytes into memory.  Check the limit on locked memory.");
+        }
+    }
+}
+
+#ifdef _WIN32
+std::shared_ptr<byte_t> HighQPageMemory::allocate(size_t size, const PageOptions & options, Backing * backing)
+{
+    // Large pages on Windows need a privilege most processes don't have, so use the heap.
+    std::shared_ptr<byte_t> memory(new byte_t[size], std::default_delete<byte_t[]>());
+    prepare(memory.get(), size, options);
+    if(backing)
+    {
+        *backing = Heap;
+    }
+    return memory;
+}
+#else // _WIN32
+std::shared_ptr<byte_t> HighQPageMemory::allocate(size_t size, const PageOptions & options, Backing * backing)
+{
+    Backing result = Heap;
+    std::shared_ptr<byte_t> memory;
+    if(!options.any())
+    {
+        memory.reset(new byte_t[size], std::default_delete<byte_t[]>());
+    }
+    else
+    {
+        const int protection = PROT_READ | PROT_WRITE;
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        auto hugeSize = hugePageSize();
+        void * mapped = MAP_FAILED;
+        size_t mappedSize = 0;
+#ifdef MAP_HUGETLB
+        if(options.hugePages_)
+        {
+            // Fails unless huge pages have been reserved (vm.nr_hugepages.)
+            mappedSize = roundUp(size, hugeSize);
+            mapped = mmap(0, mappedSize, protection, flags | MAP_HUGETLB, -1, 0);
+            result = HugePages;
+        }
+#endif // MAP_HUGETLB
+        if(mapped == MAP_FAILED)
+        {
+            result = OrdinaryPages;
+            mappedSize = roundUp(size, ordinaryPageSize());
+            size_t alignment = 0;
+#ifdef MADV_HUGEPAGE
+            if(options.hugePages_ && size >= hugeSize)
+            {
+                // Transparent huge pages only cover whole, aligned huge pages, so map a little
+                // extra and give back the unaligned ends.
+                mappedSize = roundUp(size, hugeSize);
+                alignment = hugeSize;
+            }
+#endif // MADV_HUGEPAGE
+            mapped = mmap(0, mappedSize + alignment, protection, flags, -1, 0);
+            if(mapped == MAP_FAILED)
+            {
+                throw std::runtime_error("HighQPageMemory: can't map memory.");
+            }
+            if(alignment != 0)
+            {
+                auto start = reinterpret_cast<uintptr_t>(mapped);
+                auto aligned = roundUp(start, alignment);
+                if(aligned != start)
+                {
+                    munmap(mapped, aligned - start);
+                }
+                auto end = aligned + mappedSize;
+                auto mappedEnd = start + mappedSize + alignment;
+                if(mappedEnd != end)
+                {
+                    munmap(reinterpret_cast<void *>(end), mappedEnd - end);
+                }
+                mapped = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+                if(madvise(mapped, mappedSize, MADV_HUGEPAGE) == 0)
+                {
+                    result = TransparentHugePages;
+                }
+#endif // MADV_HUGEPAGE
+            }
+        }
+        memory.reset(reinterpret_cast<byte_t *>(mapped), [mappedSize](byte_t * pages)
+        {
+            munmap(pages, mappedSize);
+        });
+#ifdef __linux__
+        if(options.numaNode_ >= 0)
+        {
+            // Before anything touches the pages.
+            bindToNode(memory.get(), mappedSize, options.numaNode_);
+        }
+#endif // __linux__
+        // Touch every page, even a huge one, so the pool is ready before it is used.
+        prepare(memory.get(), mappedSize, options);
+    }
+    if(backing)
+    {
+        *backing = result;
+    }
+    return memory;
+}
+#endif // _WIN32
@@ -0,0 +1,97 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <Common/HighQueue_Export.hpp>
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief How the pages under a large region of memory (a HighQueue or a memory pool) are provided.
+    struct PageOptions
+    {
+        /// @brief Back the region with huge pages so it needs fewer TLB entries.
+        /// Uses MAP_HUGETLB if the system has huge pages reserved, otherwise asks for transparent
+        /// huge pages with madvise.  If neither is available the region uses ordinary pages.
+        bool hugePages_;
+        /// @brief Touch every page when the region is allocated so no page faults happen once messages flow.
+        bool prefault_;
+        /// @brief Lock the region into memory (mlock) so it is never paged out.  Implies prefault_.
+        /// If the limit on locked memory is too low the region is used unlocked.
+        bool lockPages_;
+        /// @brief Put the region's pages on this NUMA node (preferred, so another node is used if it is full.)
+        /// Use the node of the thread that reads the region most.  -1 (the default) leaves placement to the system.
+        /// On a machine with fewer nodes, node n means node n % HighQPageMemory::nodeCount().
+        int numaNode_;
+
+        PageOptions()
+            : hugePages_(false)
+            , prefault_(false)
+            , lockPages_(false)
+            , numaNode_(-1)
+        {}
+
+        /// @brief Does the region need anything other than ordinary heap memory?
+        bool any() const
+        {
+            return hugePages_ || prefault_ || lockPages_ || numaNode_ >= 0;
+        }
+
+        /// @brief Combine with options that apply to every region (see Steps::SharedResources.)
+        PageOptions & operator|=(const PageOptions & rhs)
+        {
+            hugePages_ = hugePages_ || rhs.hugePages_;
+            prefault_ = prefault_ || rhs.prefault_;
+            lockPages_ = lockPages_ || rhs.lockPages_;
+            if(numaNode_ < 0)
+            {
+                numaNode_ = rhs.numaNode_;
+            }
+            return *this;
+        }
+    };
+
+    /// @brief Allocates large regions of memory with the pages PageOptions ask for.
+    struct HighQueue_Export HighQPageMemory
+    {
+        /// @brief What actually backs a region.
+        enum Backing
+        {
+            Heap,                  ///< new byte_t[] (no options were given.)
+            OrdinaryPages,         ///< Mapped directly with the system's usual page size.
+            TransparentHugePages,  ///< Mapped directly and madvise(MADV_HUGEPAGE) accepted.
+            HugePages              ///< Mapped with MAP_HUGETLB.
+        };
+
+        /// @brief Allocate a region of at least size bytes.
+        /// @param backing if not null receives what backs the region.
+        /// @returns the region.  Releasing the last reference frees it.
+        /// @throws runtime_error if no memory is available at all.
+        static std::shared_ptr<byte_t> allocate(size_t size, const PageOptions & options, Backing * backing = 0);
+
+        /// @brief Apply prefault_ and lockPages_ to memory that was mapped some other way (named shared memory.)
+        static void prepare(byte_t * memory, size_t size, const PageOptions & options);
+
+        /// @brief The size of a huge page (zero if the system does not say.)
+        static size_t hugePageSize();
+
+        static const char * backingName(Backing backing);
+
+        /// @brief How many NUMA nodes the machine has (1 if it doesn't say.)
+        static int nodeCount();
+
+        /// @brief The node that stands in for node on this machine: node % nodeCount().
+        /// This lets a configuration written for several nodes run (and be tested) on one.
+        static int physicalNode(int node);
+
+        /// @brief The node that cpu belongs to, or -1 if unknown.
+        static int nodeOfCpu(int cpu);
+
+        /// @brief The node the calling thread is running on, or -1 if unknown.
+        static int currentNode();
+
+        /// @brief The node that holds the page at address, or -1 if unknown (or the page has not been touched.)
+        static int nodeOf(const void * address);
+    };
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+#include <HighQueue/CreationParameters.hpp>
+#include <Common/SpinLock.hpp>
+
+namespace HighQueue
+{
+    /// @brief One cache line holding a Position in a priority lane.
+    PRE_CACHE_ALIGN
+    struct HighQLanePosition
+    {
+        AtomicPosition position_;
+
+        HighQLanePosition(Position initialPosition)
+            : position_(initialPosition)
+        {}
+    } POST_CACHE_ALIGN;
+
+    /// @brief A small ring of entries whose messages are delivered ahead of the HighQueue's own entries.
+    ///
+    /// See CreationParameters::priorityLanes_.  Lanes are numbered from 1; lane 0 is the HighQueue itself
+    /// and higher lanes are read first.  Producers take the lane's spin lock (unless solo) and the single
+    /// consumer reads without one.  The entries are HighQEntry[entryCount_] indexed by [Position % entryCount_].
+    struct HighQPriorityLane
+    {
+        /// @brief A HighQueue has at most this many priority lanes in addition to its own entries.
+        static const size_t MaxLanes = 3;
+
+        /// @brief Position of the next entry to be read.  Written only by the consumer.
+        HighQLanePosition readPosition_;
+        /// @brief Position of the next entry to be published.
+        HighQLanePosition publishPosition_;
+        /// @brief Producers hold this while they publish to the lane.
+        SpinLock spinLock_;
+        Offset entries_;
+        size_t entryCount_;
+
+        HighQPriorityLane(size_t entryCount)
+            : readPosition_(entryCount)
+            , publishPosition_(entryCount)
+            , entries_(0)
+            , entryCount_(entryCount)
+        {}
+
+        /// @brief How many priority lanes a HighQueue created with these parameters will have.
+        /// Lanes need a single consumer, so competing consumers and subscribers get none.
+        static size_t laneCount(const CreationParameters & parameters)
+        {
+            if(parameters.competingConsumers_ || parameters.subscriberCount_ != 0)
+            {
+                return 0;
+            }
+            return parameters.priorityLanes_;
+        }
+
+        /// @brief How many entries (and therefore Messages) the priority lanes need altogether.
+        static size_t entriesNeeded(const CreationParameters & parameters)
+        {
+            return laneCount(parameters) * parameters.priorityEntryCount_;
+        }
+    };
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+#include <HighQueue/CreationParameters.hpp>
+
+namespace HighQueue
+{
+    /// @brief One of the two areas that can hold the entries of a resizable HighQueue.
+    ///
+    /// See CreationParameters::maxEntryCount_.  Each area has room for maxEntryCount_ entries.
+    /// A resize fills the idle area with new entries, then the producers switch to it at a fence
+    /// Position.  Positions before the fence stay in the other area until they have been consumed.
+    struct HighQRing
+    {
+        /// @brief Offset to the area: HighQEntry[maxEntryCount_]
+        Offset entries_;
+        /// @brief How many of the entries are in use.
+        size_t entryCount_;
+        /// @brief How many entries hold a Message that must be released before the area is reused.
+        size_t constructed_;
+        /// @brief The first Position stored in this area.  Earlier Positions are in the other area.
+        Position start_;
+
+        HighQRing()
+            : entries_(0)
+            , entryCount_(0)
+            , constructed_(0)
+            , start_(0)
+        {}
+
+        /// @brief The most entries a HighQueue created with these parameters can be resized to.
+        /// Zero if it cannot be resized.
+        static size_t maxEntryCount(const CreationParameters & parameters)
+        {
+            if(parameters.maxEntryCount_ == 0
+                || parameters.lockFreeProducers_
+                || parameters.overwriteWhenFull_
+                || parameters.conflateByKey_)
+            {
+                return 0;
+            }
+            return parameters.maxEntryCount_ > parameters.entryCount_ ? parameters.maxEntryCount_ : parameters.entryCount_;
+        }
+
+        /// @brief How many entries (and therefore Messages) the second area needs beyond parameters.entryCount_.
+        /// While a resize is prepared both areas may be full.
+        static size_t entriesNeeded(const CreationParameters & parameters)
+        {
+            auto maxCount = maxEntryCount(parameters);
+            return maxCount == 0 ? 0 : maxCount * 2 - parameters.entryCount_;
+        }
+    };
+}
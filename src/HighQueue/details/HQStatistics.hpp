@@ -0,0 +1,140 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief A counter with a single writer that other threads and processes may read at any time.
+    ///
+    /// The writer uses relaxed loads and stores rather than a read-modify-write, so counting costs
+    /// no more than incrementing an ordinary member.
+    struct HighQStatCounter
+    {
+        std::atomic<uint64_t> value_;
+
+        HighQStatCounter()
+            : value_(0)
+        {}
+
+        HighQStatCounter & operator++()
+        {
+            value_.store(value_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return *this;
+        }
+
+        HighQStatCounter & operator+=(uint64_t count)
+        {
+            value_.store(value_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+            return *this;
+        }
+
+        operator uint64_t() const
+        {
+            return value_.load(std::memory_order_relaxed);
+        }
+    };
+
+    /// @brief The counters for one Producer or Consumer.
+    /// Not cache aligned so a Producer or Consumer can hold one of its own without becoming over-aligned.
+    struct HighQStatRecord
+    {
+        /// @brief Values for owner_
+        static const uint32_t Free = 0;
+        static const uint32_t ProducerOwner = 1;
+        static const uint32_t ConsumerOwner = 2;
+
+        std::atomic<uint32_t> owner_;
+        /// @brief Incremented each time the slot is claimed.  Readers that see it change
+        /// know the counters started again from zero.
+        std::atomic<uint32_t> generation_;
+        HighQStatCounter publishes_;
+        HighQStatCounter fulls_;
+        HighQStatCounter consumed_;
+        HighQStatCounter spins_;
+        HighQStatCounter yields_;
+        HighQStatCounter sleeps_;
+        HighQStatCounter waits_;
+
+        HighQStatRecord()
+            : owner_(Free)
+            , generation_(0)
+        {}
+    };
+
+    /// @brief A HighQStatRecord in the HighQueue's memory.  Each slot has its own cache line.
+    PRE_CACHE_ALIGN
+    struct HighQStatSlot : public HighQStatRecord
+    {
+    } POST_CACHE_ALIGN;
+
+    /// @brief Statistics that programs outside the process can read while the HighQueue is running.
+    ///
+    /// Lives in the HighQueue's memory next to the HQHeader (see HQHeader::statistics_.)  Each Producer
+    /// and Consumer claims a slot and is the only writer of its counters.  Clients that find no free
+    /// slot keep their counters privately.
+    struct HighQStatistics
+    {
+        static const size_t SlotCount = 15;
+
+        /// @brief The greatest number of entries the producers have found in use.
+        /// Producers check only when they run out of space they know is free.
+        PRE_CACHE_ALIGN
+        struct HighWater
+        {
+            std::atomic<Position> depth_;
+        } POST_CACHE_ALIGN highWater_;
+
+        HighQStatSlot slots_[SlotCount];
+
+        HighQStatistics()
+        {
+            highWater_.depth_ = 0;
+        }
+
+        /// @brief Find a free slot for a Producer or Consumer.
+        /// @param privateSlot is returned if all slots are taken.
+        /// @returns the slot with its counters set to zero.
+        HighQStatRecord & claim(uint32_t owner, HighQStatRecord & privateSlot)
+        {
+            for(auto & slot : slots_)
+            {
+                uint32_t expected = HighQStatSlot::Free;
+                if(slot.owner_.load(std::memory_order_relaxed) == HighQStatSlot::Free
+                    && slot.owner_.compare_exchange_strong(expected, owner))
+                {
+                    for(auto counter : {&slot.publishes_, &slot.fulls_, &slot.consumed_,
+                        &slot.spins_, &slot.yields_, &slot.sleeps_, &slot.waits_})
+                    {
+                        counter->value_.store(0, std::memory_order_relaxed);
+                    }
+                    slot.generation_.fetch_add(1, std::memory_order_release);
+                    return slot;
+                }
+            }
+            return privateSlot;
+        }
+
+        /// @brief Give back a slot returned by claim().
+        void release(HighQStatRecord & slot)
+        {
+            auto address = reinterpret_cast<const char *>(&slot);
+            if(address >= reinterpret_cast<const char *>(slots_) && address < reinterpret_cast<const char *>(slots_ + SlotCount))
+            {
+                slot.owner_.store(HighQStatSlot::Free, std::memory_order_release);
+            }
+        }
+
+        /// @brief Raise the high water mark if depth exceeds it.
+        void recordDepth(Position depth)
+        {
+            auto highWater = highWater_.depth_.load(std::memory_order_relaxed);
+            while(depth > highWater
+                && !highWater_.depth_.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+            {
+            }
+        }
+    };
+}
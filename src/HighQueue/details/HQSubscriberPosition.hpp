@@ -0,0 +1,25 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/details/HQDefinitions.hpp>
+
+namespace HighQueue
+{
+    /// @brief The read position of one subscriber to a broadcast HighQueue.
+    /// Each subscriber has its own cache line.
+    PRE_CACHE_ALIGN
+    struct HighQSubscriberPosition
+    {
+        /// @brief A subscriber that has detached no longer holds up the producers.
+        static const Position Detached = ~Position(0);
+
+        /// @brief Position of the next entry this subscriber will read.
+        AtomicPosition position_;
+
+        HighQSubscriberPosition(Position initialPosition)
+            : position_(initialPosition)
+        {}
+    } POST_CACHE_ALIGN;
+}
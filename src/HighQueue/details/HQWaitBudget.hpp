@@ -0,0 +1,197 @@
+// Copyright (c) 2015 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <HighQueue/WaitStrategy.hpp>
+#include <Common/Stopwatch.hpp>
+
+namespace HighQueue
+{
+    /// @brief Decides how much longer a Consumer or Producer may spin, yield, or sleep during one wait.
+    ///
+    /// With an ordinary WaitStrategy the budgets are the configured counts.
+    /// With an adaptive WaitStrategy the spin and yield budgets are periods chosen at the start of
+    /// each wait from a moving estimate of how long recent waits lasted.  The estimate drops at
+    /// once when a wait is shorter than expected (a burst is starting) and rises slowly when
+    /// waits get longer (the feed is going quiet).
+    ///
+    /// Call start() before the first attempt, spin(), yield() and sleep() in that order after
+    /// each failed attempt, and finish() when the wait is satisfied.
+    class HighQWaitBudget
+    {
+    public:
+        /// @brief Spin and yield at least this long unless the feed is idle.
+        static const uint64_t minimumPeriod = 1000;
+        /// @brief Read the clock once every this many spins.
+        static const uint32_t clockCheckMask = 0xF;
+
+        explicit HighQWaitBudget(const WaitStrategy & strategy)
+            : strategy_(strategy)
+            , remainingSpins_(0)
+            , remainingYields_(0)
+            , remainingSleeps_(0)
+            , waitStart_(0)
+            , spinEnd_(0)
+            , yieldEnd_(0)
+            , spinChecks_(0)
+            , spinning_(false)
+            , estimate_(uint64_t(strategy.maxSpinPeriod_.count()) / 2)
+            , spinPeriod_(0)
+            , yieldPeriod_(0)
+            , adaptedWaits_(0)
+        {
+        }
+
+        /// @brief Reset the budgets for a new wait.
+        void start()
+        {
+            remainingSpins_ = strategy_.spinCount_;
+            remainingYields_ = strategy_.yieldCount_;
+            remainingSleeps_ = strategy_.sleepCount_;
+            waitStart_ = 0;
+        }
+
+        /// @brief May the caller spin once more?
+        bool spin()
+        {
+            if(strategy_.adaptive_)
+            {
+                if(waitStart_ == 0)
+                {
+                    // The clock is only read once the caller actually has to wait.
+                    chooseBudgets(Stopwatch::now());
+                }
+                if(spinning_ && (++spinChecks_ & clockCheckMask) == 0)
+                {
+                    spinning_ = Stopwatch::now() < spinEnd_;
+                }
+                return spinning_;
+            }
+            return consume(remainingSpins_);
+        }
+
+        /// @brief May the caller yield once more?
+        bool yield()
+        {
+            if(strategy_.adaptive_)
+            {
+                return Stopwatch::now() < yieldEnd_;
+            }
+            return consume(remainingYields_);
+        }
+
+        /// @brief May the caller sleep once more?
+        bool sleep()
+        {
+            return consume(remainingSleeps_);
+        }
+
+        /// @brief The wait is over.  Adaptive strategies learn from how long it took.
+        void finish()
+        {
+            if(waitStart_ != 0)
+            {
+                uint64_t lapse = Stopwatch::now() - waitStart_;
+                if(lapse < estimate_)
+                {
+                    estimate_ = lapse;
+                }
+                else
+                {
+                    estimate_ += (lapse - estimate_) / 8;
+                }
+                waitStart_ = 0;
+            }
+        }
+
+        /// @brief The current estimate of how long a wait will last in nanoseconds.
+        uint64_t estimate() const
+        {
+            return estimate_;
+        }
+
+        /// @brief The spin period chosen for the most recent wait in nanoseconds.
+        uint64_t spinPeriod() const
+        {
+            return spinPeriod_;
+        }
+
+        /// @brief The combined spin and yield period chosen for the most recent wait in nanoseconds.
+        uint64_t yieldPeriod() const
+        {
+            return yieldPeriod_;
+        }
+
+        /// @brief for diagnosing and performance measurements, dump statistics
+        std::ostream & writeStats(std::ostream & out) const
+        {
+            if(strategy_.adaptive_)
+            {
+                out << " Adaptive: " << adaptedWaits_
+                    << " Estimate: " << estimate_
+                    << " SpinBudget: " << spinPeriod_
+                    << " YieldBudget: " << yieldPeriod_;
+            }
+            return out;
+        }
+
+    private:
+        static bool consume(size_t & remaining)
+        {
+            if(remaining == 0)
+            {
+                return false;
+            }
+            if(remaining != WaitStrategy::FOREVER)
+            {
+                --remaining;
+            }
+            return true;
+        }
+
+        void chooseBudgets(uint64_t now)
+        {
+            ++adaptedWaits_;
+            waitStart_ = now;
+            uint64_t maxSpin = uint64_t(strategy_.maxSpinPeriod_.count());
+            uint64_t maxYield = uint64_t(strategy_.maxYieldPeriod_.count());
+            uint64_t target = estimate_ * 2;
+            if(target < minimumPeriod)
+            {
+                target = minimumPeriod;
+            }
+            if(target <= maxYield)
+            {
+                // Data is expected soon enough that it's worth keeping the CPU.
+                spinPeriod_ = target < maxSpin ? target : maxSpin;
+                yieldPeriod_ = target;
+            }
+            else
+            {
+                // Idle feed: go straight to sleeping or waiting.
+                spinPeriod_ = 0;
+                yieldPeriod_ = 0;
+            }
+            spinEnd_ = now + spinPeriod_;
+            yieldEnd_ = now + yieldPeriod_;
+            spinChecks_ = 0;
+            spinning_ = spinPeriod_ != 0;
+        }
+
+    private:
+        const WaitStrategy & strategy_;
+        size_t remainingSpins_;
+        size_t remainingYields_;
+        size_t remainingSleeps_;
+        uint64_t waitStart_;
+        uint64_t spinEnd_;
+        uint64_t yieldEnd_;
+        uint32_t spinChecks_;
+        bool spinning_;
+        uint64_t estimate_;
+        uint64_t spinPeriod_;
+        uint64_t yieldPeriod_;
+        uint64_t adaptedWaits_;
+    };
+}
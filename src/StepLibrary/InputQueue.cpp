@@ -7,6 +7,12 @@
 #include <Steps/StepFactory.hpp>
 #include <Steps/Configuration.hpp>
 #include <Steps/SharedResources.hpp>
+#include <StepLibrary/GapMesssage.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
 
 using namespace HighQueue;
 using namespace Steps;
@@ -24,11 +30,64 @@ namespace
     const std::string keySleepCount = "sleep_count";
     const std::string keySleepPeriod = "sleep_nanoseconds";
     const std::string keyMutexWaitTimeout = "timeout_nanoseconds";
+    const std::string keyUseFutex = "use_futex";
+    const std::string keyAdaptive = "adaptive";
+    const std::string keyMaxSpinPeriod = "max_spin_nanoseconds";
+    const std::string keyMaxYieldPeriod = "max_yield_nanoseconds";
+    const std::string keyWakeCount = "wake_count";
+    const std::string keyWakeLatency = "wake_latency_nanoseconds";
 
     const std::string valueForever = "forever";
 
     const std::string keyDiscardMessagesIfNoConsumer = "discard_messages_if_no_consumer";
     const std::string keyEntryCount = "entry_count";
+    const std::string keyMessageSize = "message_size";
+    const std::string keyHugePages = "huge_pages";
+    const std::string keyPrefaultMemory = "prefault_memory";
+    const std::string keyLockMemory = "lock_memory";
+    const std::string keyNumaNode = "numa_node";
+    const std::string keyCpu = "cpu";
+    const std::string keyBatchSize = "batch_size";
+    const std::string keyLockFreeProducers = "lock_free_producers";
+    const std::string keyCompetingConsumers = "competing_consumers";
+    const std::string keyInlinePayloads = "inline_payloads";
+    const std::string keyOverwriteWhenFull = "overwrite_when_full";
+    const std::string keyReportOverruns = "report_overruns";
+    const std::string keyConflateByKey = "conflate_by_key";
+    const std::string keyPriorityLanes = "priority_lanes";
+    const std::string keyMaxEntryCount = "max_entry_count";
+    const std::string keyPublishStatistics = "publish_statistics";
+    const std::string keyReadPositionInterval = "read_position_interval";
+    const std::string keyPrefetchDistance = "prefetch_distance";
+    const std::string keyAutoGrow = "auto_grow";
+    const std::string keyCompeteWith = "compete_with";
+
+    const size_t defaultBatchSize = 16;
+    /// @brief A queue with a pool of its own keeps a block for each producer that copies messages from another pool.
+    /// See SendToQueue::handle()
+    const size_t producerSpares = 8;
+
+    void pinToCpu(const std::string & name, int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        auto result = EINVAL;
+        if(cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &cpus);
+            result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+        if(result != 0)
+        {
+            LogWarning("InputQueue " << name << " can't pin its thread to CPU " << cpu << ": " << std::strerror(result));
+            return;
+        }
+        LogInfo("InputQueue " << name << " pinned to CPU " << cpu << " on NUMA node " << HighQPageMemory::currentNode());
+#else // __linux__
+        LogWarning("InputQueue " << name << " can't pin its thread to a CPU on this platform.");
+#endif // __linux__
+    }
 
 }
 
@@ -36,12 +95,18 @@ namespace
 InputQueue::InputQueue()
     : connection_(new Connection)
     , discardMessagesIfNoConsumer_(false)
+    , reportOverruns_(false)
+    , autoGrow_(false)
+    , cpu_(-1)
+    , batchSize_(defaultBatchSize)
 {
 }
 
 std::ostream & InputQueue::usage(std::ostream & out) const
 {
     out << "    " << keyEntryCount << ": The maximum number of messages the queue can hold." << std::endl;
+    out << "    " << keyMessageSize << ": Give the queue's messages a memory size class of their own, with blocks of this many bytes" << std::endl;
+    out << "         rather than the size of the largest message any step needs.  Every step that publishes to this queue must fit." << std::endl;
     out << "    " << keyConsumerWaitStrategy << ": Strategy for consumer when queue is empty." << std::endl;
     out << "    " << keyProducerWaitStrategy << ": Strategy for producers when queue is full." << std::endl;
     out << "    " << keyCommonWaitStrategy << ": Wait strategy for both consumer and producers" << std::endl;
@@ -52,9 +117,36 @@ std::ostream & InputQueue::usage(std::ostream & out) const
     out << "        " << keySleepCount << ": How many times to sleep before waiting with a Mutex/Condition Variable" << std::endl;
     out << "        " << keySleepPeriod << ": How many nanoseconds to sleep each time." << std::endl;
     out << "        " << keyMutexWaitTimeout << ": How long to wait for a Mutex/Condition Variable before failing" << std::endl;
+    out << "        " << keyUseFutex << ": Wait on a futex rather than a Mutex/Condition Variable (true/false)" << std::endl;
+    out << "        " << keyAdaptive << ": Ignore " << keySpinCount << " and " << keyYieldCount << ". Spin and yield for about twice as long as recent waits lasted (true/false)" << std::endl;
+    out << "        " << keyMaxSpinPeriod << ": With " << keyAdaptive << ", the longest to spin in nanoseconds." << std::endl;
+    out << "        " << keyMaxYieldPeriod << ": With " << keyAdaptive << ", the longest to spin and yield in nanoseconds.  Longer waits go straight to sleeping." << std::endl;
+    out << "        " << keyWakeCount << ": Consumer only.  Producers wake a sleeping consumer after this many messages (default 1: every message.)" << std::endl;
+    out << "        " << keyWakeLatency << ": With " << keyWakeCount << ", the longest in nanoseconds a message waits for the consumer to wake (default 100000.)" << std::endl;
     out << "             " << valueForever << ": can appear rather than a number for any of the counts above" << std::endl;
 
     out << "    " << keyDiscardMessagesIfNoConsumer << ": If no consumer is attached to the queue, simply discard messages." << std::endl;
+    out << "    " << keyLockFreeProducers << ": Multiple producers claim entries with an atomic increment rather than a spin lock." << std::endl;
+    out << "    " << keyCompetingConsumers << ": Other input queues may take messages from this queue using " << keyCompeteWith << ". Each message goes to only one of them." << std::endl;
+    out << "    " << keyInlinePayloads << ": Copy small messages into the queue entries rather than swapping memory blocks." << std::endl;
+    out << "    " << keyOverwriteWhenFull << ": Producers never wait.  When the queue is full the oldest messages are overwritten whether or not they have been read." << std::endl;
+    out << "    " << keyReportOverruns << ": With " << keyOverwriteWhenFull << ", send a Gap message identifying the queue positions that were lost." << std::endl;
+    out << "    " << keyConflateByKey << ": A message replaces any unread message with the same key (by default its sequence number) rather than being queued behind it." << std::endl;
+    out << "    " << keyPriorityLanes << ": How many priority lanes (0 to 3) to read ahead of the queue so Shutdown and Heartbeat messages don't wait behind queued data." << std::endl;
+    out << "    " << keyReadPositionInterval << ": Publish the consumer's read position every this many messages rather than after each one." << std::endl;
+    out << "    " << keyPrefetchDistance << ": Prefetch the entry this many ahead of the one being read, and its message (0 means don't prefetch.)" << std::endl;
+    out << "    " << keyPublishStatistics << ": Put the queue in named shared memory so hqstat can watch it." << std::endl;
+    out << "    " << keyHugePages << ": Back the queue's entries with huge pages if the system has them (true/false)" << std::endl;
+    out << "    " << keyPrefaultMemory << ": Touch every page of the queue before it starts so no page faults happen later (true/false)" << std::endl;
+    out << "    " << keyLockMemory << ": Lock the queue's pages into memory (true/false)" << std::endl;
+    out << "    " << keyCpu << ": Pin the thread that reads the queue (and runs the steps after it) to this CPU." << std::endl;
+    out << "    " << keyNumaNode << ": Give the queue a memory pool of its own on this NUMA node (default: the node of " << keyCpu << ", if given.)" << std::endl;
+    out << "         Messages from another pool are copied into the queue by send_to_queue so each pool's memory stays on its node." << std::endl;
+    out << "         On a machine with fewer nodes, node n means node n modulo the number of nodes." << std::endl;
+    out << "    " << keyMaxEntryCount << ": Allow the queue to be resized while running, up to this many entries." << std::endl;
+    out << "    " << keyAutoGrow << ": With " << keyMaxEntryCount << ", double the number of entries whenever the queue fills." << std::endl;
+    out << "    " << keyCompeteWith << ": Do not create a queue. Instead take messages from the named input_queue, which must enable " << keyCompetingConsumers << "." << std::endl;
+    out << "    " << keyBatchSize << ": The maximum number of messages to take from the queue at once. (default " << defaultBatchSize << ")" << std::endl;
     return ThreadedStepToMessage::usage(out);
 }
 
@@ -84,6 +176,63 @@ bool InputQueue::configureParameter(const std::string & key, const Configuration
         }
         LogError("Can't interpret " << configuration.getName() << " configuration " << keyDiscardMessagesIfNoConsumer);
     }
+    else if(key == keyLockFreeProducers)
+    {
+        if(configuration.getValue(parameters_.lockFreeProducers_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyLockFreeProducers);
+    }
+    else if(key == keyCompetingConsumers)
+    {
+        if(configuration.getValue(parameters_.competingConsumers_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyCompetingConsumers);
+    }
+    else if(key == keyInlinePayloads)
+    {
+        if(configuration.getValue(parameters_.inlinePayloads_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyInlinePayloads);
+    }
+    else if(key == keyOverwriteWhenFull)
+    {
+        if(configuration.getValue(parameters_.overwriteWhenFull_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyOverwriteWhenFull);
+    }
+    else if(key == keyReportOverruns)
+    {
+        if(configuration.getValue(reportOverruns_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyReportOverruns);
+    }
+    else if(key == keyConflateByKey)
+    {
+        if(configuration.getValue(parameters_.conflateByKey_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyConflateByKey);
+    }
+    else if(key == keyCompeteWith)
+    {
+        if(configuration.getValue(competeWith_) && !competeWith_.empty())
+        {
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyCompeteWith);
+        return false;
+    }
     else if(key == keyEntryCount)
     {
         uint64_t entryCount = 0;
@@ -95,6 +244,134 @@ bool InputQueue::configureParameter(const std::string & key, const Configuration
         LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyEntryCount);
         return false;
     }
+    else if(key == keyHugePages)
+    {
+        if(configuration.getValue(parameters_.pageOptions_.hugePages_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyHugePages);
+    }
+    else if(key == keyPrefaultMemory)
+    {
+        if(configuration.getValue(parameters_.pageOptions_.prefault_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyPrefaultMemory);
+    }
+    else if(key == keyLockMemory)
+    {
+        if(configuration.getValue(parameters_.pageOptions_.lockPages_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyLockMemory);
+    }
+    else if(key == keyNumaNode)
+    {
+        uint64_t node = 0;
+        if(configuration.getValue(node))
+        {
+            parameters_.pageOptions_.numaNode_ = int(node);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyNumaNode);
+        return false;
+    }
+    else if(key == keyCpu)
+    {
+        uint64_t cpu = 0;
+        if(configuration.getValue(cpu))
+        {
+            cpu_ = int(cpu);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyCpu);
+        return false;
+    }
+    else if(key == keyMessageSize)
+    {
+        uint64_t messageSize = 0;
+        if(configuration.getValue(messageSize) && messageSize > 0)
+        {
+            parameters_.messageSize_ = size_t(messageSize);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyMessageSize);
+        return false;
+    }
+    else if(key == keyBatchSize)
+    {
+        uint64_t batchSize = 0;
+        if(configuration.getValue(batchSize) && batchSize > 0)
+        {
+            batchSize_ = size_t(batchSize);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyBatchSize);
+        return false;
+    }
+    else if(key == keyPriorityLanes)
+    {
+        uint64_t laneCount = 0;
+        if(configuration.getValue(laneCount) && laneCount <= HighQPriorityLane::MaxLanes)
+        {
+            parameters_.priorityLanes_ = size_t(laneCount);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyPriorityLanes);
+        return false;
+    }
+    else if(key == keyReadPositionInterval)
+    {
+        uint64_t interval = 0;
+        if(configuration.getValue(interval))
+        {
+            parameters_.readPositionInterval_ = size_t(interval);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyReadPositionInterval);
+        return false;
+    }
+    else if(key == keyPrefetchDistance)
+    {
+        uint64_t distance = 0;
+        if(configuration.getValue(distance))
+        {
+            parameters_.prefetchDistance_ = size_t(distance);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyPrefetchDistance);
+        return false;
+    }
+    else if(key == keyPublishStatistics)
+    {
+        if(configuration.getValue(parameters_.publishStatistics_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyPublishStatistics);
+    }
+    else if(key == keyMaxEntryCount)
+    {
+        uint64_t maxEntryCount = 0;
+        if(configuration.getValue(maxEntryCount))
+        {
+            parameters_.maxEntryCount_ = size_t(maxEntryCount);
+            return true;
+        }
+        LogFatal("Can't interpret " << configuration.getName() << " configuration " << keyMaxEntryCount);
+        return false;
+    }
+    else if(key == keyAutoGrow)
+    {
+        if(configuration.getValue(autoGrow_))
+        {
+            return true;
+        }
+        LogError("Can't interpret " << configuration.getName() << " configuration " << keyAutoGrow);
+    }
     return ThreadedStepToMessage::configureParameter(key, configuration);
 }
 
@@ -105,6 +382,12 @@ bool InputQueue::constructWaitStrategy(const ConfigurationNode & config, WaitStr
     size_t sleepCount = WaitStrategy::FOREVER;
     uint64_t sleepPeriod = WaitStrategy::FOREVER;
     uint64_t mutexWaitTimeout = WaitStrategy::FOREVER;
+    bool useFutex = false;
+    bool adaptive = false;
+    uint64_t maxSpinPeriod = 20000;
+    uint64_t maxYieldPeriod = 200000;
+    uint64_t wakeCount = 1;
+    uint64_t wakeLatency = 100000;
 
     for(auto children = config.getChildren();
         children->has();
@@ -112,6 +395,15 @@ bool InputQueue::constructWaitStrategy(const ConfigurationNode & config, WaitStr
     {
         const auto & parameter = children->getChild();
         const auto & key = parameter->getName();
+        if(key == keyUseFutex || key == keyAdaptive)
+        {
+            if(!parameter->getValue(key == keyUseFutex ? useFutex : adaptive))
+            {
+                LogFatal("Error reading wait strategy parameter " << key << ". Expecting true or false.");
+                return false;
+            }
+            continue;
+        }
         std::string valueString;
         uint64_t value = WaitStrategy::FOREVER;
         parameter->getValue(valueString);
@@ -144,6 +436,22 @@ bool InputQueue::constructWaitStrategy(const ConfigurationNode & config, WaitStr
         {
             mutexWaitTimeout = value;
         }
+        else if(key == keyMaxSpinPeriod)
+        {
+            maxSpinPeriod = value;
+        }
+        else if(key == keyMaxYieldPeriod)
+        {
+            maxYieldPeriod = value;
+        }
+        else if(key == keyWakeCount)
+        {
+            wakeCount = value;
+        }
+        else if(key == keyWakeLatency)
+        {
+            wakeLatency = value;
+        }
         else
         {
             LogFatal("Unknown  wait_strategy parameter: " << key
@@ -151,50 +459,204 @@ bool InputQueue::constructWaitStrategy(const ConfigurationNode & config, WaitStr
                 << keySpinCount << ", "
                 << keyYieldCount << ", "
                 << keySleepCount << ", "
-                << keySleepPeriod << ", or "
-                << keyMutexWaitTimeout << ".");
+                << keySleepPeriod << ", "
+                << keyMutexWaitTimeout << ", "
+                << keyUseFutex << ", "
+                << keyAdaptive << ", "
+                << keyMaxSpinPeriod << ", "
+                << keyMaxYieldPeriod << ", "
+                << keyWakeCount << ", or "
+                << keyWakeLatency << ".");
             return false;
         }
     }
-    LogInfo("Construct wait strategy: " << spinCount << " yield: " << yieldCount
-        << " sleep: " << sleepCount << " period: " << sleepPeriod << " wait: " << mutexWaitTimeout);
-
-    strategy = WaitStrategy(spinCount, yieldCount, sleepCount, std::chrono::nanoseconds(sleepPeriod), std::chrono::nanoseconds(mutexWaitTimeout));
+    if(adaptive)
+    {
+        LogInfo("Construct adaptive wait strategy: max spin: " << maxSpinPeriod << " max yield: " << maxYieldPeriod
+            << " sleep: " << sleepCount << " period: " << sleepPeriod << " wait: " << mutexWaitTimeout << " futex: " << useFutex);
+        strategy = WaitStrategy::adaptive(std::chrono::nanoseconds(maxSpinPeriod), std::chrono::nanoseconds(maxYieldPeriod),
+            sleepCount, std::chrono::nanoseconds(sleepPeriod), std::chrono::nanoseconds(mutexWaitTimeout), useFutex);
+    }
+    else
+    {
+        LogInfo("Construct wait strategy: " << spinCount << " yield: " << yieldCount
+            << " sleep: " << sleepCount << " period: " << sleepPeriod << " wait: " << mutexWaitTimeout << " futex: " << useFutex);
+        strategy = WaitStrategy(spinCount, yieldCount, sleepCount, std::chrono::nanoseconds(sleepPeriod), std::chrono::nanoseconds(mutexWaitTimeout), useFutex);
+    }
+    if(wakeCount > 1)
+    {
+        LogInfo("Coalesce wakeups: " << wakeCount << " latency: " << wakeLatency);
+        strategy.coalesceWakeups(size_t(wakeCount), std::chrono::nanoseconds(wakeLatency));
+    }
     return true;
 }
 
 void InputQueue::configureResources(const SharedResourcesPtr & resources)
 {
-    resources->addQueue(name_, connection_);
-    resources->requestMessages(parameters_.entryCount_);
+    if(competeWith_.empty() && cpu_ >= 0 && parameters_.pageOptions_.numaNode_ < 0)
+    {
+        parameters_.pageOptions_.numaNode_ = HighQPageMemory::nodeOfCpu(cpu_);
+    }
+    if(competeWith_.empty())
+    {
+        resources->addQueue(name_, connection_);
+        // The priority lanes and the room to grow need Messages of their own.
+        auto entryMessages = parameters_.entryCount_
+            + HighQPriorityLane::entriesNeeded(parameters_) + HighQRing::entriesNeeded(parameters_);
+        if(parameters_.pageOptions_.numaNode_ >= 0)
+        {
+            // The queue's own pool holds them.  See attachResources()
+            resources->setQueueMessageSize(name_, 0);
+        }
+        else if(parameters_.messageSize_ != 0)
+        {
+            // The consumer's batch swaps blocks with the entries, so it needs the same size class.
+            resources->requestSizedMessages(parameters_.messageSize_, entryMessages + batchSize_);
+            resources->setQueueMessageSize(name_, parameters_.messageSize_);
+        }
+        else
+        {
+            resources->requestMessages(entryMessages + batchSize_);
+        }
+    }
+    else
+    {
+        // The batch swaps blocks with the other queue's entries, so it comes from that queue's memory.
+        resources->requestQueueMessages(competeWith_, batchSize_);
+    }
+    if(reportOverruns_)
+    {
+        resources->requestMessageSize(sizeof(GapMessage));
+    }
     return ThreadedStepToMessage::configureResources(resources);
 }
 
 void InputQueue::attachResources(const SharedResourcesPtr & resources)
 {
     auto pool = resources->getMemoryPool();
-    connection_->createLocal(name_, parameters_, pool);
-    consumer_.reset(new Consumer(connection_));
+    if(competeWith_.empty())
+    {
+        parameters_.pageOptions_ |= resources->getPageOptions();
+        if(parameters_.pageOptions_.numaNode_ >= 0)
+        {
+            // A pool of its own on the consumer's node, holding the entries, the consumer's batch, and the producers' spares.
+            // The batch swaps blocks with the entries, so it comes from this pool, too, as do the competitors' batches.
+            if(parameters_.messageSize_ == 0)
+            {
+                parameters_.messageSize_ = pool->getBlockCapacity();
+            }
+            parameters_.messageCount_ = parameters_.entryCount_ + batchSize_ + producerSpares
+                + resources->getQueueMessages(name_);
+            LogInfo("InputQueue " << name_ << " memory on NUMA node " << HighQPageMemory::physicalNode(parameters_.pageOptions_.numaNode_));
+            connection_->createLocal(name_, parameters_);
+        }
+        else
+        {
+            connection_->createLocal(name_, parameters_, pool);
+        }
+        consumer_.reset(new Consumer(connection_));
+    }
+    else
+    {
+        // The other queue may not have been created yet.  The consumer is attached in start().
+        connection_ = resources->findQueue(competeWith_);
+        if(!connection_)
+        {
+            std::stringstream msg;
+            msg << "InputQueue " << name_ << " can't find queue \"" << competeWith_ << "\" to compete with.";
+            throw std::runtime_error(msg.str());
+        }
+    }
+    if(competeWith_.empty())
+    {
+        // From the queue's own pool or size class.
+        messages_.reset(new MessageArray(connection_, batchSize_));
+    }
     return ThreadedStepToMessage::attachResources(resources);
 }
 
+void InputQueue::start()
+{
+    if(!consumer_)
+    {
+        consumer_.reset(new Consumer(connection_));
+        // From the other queue's pool or size class, which had room added for it.  See configureResources()
+        messages_.reset(new MessageArray(connection_, batchSize_));
+    }
+    ThreadedStepToMessage::start();
+}
+
 void InputQueue::run()
 {
+    if(cpu_ >= 0)
+    {
+        pinToCpu(name_, cpu_);
+    }
     while(!stopping_)
     {
-        if(consumer_->getNext(*outMessage_))
+        auto overruns = consumer_->getOverruns();
+        auto count = consumer_->getNextBatch(messages_->get(), batchSize_);
+        if(count > 0)
         {
-            auto type = outMessage_->getType();
-            send(*outMessage_);            
+            if(reportOverruns_ && consumer_->getOverruns() != overruns)
+            {
+                // Everything in the batch follows the lost messages.
+                publishOverrunGap();
+            }
+            for(size_t nMessage = 0; nMessage < count; ++nMessage)
+            {
+                send((*messages_)[nMessage]);
+            }
+            if(autoGrow_ && count == batchSize_)
+            {
+                growIfFull();
+            }
         }
         else
         {
-            LogTrace("InputQueue::stopped by getNext");
+            LogTrace("InputQueue::stopped by getNextBatch");
             stop();
         }
     }
 }
 
+void InputQueue::publishOverrunGap()
+{
+    Position start = 0;
+    Position end = 0;
+    consumer_->getLatestOverrun(start, end);
+    LogDebug("InputQueue " << name_ << " overrun [" << start << ", " << end << ')');
+    outMessage_->setType(Message::MessageType::Gap);
+    outMessage_->setSequence(Message::Sequence(end));
+    outMessage_->emplace<GapMessage>(uint32_t(start), uint32_t(end - 1));
+    send(*outMessage_);
+}
+
+void InputQueue::growIfFull()
+{
+    // The batch was full.  If the queue was full, too, the producers are waiting.
+    auto entryCount = connection_->getEntryCount();
+    auto maxEntryCount = connection_->getHeader()->maxEntryCount_;
+    if(entryCount < maxEntryCount && connection_->getBacklog() + batchSize_ >= entryCount)
+    {
+        auto newEntryCount = std::min(entryCount * 2, maxEntryCount);
+        if(connection_->resize(newEntryCount))
+        {
+            LogInfo("InputQueue " << name_ << " growing to " << newEntryCount << " entries.");
+        }
+    }
+}
+
+void InputQueue::logStats()
+{
+    if(consumer_)
+    {
+        std::stringstream stats;
+        consumer_->writeStats(stats);
+        LogStatistics("InputQueue " << name_ << " consumer: " << stats.str());
+    }
+}
+
 void InputQueue::stop()
 {
     if(!stopping_)
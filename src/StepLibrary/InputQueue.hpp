@@ -4,6 +4,7 @@
 #pragma once
 #include <Steps/ThreadedStepToMessage.hpp>
 #include <HighQueue/Consumer.hpp>
+#include <HighQueue/MessageArray.hpp>
 
 #include <Common/Log.hpp>
 
@@ -20,20 +21,34 @@ namespace HighQueue
             virtual bool configureParameter(const std::string & key, const ConfigurationNode & configuration) override;
             virtual void configureResources(const SharedResourcesPtr & resources) override;
             virtual void attachResources(const SharedResourcesPtr & resources) override;
+            virtual void start() override;
             virtual void stop() override;
+            virtual void logStats() override;
             virtual std::ostream & usage(std::ostream & out) const override;
 
             virtual void run() override;
 
         private:
             bool constructWaitStrategy(const ConfigurationNode & config, WaitStrategy & strategy);
+            void publishOverrunGap();
+            void growIfFull();
 
         private:
             ConnectionPtr connection_;
             bool discardMessagesIfNoConsumer_;
             CreationParameters parameters_;
+            /// @brief If not empty, consume from this input_queue rather than creating a new queue.
+            std::string competeWith_;
+            /// @brief Send a Gap message when the producers overwrite messages before they are read.
+            bool reportOverruns_;
+            /// @brief Double the queue's entries (up to parameters_.maxEntryCount_) when the consumer falls behind.
+            bool autoGrow_;
+            /// @brief Pin the consumer's thread to this CPU (-1 means don't.)
+            int cpu_;
 
             std::unique_ptr<Consumer> consumer_;
+            size_t batchSize_;
+            std::unique_ptr<MessageArray> messages_;
 //            std::unique_ptr<Message> message_;
         };
 
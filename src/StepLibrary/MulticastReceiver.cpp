@@ -4,6 +4,7 @@
 #include <Steps/StepPch.hpp>
 
 #include "MulticastReceiver.hpp"
+#include "SendToQueue.hpp"
 
 #include <Steps/StepFactory.hpp>
 #include <Steps/Configuration.hpp>
@@ -34,6 +35,7 @@ MulticastReceiver::MulticastReceiver()
     , bindIP_("0.0.0.0")
     , portNumber_(0)
     , messagesReceived_(0)
+    , claimed_(0)
 {
 }
 
@@ -123,7 +125,7 @@ void MulticastReceiver::validate()
 void MulticastReceiver::start()
 {
     AsioStepToMessage::start();
-
+    directQueue_ = std::dynamic_pointer_cast<SendToQueue>(primaryDestination_);
 
     LogDebug("Multicast receiver open socket: " << listenEndpoint_);
     socket_.reset(new Socket(*ioService_));
@@ -131,6 +133,8 @@ void MulticastReceiver::start()
     LogDebug("Multicast receiver set reuse");
     socket_->set_option(boost::asio::ip::udp::socket::reuse_address(true));
     socket_->bind(bindpoint_);
+    // A datagram announced by handleReadable() may be gone by the time it is read.
+    socket_->non_blocking(true);
 
     // Join the multicast group
     LogDebug("Multicast Receiver " << multicastGroup_.to_v4() << " listen: " << listenInterface_.to_v4());
@@ -148,6 +152,20 @@ void MulticastReceiver::startRead()
 {
     if(!stopping_)
     {
+        if(directQueue_ && directQueue_->canClaim())
+        {
+            // Wait for a datagram without reading it.  Claiming the entry now would hold up
+            // every message other producers publish until the next datagram arrives.
+            socket_->async_receive_from(
+                boost::asio::null_buffers(),
+                senderEndpoint_,
+                boost::bind(&MulticastReceiver::handleReadable,
+                    this,
+                    boost::asio::placeholders::error,
+                    boost::asio::placeholders::bytes_transferred)
+                );
+            return;
+        }
         socket_->async_receive_from(
             boost::asio::buffer(outMessage_->getWritePosition(), outMessage_->available()),
             senderEndpoint_,
@@ -160,6 +178,38 @@ void MulticastReceiver::startRead()
 }
 
 
+void MulticastReceiver::handleReadable(
+    const boost::system::error_code& error,
+    size_t bytesReceived)
+{
+    if(error)
+    {
+        handleReceive(error, bytesReceived);
+        return;
+    }
+    // Receive straight into the queue's memory.
+    claimed_ = directQueue_->claim();
+    if(!claimed_)
+    {
+        // the queue is stopping
+        return;
+    }
+    boost::system::error_code receiveError;
+    bytesReceived = socket_->receive_from(
+        boost::asio::buffer(claimed_->getWritePosition(), claimed_->available()),
+        senderEndpoint_,
+        0,
+        receiveError);
+    if(receiveError == boost::asio::error::would_block)
+    {
+        claimed_ = 0;
+        directQueue_->abandonClaim();
+        startRead();
+        return;
+    }
+    handleReceive(receiveError, bytesReceived);
+}
+
 void MulticastReceiver::handleReceive(
     const boost::system::error_code& error,
     size_t bytesReceived)
@@ -171,15 +221,30 @@ void MulticastReceiver::handleReceive(
         {
             LogError("Error in multicast reader: " << error.message());
         }
+        if(claimed_)
+        {
+            // Don't leave consumers waiting for the claimed entry.
+            claimed_ = 0;
+            directQueue_->abandonClaim();
+        }
     }
     else
     {
         ++messagesReceived_;
-        outMessage_->setType(Message::MessageType::MulticastPacket);
+        Message & message = claimed_ ? *claimed_ : *outMessage_;
+        message.setType(Message::MessageType::MulticastPacket);
         auto timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
-        outMessage_->setTimestamp(timestamp);
-        outMessage_->addUsed(bytesReceived);
-        send(*outMessage_);
+        message.setTimestamp(timestamp);
+        message.addUsed(bytesReceived);
+        if(claimed_)
+        {
+            claimed_ = 0;
+            directQueue_->commit();
+        }
+        else
+        {
+            send(*outMessage_);
+        }
         startRead();
     }
 }
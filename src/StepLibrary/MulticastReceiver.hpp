@@ -9,7 +9,12 @@ namespace HighQueue
 {
     namespace Steps
     {
+        class SendToQueue;
 
+        /// @brief Receive datagrams from a multicast group.
+        /// When the destination is a send_to_queue step that allows it, datagrams are
+        /// received directly into the queue's entries.  See Producer::claim()
+        /// The entry is claimed only once a datagram has arrived, so other producers never wait on the network.
         class MulticastReceiver: public AsioStepToMessage
         {
         public:
@@ -37,6 +42,7 @@ namespace HighQueue
 
         private:
             void startRead();
+            void handleReadable(const boost::system::error_code& error, size_t bytesReceived);
             void handleReceive(const boost::system::error_code& error, size_t bytesReceived);
 
         private:
@@ -62,6 +68,9 @@ namespace HighQueue
 
             uint32_t messagesReceived_;
 
+            std::shared_ptr<SendToQueue> directQueue_;
+            Message * claimed_;
+
         };
 
    }
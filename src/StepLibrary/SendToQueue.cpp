@@ -42,6 +42,13 @@ bool SendToQueue::configureParameter(const std::string & key, const Configuratio
     }
 }
 
+void SendToQueue::configureResources(const SharedResourcesPtr & resources)
+{
+    // For copy_ if the queue uses the shared pool.
+    resources->requestMessages(1);
+    Step::configureResources(resources);
+}
+
 void SendToQueue::attachResources(const SharedResourcesPtr & resources)
 {
     connection_ = resources->findQueue(queueName_);
@@ -80,19 +87,67 @@ void SendToQueue::validate()
 void SendToQueue::start()
 {
     producer_.reset(new Producer(connection_));
+    if(connection_->getHeader()->conflateByKey_)
+    {
+        // InputQueue's conflate_by_key conflates messages with the same sequence number.
+        producer_->setKeyExtractor([](const Message & message)
+        {
+            return ConflationKey(message.getSequence());
+        });
+    }
     Step::start();
 }
 
 void SendToQueue::handle(Message & message)
 {
     auto type = message.getType();
-    producer_->publish(message);
+    if(message.getContainer() != 0
+        && (!connection_->owns(message) || message.getCapacity() < connection_->getMessageCapacity()))
+    {
+        // Publishing would move the block into the queue for good.  Copy it instead so each pool's blocks
+        // stay where they were placed, and so a block from a smaller size class never becomes one of the
+        // queue's entries.  This is the only place messages cross pools or size classes.
+        if(!copy_)
+        {
+            copy_.reset(new Message(connection_));
+        }
+        copy_->setEmpty();
+        copy_->appendBinaryCopy(message.get(), message.getUsed());
+        message.copyMetaInfoTo(*copy_);
+        producer_->publish(*copy_);
+        // As if it had been swapped into the queue.
+        message.setEmpty();
+    }
+    else
+    {
+        producer_->publish(message);
+    }
     if(type == Message::MessageType::Shutdown)
     {
         stop();
     }
 }
 
+bool SendToQueue::canClaim() const
+{
+    return producer_ && !producer_->claimBlocksProducers();
+}
+
+Message * SendToQueue::claim()
+{
+    return producer_->claim();
+}
+
+void SendToQueue::commit()
+{
+    producer_->commit();
+}
+
+void SendToQueue::abandonClaim()
+{
+    producer_->abandonClaim();
+}
+
 void SendToQueue::stop()
 {
     Step::stop();
@@ -18,6 +18,7 @@ namespace HighQueue
 
             // Implement Step
             virtual bool configureParameter(const std::string & key, const ConfigurationNode & configuration) override;
+            virtual void configureResources(const SharedResourcesPtr & resources) override;
             virtual void attachResources(const SharedResourcesPtr & resources) override;
             virtual void validate() override;
             virtual void start() override;
@@ -25,10 +26,23 @@ namespace HighQueue
             virtual void stop() override;
             virtual std::ostream & usage(std::ostream & out) const override;
 
+            /// @brief Can a step build messages directly in the queue?
+            /// True once started if a claim would not hold up other producers.
+            bool canClaim() const;
+            /// @brief Claim the next entry in the queue.  See Producer::claim()
+            Message * claim();
+            /// @brief Publish the claimed entry.  See Producer::commit()
+            void commit();
+            /// @brief Give up the claimed entry.  See Producer::abandonClaim()
+            void abandonClaim();
+
         private:
             std::string queueName_;
             ConnectionPtr connection_;
             std::unique_ptr<Producer> producer_;
+            /// @brief Carries messages whose memory belongs to another pool (e.g. a queue on another NUMA node.)
+            /// Allocated from the queue when first needed.
+            std::unique_ptr<Message> copy_;
         };
     }
 }
\ No newline at end of file
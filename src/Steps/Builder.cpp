@@ -17,6 +17,11 @@ namespace
     const std::string keyPipe("pipe");
     const std::string keyDestination("destination");
     const std::string keyComment("comment");
+    const std::string keyBlockCacheBatch("block_cache_batch");
+    const std::string keyBlockCacheDrain("block_cache_drain");
+    const std::string keyHugePages("huge_pages");
+    const std::string keyPrefaultMemory("prefault_memory");
+    const std::string keyLockMemory("lock_memory");
 }
 
 Builder::Builder()
@@ -30,6 +35,9 @@ Builder::~Builder()
             
 bool Builder::construct(const ConfigurationNode & config)
 {
+    uint64_t blockCacheBatch = 0;
+    bool blockCacheDrain = true;
+    PageOptions pageOptions;
     for(auto rootChildren = config.getChildren();
         rootChildren->has();
         rootChildren->next())
@@ -48,12 +56,54 @@ bool Builder::construct(const ConfigurationNode & config)
         {
             // simply ignore comments
         }
+        else if(key == keyBlockCacheBatch)
+        {
+            if(!child->getValue(blockCacheBatch))
+            {
+                LogFatal("Can't interpret configuration " << keyBlockCacheBatch);
+                return false;
+            }
+        }
+        else if(key == keyBlockCacheDrain)
+        {
+            if(!child->getValue(blockCacheDrain, true))
+            {
+                LogFatal("Can't interpret configuration " << keyBlockCacheDrain);
+                return false;
+            }
+        }
+        else if(key == keyHugePages)
+        {
+            if(!child->getValue(pageOptions.hugePages_))
+            {
+                LogFatal("Can't interpret configuration " << keyHugePages);
+                return false;
+            }
+        }
+        else if(key == keyPrefaultMemory)
+        {
+            if(!child->getValue(pageOptions.prefault_))
+            {
+                LogFatal("Can't interpret configuration " << keyPrefaultMemory);
+                return false;
+            }
+        }
+        else if(key == keyLockMemory)
+        {
+            if(!child->getValue(pageOptions.lockPages_))
+            {
+                LogFatal("Can't interpret configuration " << keyLockMemory);
+                return false;
+            }
+        }
         else
         {
             LogFatal("Unknown configuration key: " << key);
             return false;
         }
     }
+    resources_->setBlockCache(size_t(blockCacheBatch), blockCacheDrain);
+    resources_->setPageOptions(pageOptions);
 
     // we have created all Steps, and used them to configure the build resources.
     resources_->createResources();
@@ -7,6 +7,7 @@
 #include <Steps/AsioService.hpp>
 #include <Steps/Step.hpp>
 #include <HighQueue/MemoryPool.hpp>
+#include <HighQueue/Connection.hpp>
 #include <HighQueue/details/HQMemoryBlockPool.hpp> // for diagnostic message (block count)
 #include <Common/ReverseRange.hpp>
 
@@ -16,6 +17,9 @@ using namespace Steps;
 SharedResources::SharedResources()
     : numberOfMessagesNeeded_(0)
     , largestMessageSize_(0)
+    , blockCacheBatch_(0)
+    , drainBlockCaches_(true)
+    , threadsNeeded_(0)
     , tenthsOfAsioThreadsNeeded_(0)
     , runTime_(0)
     , stopping_(false)
@@ -37,6 +41,12 @@ void SharedResources::requestAsioThread(size_t threads, size_t tenthsOfThread)
     LogDebug("Request Asio threads " << threads << "." << tenthsOfThread << " -> " << tenthsOfAsioThreadsNeeded_);
 }
 
+void SharedResources::requestThread(size_t threads)
+{
+    threadsNeeded_ += threads;
+    LogDebug("Request threads " << threads << " -> " << threadsNeeded_);
+}
+
 void SharedResources::requestMessages(size_t count)
 {
     numberOfMessagesNeeded_ += count;
@@ -51,6 +61,28 @@ void SharedResources::requestMessageSize(size_t bytes)
     }
 }
 
+void SharedResources::requestSizedMessages(size_t bytes, size_t count)
+{
+    sizedMessages_[HQMemoryBlockPool::cacheAlignedMessageSize(bytes)] += count;
+    LogDebug("Request messages: " << count << " of " << bytes << " bytes.");
+}
+
+void SharedResources::setBlockCache(size_t batchSize, bool drainWhenEmpty)
+{
+    blockCacheBatch_ = batchSize;
+    drainBlockCaches_ = drainWhenEmpty;
+}
+
+void SharedResources::setPageOptions(const PageOptions & pageOptions)
+{
+    pageOptions_ = pageOptions;
+}
+
+const PageOptions & SharedResources::getPageOptions()const
+{
+    return pageOptions_;
+}
+
 void SharedResources::addQueue(const std::string & name, const ConnectionPtr & connection)
 {
     // TODO: check for duplicates?
@@ -68,20 +100,122 @@ ConnectionPtr SharedResources::findQueue(const std::string & name) const
     return result;
 }
 
+void SharedResources::requestQueueMessages(const std::string & name, size_t count)
+{
+    queueMessages_[name] += count;
+    LogDebug("Request messages: " << count << " from queue " << name);
+}
+
+void SharedResources::setQueueMessageSize(const std::string & name, size_t bytes)
+{
+    queueMessageSizes_[name] = bytes;
+}
+
+size_t SharedResources::getQueueMessages(const std::string & name) const
+{
+    size_t result = 0;
+    auto pCount = queueMessages_.find(name);
+    if(pCount != queueMessages_.end())
+    {
+        result = pCount->second;
+    }
+    return result;
+}
+
+bool SharedResources::resizeQueue(const std::string & name, size_t entryCount)
+{
+    auto connection = findQueue(name);
+    if(!connection)
+    {
+        LogError("Can't resize unknown queue \"" << name << "\"");
+        return false;
+    }
+    if(!connection->resize(entryCount))
+    {
+        LogInfo("Queue " << name << " is still finishing an earlier resize.");
+        return false;
+    }
+    LogInfo("Queue " << name << " resizing to " << entryCount << " entries.");
+    return true;
+}
+
 void SharedResources::createResources()
 {
-    if(numberOfMessagesNeeded_ == 0)
+    // Every Step has been configured, so each queue has said where its Messages come from.
+    for(auto & request : queueMessages_)
+    {
+        auto pSize = queueMessageSizes_.find(request.first);
+        if(pSize == queueMessageSizes_.end())
+        {
+            requestMessages(request.second);
+        }
+        else if(pSize->second != 0)
+        {
+            requestSizedMessages(pSize->second, request.second);
+        }
+        // else the queue adds them to its own pool.
+    }
+    if(numberOfMessagesNeeded_ == 0 && sizedMessages_.empty())
     {
         throw std::runtime_error("No requests for memmory pool buffers.");
     }
-    if(largestMessageSize_ == 0)
+    size_t largestBlock = HQMemoryBlockPool::cacheAlignedMessageSize(largestMessageSize_);
+    if(!sizedMessages_.empty() && sizedMessages_.rbegin()->first > largestBlock)
+    {
+        largestBlock = sizedMessages_.rbegin()->first;
+    }
+    if(largestBlock == 0)
     {
         throw std::runtime_error("Memmory pool buffer size was not set.");
     }
-    LogInfo("Creating Memory Pool : " << numberOfMessagesNeeded_ << " messages. " << largestMessageSize_ << " bytes each.");
-    pool_ = std::make_shared<MemoryPool>(largestMessageSize_, numberOfMessagesNeeded_);
-    auto & detail = pool_->getPool();
-    LogDebug("Memory pool contains " << detail.getBlockCount() << " blocks of " << detail.getBlockCapacity() << " bytes.");
+    // Messages that did not say how large they are must be able to hold anything.
+    MemoryPool::SizeClasses sizeClasses;
+    size_t largestCount = numberOfMessagesNeeded_;
+    for(auto & sized : sizedMessages_)
+    {
+        if(sized.first < largestBlock)
+        {
+            sizeClasses.emplace_back(sized.first, sized.second);
+        }
+        else
+        {
+            largestCount += sized.second;
+        }
+    }
+    if(largestCount != 0)
+    {
+        sizeClasses.emplace_back(largestBlock, largestCount);
+    }
+    if(blockCacheBatch_ > 0)
+    {
+        // Each thread's cache can hold up to two batches of every size class.
+        size_t threads = threadsNeeded_ + (tenthsOfAsioThreadsNeeded_ + 9) / 10;
+        size_t cached = threads * 2 * blockCacheBatch_;
+        LogInfo("Memory pool adds " << cached << " messages per size class for " << threads << " thread caches.");
+        for(auto & sizeClass : sizeClasses)
+        {
+            sizeClass.second += cached;
+        }
+    }
+    for(auto & sizeClass : sizeClasses)
+    {
+        LogInfo("Creating Memory Pool : " << sizeClass.second << " messages. " << sizeClass.first << " bytes each.");
+    }
+    if(pageOptions_.any())
+    {
+        LogInfo("Memory pool pages: huge " << pageOptions_.hugePages_ << " prefault " << pageOptions_.prefault_ << " lock " << pageOptions_.lockPages_);
+    }
+    pool_ = std::make_shared<MemoryPool>(sizeClasses, pageOptions_);
+    for(size_t nClass = 0; nClass < pool_->getClassCount(); ++nClass)
+    {
+        auto & detail = pool_->getClass(nClass);
+        LogDebug("Memory pool contains " << detail.getBlockCount() << " blocks of " << detail.getBlockCapacity() << " bytes.");
+    }
+    if(blockCacheBatch_ > 0)
+    {
+        LogInfo("Memory pool threads cache up to " << blockCacheBatch_ * 2 << " blocks each.");
+        pool_->enableThreadCaches(blockCacheBatch_, drainBlockCaches_);
+    }
 
     if(tenthsOfAsioThreadsNeeded_ > 0)
     { 
@@ -16,6 +16,7 @@
 #include <Steps/StepFwd.hpp>
 #include <HighQueue/WaitStrategyFwd.hpp>
 #include <HighQueue/CreationParametersFwd.hpp>
+#include <HighQueue/details/HQPageMemory.hpp>
 
 #include <Common/Log.hpp>
 #include <Common/Stopwatch.hpp>
@@ -35,13 +36,49 @@ namespace HighQueue
 
             void requestMessages(size_t count = 1);
             void requestMessageSize(size_t bytes);
+
+            /// @brief Ask for count Messages that need only bytes each.
+            /// They come from a size class of their own rather than being as large as the largest Message.
+            /// Allocate them with a size hint.  See MemoryPool::allocate(Message &, size_t)
+            void requestSizedMessages(size_t bytes, size_t count = 1);
             void requestAsioThread(size_t threads = 1, size_t tenthsOfThread = 0);
 
+            /// @brief Report a thread a Step runs itself.  The memory pool gets room for its block cache.
+            void requestThread(size_t threads = 1);
+
+            /// @brief Let each thread keep up to 2 * batchSize free blocks from the memory pool.
+            /// Threads take and return blocks batchSize at a time.  Zero (the default) turns the caches off.
+            /// Each size class gets 2 * batchSize extra blocks for every requested and Asio thread.
+            /// See HQMemoryBlockPool::enableThreadCaches()
+            void setBlockCache(size_t batchSize, bool drainWhenEmpty = true);
+
+            /// @brief How to provide the pages under the memory pool and every input queue.
+            /// Each queue may ask for more.  See PageOptions.
+            void setPageOptions(const PageOptions & pageOptions);
+            const PageOptions & getPageOptions()const;
+
             void addStep(const StepPtr & step);
 
             void addQueue(const std::string & name, const ConnectionPtr & connection);
             ConnectionPtr findQueue(const std::string & name) const;
 
+            /// @brief Ask for count Messages from the memory of the queue called name.
+            /// For a Step that uses a queue another Step creates, whether or not that Step has asked for its own yet.
+            /// They come from the queue's size class or its own pool if it has one.  See setQueueMessageSize()
+            void requestQueueMessages(const std::string & name, size_t count);
+
+            /// @brief The queue called name takes its Messages from a size class of bytes each.
+            /// Zero means it has a pool of its own, and adds getQueueMessages() to it.
+            void setQueueMessageSize(const std::string & name, size_t bytes);
+
+            /// @brief How many Messages other Steps asked for with requestQueueMessages()
+            size_t getQueueMessages(const std::string & name) const;
+
+            /// @brief Change the number of entries in a running queue.  See Connection::resize()
+            /// @returns false if there is no such queue or an earlier resize has not finished.
+            /// @throws runtime_error if the queue cannot be resized to this size.
+            bool resizeQueue(const std::string & name, size_t entryCount);
+
             void createResources();
 
             void attachResources();
@@ -59,9 +96,8 @@ namespace HighQueue
 
         private:
             /// @brief use a single memory pool for all users.
-            /// Note this is a simplification.  If there are dramatic differences in message
-            /// sizes there might be an advantage to using multiple pools, but until the need
-            /// happens, a single pool will do.
+            /// Messages requested with requestSizedMessages() get size classes of their own.
+            /// All other Messages are as large as the largest Message.
             MemoryPoolPtr pool_;
 
             /// @brief use a single AsioService for all users.
@@ -77,6 +113,17 @@ namespace HighQueue
             // Memory Pool Parameters
             size_t numberOfMessagesNeeded_;
             size_t largestMessageSize_;
+            /// @brief Count of Messages requested for each cache aligned size.
+            std::map<size_t, size_t> sizedMessages_;
+            /// @brief Count of Messages requested from each queue's memory.
+            std::map<std::string, size_t> queueMessages_;
+            /// @brief Size class of each queue that has one.  Zero for a queue with a pool of its own.
+            std::map<std::string, size_t> queueMessageSizes_;
+            size_t blockCacheBatch_;
+            bool drainBlockCaches_;
+            /// @brief Threads run by Steps, not counting Asio threads.
+            size_t threadsNeeded_;
+            PageOptions pageOptions_;
 
             //////////////////
             // Asio parameters
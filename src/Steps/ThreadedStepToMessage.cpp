@@ -5,6 +5,7 @@
 
 #include "ThreadedStepToMessage.hpp"
 #include <HighQueue/Message.hpp>
+#include <Steps/SharedResources.hpp>
 
 using namespace HighQueue;
 using namespace Steps;
@@ -16,6 +17,12 @@ ThreadedStepToMessage::~ThreadedStepToMessage()
 {
 }
 
+void ThreadedStepToMessage::configureResources(const SharedResourcesPtr & resources)
+{
+    resources->requestThread();
+    return StepToMessage::configureResources(resources);
+}
+
 void ThreadedStepToMessage::start()
 {
     me_ = shared_from_this();
@@ -14,6 +14,7 @@ namespace HighQueue
         public:
             ThreadedStepToMessage();
             virtual ~ThreadedStepToMessage();
+            virtual void configureResources(const SharedResourcesPtr & resources) override;
             virtual void start() override;
             virtual void finish() override;
             virtual void run() = 0;